@@ -0,0 +1,454 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/*
+Header-only Bezier curves and tensor-product patches of any degree, with the degree and the scalar type as
+template parameters. Control nets are std::arrays sized at compile time, the binomial coefficients are
+constants, and every loop runs a compile-time number of times. The loops in Evaluate go through StaticFor, so
+they are unrolled whatever the optimiser thinks and a patch comes out as straight-line maths.
+
+Point can be anything with + and * by Scalar: float for the height-only paths, glm::vec3 for positions.
+
+Three ways of getting the same point:
+	Evaluate    - Bernstein weights then a weighted sum, the form the cubic library code has always used
+	Horner      - nested multiply-adds on t/(1-t), fewer multiplies for high degrees
+	DeCasteljau - repeated lerps, the most stable of the three
+
+Evaluate multiplies each weight out in the same order the cubic CalculateBezier does (the lower power of t or
+(1-t) first), so at degree 3 it gives the same bits as CalculateBezier, BezierPatchSixteenPoints and
+BuildBernsteinTable. The other two round differently and agree to a few ulp
+*/
+namespace utilAyre
+{
+	/*
+	n choose k, one return so it stays a C++11 constexpr. Every product along the way is itself a binomial, so the
+	divide is always exact
+	*/
+	constexpr int
+	BinomialCoefficient(int n, int k)
+	{
+		return k == 0 ? 1 : BinomialCoefficient(n, k - 1) * (n - k + 1) / k;
+	}
+
+	static_assert(BinomialCoefficient(3, 1) == 3 && BinomialCoefficient(6, 3) == 20, "binomial coefficients are off");
+
+	/*
+	Calls body(0) to body(Count - 1) through template recursion instead of a loop, so each call gets its index as
+	a constant and nothing is left to the optimiser's unrolling heuristics
+	*/
+	template<int Count>
+	struct StaticFor
+	{
+		template<typename Body>
+		static void
+		Run(Body& body)
+		{
+			StaticFor<Count - 1>::Run(body);
+			body(Count - 1);
+		}
+	};
+
+	template<>
+	struct StaticFor<0>
+	{
+		template<typename Body>
+		static void
+		Run(Body&)
+		{
+		}
+	};
+
+	/*
+	One Bernstein weight of a degree only known at run time, multiplied out in the order Basis uses, so at the same
+	degree they're the same bits. The shorter last patch of a piecewise grid needs these
+	*/
+	template<typename Scalar>
+	Scalar
+	BernsteinWeight(int degree, int k, Scalar t)
+	{
+		const Scalar s = 1 - t;
+		Scalar w = (Scalar)BinomialCoefficient(degree, k);
+		if (k <= degree - k)
+		{
+			for (int i = 0; i < k; ++i) w = w * t;
+			for (int i = k; i < degree; ++i) w = w * s;
+		}
+		else
+		{
+			for (int i = k; i < degree; ++i) w = w * s;
+			for (int i = 0; i < k; ++i) w = w * t;
+		}
+		return w;
+	}
+
+	/*
+	d/dt of BernsteinWeight, as DerivativeBasis has it
+	*/
+	template<typename Scalar>
+	Scalar
+	BernsteinSlope(int degree, int k, Scalar t)
+	{
+		const Scalar s = 1 - t;
+		Scalar rising = (Scalar)k;
+		for (int i = 1; i < k; ++i) rising = rising * t;
+		for (int i = k; i < degree; ++i) rising = rising * s;
+
+		Scalar falling = (Scalar)(degree - k);
+		for (int i = 0; i < k; ++i) falling = falling * t;
+		for (int i = k + 1; i < degree; ++i) falling = falling * s;
+
+		return (Scalar)BinomialCoefficient(degree, k) * (rising - falling);
+	}
+
+	template<int Degree, typename Scalar = float>
+	struct BezierCurve
+	{
+		static_assert(Degree >= 1, "a Bezier curve needs at least 2 control points");
+
+		static const int Order = Degree + 1;
+
+		typedef std::array<Scalar, Order> Weights;
+
+		template<typename Point>
+		using Net = std::array<Point, Order>;
+
+		static Scalar
+		Coefficient(int k)
+		{
+			return (Scalar)BinomialCoefficient(Degree, k);
+		}
+
+		static Weights
+		Basis(Scalar t)
+		{
+			Weights weights;
+			auto term = [&](int k)
+			{
+				weights[k] = BernsteinWeight(Degree, k, t);
+			};
+			StaticFor<Order>::Run(term);
+			return weights;
+		}
+
+		/*
+		d/dt of every Basis weight, so Combine with these gives the curve's slope rather than its point.
+		Written straight from the power form, k t^(k-1) (1-t)^(n-k) - (n-k) t^k (1-t)^(n-k-1), rather than through the
+		degree - 1 basis, so it works down to degree 1
+		*/
+		static Weights
+		DerivativeBasis(Scalar t)
+		{
+			Weights weights;
+			auto term = [&](int k)
+			{
+				weights[k] = BernsteinSlope(Degree, k, t);
+			};
+			StaticFor<Order>::Run(term);
+			return weights;
+		}
+
+		/*
+		Weighted sum of points that are Stride apart, so one routine does the rows and the columns of a net
+		*/
+		template<typename Point>
+		static Point
+		Combine(const Point* points, std::ptrdiff_t stride, const Weights& weights)
+		{
+			Point sum = points[0] * weights[0];
+			auto term = [&](int k)
+			{
+				sum = sum + points[(k + 1) * stride] * weights[k + 1];
+			};
+			StaticFor<Degree>::Run(term);
+			return sum;
+		}
+
+		template<typename Point>
+		static Point
+		Evaluate(const Net<Point>& cps, Scalar t)
+		{
+			return Combine(cps.data(), 1, Basis(t));
+		}
+
+		template<typename Point>
+		static Point
+		Horner(const Net<Point>& cps, Scalar t)
+		{
+			const Scalar s = 1 - t;
+			Scalar power = 1;
+			Point sum = cps[0] * s;
+			for (int k = 1; k < Degree; ++k)
+			{
+				power = power * t;
+				sum = (sum + cps[k] * (Coefficient(k) * power)) * s;
+			}
+			return sum + cps[Degree] * (power * t);
+		}
+
+		template<typename Point>
+		static Point
+		DeCasteljau(Net<Point> cps, Scalar t)
+		{
+			const Scalar s = 1 - t;
+			for (int level = Degree; level > 0; --level)
+			{
+				for (int i = 0; i < level; ++i)
+				{
+					cps[i] = cps[i] * s + cps[i + 1] * t;
+				}
+			}
+			return cps[0];
+		}
+
+		/*
+		First derivative with respect to t: the degree - 1 curve through the differences, times the degree
+		*/
+		template<typename Point>
+		static Point
+		Derivative(const Net<Point>& cps, Scalar t)
+		{
+			std::array<Point, Degree> differences;
+			for (int k = 0; k < Degree; ++k)
+			{
+				differences[k] = (cps[k + 1] - cps[k]) * (Scalar)Degree;
+			}
+			return DerivativeOf(differences, t);
+		}
+
+	private:
+
+		template<typename Point>
+		static Point
+		DerivativeOf(const std::array<Point, 1>& differences, Scalar)
+		{
+			return differences[0];
+		}
+
+		template<typename Point, size_t Count>
+		static Point
+		DerivativeOf(const std::array<Point, Count>& differences, Scalar t)
+		{
+			return BezierCurve<(int)Count - 1, Scalar>::Evaluate(differences, t);
+		}
+	};
+
+	/*
+	Tensor-product patch, DegreeU along each row and DegreeV across the rows. Rows are in ascending v and points
+	in ascending u, the same layout as BezierPatch, and the rows get collapsed along u first like
+	BezierPatchSixteenPoints does
+	*/
+	template<int DegreeU, int DegreeV = DegreeU, typename Scalar = float>
+	struct BezierSurfacePatch
+	{
+		typedef BezierCurve<DegreeU, Scalar> CurveU;
+		typedef BezierCurve<DegreeV, Scalar> CurveV;
+
+		static const int Columns = DegreeU + 1;
+		static const int Rows = DegreeV + 1;
+
+		template<typename Point>
+		using Net = std::array<Point, Columns * Rows>;
+
+		template<typename Point>
+		static Point
+		Evaluate(const Net<Point>& cps, Scalar u, Scalar v)
+		{
+			const typename CurveU::Weights bu = CurveU::Basis(u);
+			const typename CurveV::Weights bv = CurveV::Basis(v);
+
+			typename CurveV::template Net<Point> curve;
+			auto row = [&](int r)
+			{
+				curve[r] = CurveU::Combine(&cps[r * Columns], 1, bu);
+			};
+			StaticFor<Rows>::Run(row);
+			return CurveV::Combine(curve.data(), 1, bv);
+		}
+
+		template<typename Point>
+		static Point
+		Horner(const Net<Point>& cps, Scalar u, Scalar v)
+		{
+			typename CurveV::template Net<Point> curve;
+			for (int row = 0; row < Rows; ++row)
+			{
+				curve[row] = CurveU::Horner(Row(cps, row), u);
+			}
+			return CurveV::Horner(curve, v);
+		}
+
+		template<typename Point>
+		static Point
+		DeCasteljau(const Net<Point>& cps, Scalar u, Scalar v)
+		{
+			typename CurveV::template Net<Point> curve;
+			for (int row = 0; row < Rows; ++row)
+			{
+				curve[row] = CurveU::DeCasteljau(Row(cps, row), u);
+			}
+			return CurveV::DeCasteljau(curve, v);
+		}
+
+		/*
+		Partial derivatives along u and v in one go, sharing the basis weights
+		*/
+		template<typename Point>
+		static void
+		Derivatives(const Net<Point>& cps, Scalar u, Scalar v, Point& du, Point& dv)
+		{
+			const typename CurveV::Weights bv = CurveV::Basis(v);
+
+			typename CurveV::template Net<Point> curveU, curveV;
+			for (int row = 0; row < Rows; ++row)
+			{
+				curveU[row] = CurveU::Derivative(Row(cps, row), u);
+				curveV[row] = CurveU::Evaluate(Row(cps, row), u);
+			}
+			du = CurveV::Combine(curveU.data(), 1, bv);
+			dv = CurveV::Derivative(curveV, v);
+		}
+
+	private:
+
+		template<typename Point>
+		static typename CurveU::template Net<Point>
+		Row(const Net<Point>& cps, int row)
+		{
+			typename CurveU::template Net<Point> points;
+			for (int column = 0; column < Columns; ++column)
+			{
+				points[column] = cps[row * Columns + column];
+			}
+			return points;
+		}
+	};
+
+	/*
+	Where a sample lands along one axis of a piecewise grid of degree-Degree patches. Patches are Degree segments
+	wide from the start and share their end points. When the segment count isn't a multiple of the degree, the
+	segments left over make one shorter patch of a lower degree, starting where the last whole patch ends, so
+	the surface stays continuous across every boundary. A sample always reads Degree + 1 control points from
+	offset; in the shorter patch those are the last ones in the grid, and the first few get a weight of 0.
+	Grids need at least Degree segments
+	*/
+	template<int Degree>
+	struct PatchSampleOf
+	{
+		int offset; //first of the Degree + 1 control points the sample reads
+		int degree; //Degree, or the shorter last patch's degree
+		float t;    //along that patch, 0 to 1
+	};
+
+	/*
+	X is the sample's position in segments, 0 to sourceSegments
+	*/
+	template<int Degree>
+	PatchSampleOf<Degree>
+	LocatePatchSample(size_t sourceSegments, float X)
+	{
+		const int segments = (int)sourceSegments;
+		const int remainder = segments % Degree;
+		const int lastWhole = segments - remainder; //where the shorter patch starts, if there is one
+
+		PatchSampleOf<Degree> sample;
+		int start = (int)X - (int)X % Degree;
+		if (remainder > 0 && start >= lastWhole)
+		{
+			sample.offset = segments - Degree;
+			sample.degree = remainder;
+			sample.t = (X - lastWhole) / remainder;
+			return sample;
+		}
+
+		if (start > segments - Degree) //X right on the far edge
+			start = segments - Degree;
+		sample.offset = start;
+		sample.degree = Degree;
+		sample.t = (X - start) / Degree;
+		return sample;
+	}
+
+	/*
+	The sample's weights on its Degree + 1 control points. A whole patch gets Basis(t) as it is
+	*/
+	template<int Degree>
+	std::array<float, Degree + 1>
+	PatchSampleWeights(const PatchSampleOf<Degree>& sample)
+	{
+		if (sample.degree == Degree)
+			return BezierCurve<Degree, float>::Basis(sample.t);
+
+		const int padding = Degree - sample.degree;
+		std::array<float, Degree + 1> weights;
+		for (int k = 0; k <= Degree; ++k)
+		{
+			weights[k] = k < padding ? 0.0f : BernsteinWeight(sample.degree, k - padding, sample.t);
+		}
+		return weights;
+	}
+
+	/*
+	d/dt of the weights, scaled so that in every patch they're per Degree segments like a whole patch's are, and
+	one slope scale does for the whole axis
+	*/
+	template<int Degree>
+	std::array<float, Degree + 1>
+	PatchSampleSlopes(const PatchSampleOf<Degree>& sample)
+	{
+		if (sample.degree == Degree)
+			return BezierCurve<Degree, float>::DerivativeBasis(sample.t);
+
+		const int padding = Degree - sample.degree;
+		const float stretch = (float)Degree / sample.degree;
+		std::array<float, Degree + 1> slopes;
+		for (int k = 0; k <= Degree; ++k)
+		{
+			slopes[k] = k < padding ? 0.0f : BernsteinSlope(sample.degree, k - padding, sample.t) * stretch;
+		}
+		return slopes;
+	}
+
+	/*
+	Resampling table for one axis of a piecewise grid of degree-Degree patches, laid out as LocatePatchSample has
+	it. Entry i has the first control point sample i reads and its weights on them, and slopes are the d/dt of
+	the same weights, for the derivatives along the axis
+	*/
+	template<int Degree>
+	struct BernsteinTableOf
+	{
+		std::vector<int> offsets;
+		std::vector<std::array<float, Degree + 1>> weights;
+		std::vector<std::array<float, Degree + 1>> slopes;
+	};
+
+	template<int Degree>
+	BernsteinTableOf<Degree>
+	BuildBernsteinTableOf(size_t sourceSegments, size_t targetSamples)
+	{
+		BernsteinTableOf<Degree> table;
+		table.offsets.resize(targetSamples);
+		table.weights.resize(targetSamples);
+		table.slopes.resize(targetSamples);
+
+		for (size_t i = 0; i < targetSamples; ++i)
+		{
+			float global = (float)i / targetSamples;
+			float X = global * (float)sourceSegments;
+
+			const PatchSampleOf<Degree> sample = LocatePatchSample<Degree>(sourceSegments, X);
+			table.offsets[i] = sample.offset;
+			table.weights[i] = PatchSampleWeights(sample);
+			table.slopes[i] = PatchSampleSlopes(sample);
+		}
+		return table;
+	}
+
+	template<int Degree>
+	float
+	BernsteinFilterOf(const float* taps, size_t tapStride, const std::array<float, Degree + 1>& weights)
+	{
+		return BezierCurve<Degree, float>::Combine(taps, (std::ptrdiff_t)tapStride, weights);
+	}
+}
@@ -0,0 +1,486 @@
+#include "GradientNoiseLib.hpp"
+#include <chrono>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UTILAYRE_X86 1
+#include <emmintrin.h>
+#endif
+
+namespace utilAyre
+{
+	//large odd constants to spread the lattice coordinates across all 32 bits before they're mixed
+	static const uint32_t kPrimeX = 501125321u;
+	static const uint32_t kPrimeZ = 1136930381u;
+	static const uint32_t kHashMultiplier = 0x27d4eb2du;
+
+	static inline int FastFloor(float x)
+	{
+		int i = (int)x;
+		return x < (float)i ? i - 1 : i;
+	}
+
+	static inline uint32_t LatticeHash(uint32_t seed, uint32_t xPrimed, uint32_t zPrimed)
+	{
+		return (seed ^ xPrimed ^ zPrimed) * kHashMultiplier;
+	}
+
+	/*
+	The top three hash bits (the best mixed after the multiply) pick one of (+-1, +-0.5) or (+-0.5, +-1)
+	*/
+	static inline float LatticeGradient(uint32_t hash, float dx, float dz)
+	{
+		float a = (hash & 0x80000000u) ? dz : dx;
+		float b = (hash & 0x80000000u) ? dx : dz;
+		if (hash & 0x40000000u) a = -a;
+		if (hash & 0x20000000u) b = -b;
+		return a + b * 0.5f;
+	}
+
+	/*
+	The constant gradient behind LatticeGradient, what its dot product is with (dx, dz)
+	*/
+	static inline void LatticeSlope(uint32_t hash, float& gx, float& gz)
+	{
+		float a = (hash & 0x40000000u) ? -1.0f : 1.0f;
+		float b = (hash & 0x20000000u) ? -0.5f : 0.5f;
+		gx = (hash & 0x80000000u) ? b : a;
+		gz = (hash & 0x80000000u) ? a : b;
+	}
+
+	static inline float Fade(float t)
+	{
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+
+	static inline float FadeSlope(float t)
+	{
+		return t * t * (t * (t - 2.0f) + 1.0f) * 30.0f;
+	}
+
+	float GradientNoise(float x, float z, uint32_t seed)
+	{
+		int ix = FastFloor(x);
+		int iz = FastFloor(z);
+		float fx = x - (float)ix;
+		float fz = z - (float)iz;
+
+		uint32_t x0 = (uint32_t)ix * kPrimeX;
+		uint32_t z0 = (uint32_t)iz * kPrimeZ;
+		uint32_t x1 = x0 + kPrimeX;
+		uint32_t z1 = z0 + kPrimeZ;
+
+		float g00 = LatticeGradient(LatticeHash(seed, x0, z0), fx, fz);
+		float g10 = LatticeGradient(LatticeHash(seed, x1, z0), fx - 1.0f, fz);
+		float g01 = LatticeGradient(LatticeHash(seed, x0, z1), fx, fz - 1.0f);
+		float g11 = LatticeGradient(LatticeHash(seed, x1, z1), fx - 1.0f, fz - 1.0f);
+
+		float u = Fade(fx);
+		float v = Fade(fz);
+		float nearEdge = g00 + (g10 - g00) * u;
+		float farEdge = g01 + (g11 - g01) * u;
+		return nearEdge + (farEdge - nearEdge) * v;
+	}
+
+	float GradientNoise(float x, float z, uint32_t seed, float& dx, float& dz)
+	{
+		int ix = FastFloor(x);
+		int iz = FastFloor(z);
+		float fx = x - (float)ix;
+		float fz = z - (float)iz;
+
+		uint32_t x0 = (uint32_t)ix * kPrimeX;
+		uint32_t z0 = (uint32_t)iz * kPrimeZ;
+		uint32_t x1 = x0 + kPrimeX;
+		uint32_t z1 = z0 + kPrimeZ;
+
+		uint32_t h00 = LatticeHash(seed, x0, z0);
+		uint32_t h10 = LatticeHash(seed, x1, z0);
+		uint32_t h01 = LatticeHash(seed, x0, z1);
+		uint32_t h11 = LatticeHash(seed, x1, z1);
+
+		float g00 = LatticeGradient(h00, fx, fz);
+		float g10 = LatticeGradient(h10, fx - 1.0f, fz);
+		float g01 = LatticeGradient(h01, fx, fz - 1.0f);
+		float g11 = LatticeGradient(h11, fx - 1.0f, fz - 1.0f);
+
+		float g00x, g00z, g10x, g10z, g01x, g01z, g11x, g11z;
+		LatticeSlope(h00, g00x, g00z);
+		LatticeSlope(h10, g10x, g10z);
+		LatticeSlope(h01, g01x, g01z);
+		LatticeSlope(h11, g11x, g11z);
+
+		float u = Fade(fx);
+		float v = Fade(fz);
+		float du = FadeSlope(fx);
+		float dv = FadeSlope(fz);
+		float nearEdge = g00 + (g10 - g00) * u;
+		float farEdge = g01 + (g11 - g01) * u;
+
+		float nearX = g00x + (g10x - g00x) * u + (g10 - g00) * du;
+		float farX = g01x + (g11x - g01x) * u + (g11 - g01) * du;
+		float nearZ = g00z + (g10z - g00z) * u;
+		float farZ = g01z + (g11z - g01z) * u;
+		dx = nearX + (farX - nearX) * v;
+		dz = nearZ + (farZ - nearZ) * v + (farEdge - nearEdge) * dv;
+		return nearEdge + (farEdge - nearEdge) * v;
+	}
+
+	float GradientFbm(float x, float z, const NoiseSettings& settings, float& dx, float& dz)
+	{
+		float total = 0, totalX = 0, totalZ = 0;
+		float frequency = settings.frequency;
+		float amplitude = settings.gain;
+
+		for (int i = 0; i < settings.octaves; ++i)
+		{
+			float nx, nz;
+			total += GradientNoise(x * frequency, z * frequency, settings.seed + (uint32_t)i, nx, nz) * amplitude;
+			totalX += nx * (amplitude * frequency);
+			totalZ += nz * (amplitude * frequency);
+			frequency *= settings.lacunarity;
+			amplitude *= settings.gain;
+		}
+		dx = totalX * settings.scale;
+		dz = totalZ * settings.scale;
+		return total * settings.scale;
+	}
+
+	float GradientFbm(float x, float z, const NoiseSettings& settings)
+	{
+		float total = 0;
+		float frequency = settings.frequency;
+		float amplitude = settings.gain;
+
+		for (int i = 0; i < settings.octaves; ++i)
+		{
+			total += GradientNoise(x * frequency, z * frequency, settings.seed + (uint32_t)i) * amplitude;
+			frequency *= settings.lacunarity;
+			amplitude *= settings.gain;
+		}
+		return total * settings.scale;
+	}
+
+	/*
+	zStep is 1 for a z per sample or 0 for one z shared by the whole row
+	*/
+	static void GradientFbmScalar(const float* x, const float* z, size_t zStep, float* out, size_t count, const NoiseSettings& settings)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			out[i] = GradientFbm(x[i], z[i * zStep], settings);
+		}
+	}
+
+	static void GradientFbmSlopeScalar(const float* x, const float* z, size_t zStep, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			out[i] = GradientFbm(x[i], z[i * zStep], settings, outX[i], outZ[i]);
+		}
+	}
+
+#if defined(UTILAYRE_X86)
+	/*
+	SSE2 has no 32-bit low multiply (that's SSE4.1), so build it from two 32x32->64 multiplies
+	*/
+	static inline __m128i MulLo32(__m128i a, __m128i b)
+	{
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	static inline __m128 LatticeGradientSSE(__m128i hash, __m128 dx, __m128 dz)
+	{
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		__m128 swap = _mm_castsi128_ps(_mm_srai_epi32(hash, 31));
+		__m128 negateA = _mm_castsi128_ps(_mm_srai_epi32(_mm_slli_epi32(hash, 1), 31));
+		__m128 negateB = _mm_castsi128_ps(_mm_srai_epi32(_mm_slli_epi32(hash, 2), 31));
+
+		__m128 a = _mm_or_ps(_mm_and_ps(swap, dz), _mm_andnot_ps(swap, dx));
+		__m128 b = _mm_or_ps(_mm_and_ps(swap, dx), _mm_andnot_ps(swap, dz));
+		a = _mm_xor_ps(a, _mm_and_ps(negateA, signBit));
+		b = _mm_xor_ps(b, _mm_and_ps(negateB, signBit));
+		return _mm_add_ps(a, _mm_mul_ps(b, _mm_set1_ps(0.5f)));
+	}
+
+	static inline void LatticeSlopeSSE(__m128i hash, __m128& gx, __m128& gz)
+	{
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		__m128 swap = _mm_castsi128_ps(_mm_srai_epi32(hash, 31));
+		__m128 a = _mm_xor_ps(_mm_set1_ps(1.0f), _mm_and_ps(_mm_castsi128_ps(_mm_srai_epi32(_mm_slli_epi32(hash, 1), 31)), signBit));
+		__m128 b = _mm_xor_ps(_mm_set1_ps(0.5f), _mm_and_ps(_mm_castsi128_ps(_mm_srai_epi32(_mm_slli_epi32(hash, 2), 31)), signBit));
+		gx = _mm_or_ps(_mm_and_ps(swap, b), _mm_andnot_ps(swap, a));
+		gz = _mm_or_ps(_mm_and_ps(swap, a), _mm_andnot_ps(swap, b));
+	}
+
+	static inline __m128 FadeSlopeSSE(__m128 t)
+	{
+		__m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(t, _mm_set1_ps(2.0f))), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), inner), _mm_set1_ps(30.0f));
+	}
+
+	static inline __m128 FadeSSE(__m128 t)
+	{
+		__m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+	}
+
+	static inline __m128 GradientNoiseSSE(__m128 x, __m128 z, uint32_t seed)
+	{
+		const __m128i primeX = _mm_set1_epi32((int)kPrimeX);
+		const __m128i primeZ = _mm_set1_epi32((int)kPrimeZ);
+		const __m128i multiplier = _mm_set1_epi32((int)kHashMultiplier);
+		const __m128i seeds = _mm_set1_epi32((int)seed);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		//floor: truncate, then step down one wherever truncation rounded up (negative values)
+		__m128i tx = _mm_cvttps_epi32(x);
+		__m128i tz = _mm_cvttps_epi32(z);
+		__m128i ix = _mm_add_epi32(tx, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(tx))));
+		__m128i iz = _mm_add_epi32(tz, _mm_castps_si128(_mm_cmplt_ps(z, _mm_cvtepi32_ps(tz))));
+		__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+		__m128 fz = _mm_sub_ps(z, _mm_cvtepi32_ps(iz));
+
+		__m128i x0 = MulLo32(ix, primeX);
+		__m128i z0 = MulLo32(iz, primeZ);
+		__m128i x1 = _mm_add_epi32(x0, primeX);
+		__m128i z1 = _mm_add_epi32(z0, primeZ);
+
+		__m128i h00 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x0), z0), multiplier);
+		__m128i h10 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x1), z0), multiplier);
+		__m128i h01 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x0), z1), multiplier);
+		__m128i h11 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x1), z1), multiplier);
+
+		__m128 fx1 = _mm_sub_ps(fx, one);
+		__m128 fz1 = _mm_sub_ps(fz, one);
+		__m128 g00 = LatticeGradientSSE(h00, fx, fz);
+		__m128 g10 = LatticeGradientSSE(h10, fx1, fz);
+		__m128 g01 = LatticeGradientSSE(h01, fx, fz1);
+		__m128 g11 = LatticeGradientSSE(h11, fx1, fz1);
+
+		__m128 u = FadeSSE(fx);
+		__m128 v = FadeSSE(fz);
+		__m128 nearEdge = _mm_add_ps(g00, _mm_mul_ps(_mm_sub_ps(g10, g00), u));
+		__m128 farEdge = _mm_add_ps(g01, _mm_mul_ps(_mm_sub_ps(g11, g01), u));
+		return _mm_add_ps(nearEdge, _mm_mul_ps(_mm_sub_ps(farEdge, nearEdge), v));
+	}
+
+	/*
+	GradientNoiseSSE plus the two partial derivatives, in the scalar version's order
+	*/
+	static inline __m128 GradientNoiseSlopeSSE(__m128 x, __m128 z, uint32_t seed, __m128& dx, __m128& dz)
+	{
+		const __m128i primeX = _mm_set1_epi32((int)kPrimeX);
+		const __m128i primeZ = _mm_set1_epi32((int)kPrimeZ);
+		const __m128i multiplier = _mm_set1_epi32((int)kHashMultiplier);
+		const __m128i seeds = _mm_set1_epi32((int)seed);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		__m128i tx = _mm_cvttps_epi32(x);
+		__m128i tz = _mm_cvttps_epi32(z);
+		__m128i ix = _mm_add_epi32(tx, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(tx))));
+		__m128i iz = _mm_add_epi32(tz, _mm_castps_si128(_mm_cmplt_ps(z, _mm_cvtepi32_ps(tz))));
+		__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+		__m128 fz = _mm_sub_ps(z, _mm_cvtepi32_ps(iz));
+
+		__m128i x0 = MulLo32(ix, primeX);
+		__m128i z0 = MulLo32(iz, primeZ);
+		__m128i x1 = _mm_add_epi32(x0, primeX);
+		__m128i z1 = _mm_add_epi32(z0, primeZ);
+
+		__m128i h00 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x0), z0), multiplier);
+		__m128i h10 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x1), z0), multiplier);
+		__m128i h01 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x0), z1), multiplier);
+		__m128i h11 = MulLo32(_mm_xor_si128(_mm_xor_si128(seeds, x1), z1), multiplier);
+
+		__m128 g00x, g00z, g10x, g10z, g01x, g01z, g11x, g11z;
+		LatticeSlopeSSE(h00, g00x, g00z);
+		LatticeSlopeSSE(h10, g10x, g10z);
+		LatticeSlopeSSE(h01, g01x, g01z);
+		LatticeSlopeSSE(h11, g11x, g11z);
+
+		//both products are exact (the gradient is a signed 1 or 0.5) and the add doesn't care about order, so this
+		//is the same bits as LatticeGradientSSE without picking the components out a second time
+		__m128 fx1 = _mm_sub_ps(fx, one);
+		__m128 fz1 = _mm_sub_ps(fz, one);
+		__m128 g00 = _mm_add_ps(_mm_mul_ps(g00x, fx), _mm_mul_ps(g00z, fz));
+		__m128 g10 = _mm_add_ps(_mm_mul_ps(g10x, fx1), _mm_mul_ps(g10z, fz));
+		__m128 g01 = _mm_add_ps(_mm_mul_ps(g01x, fx), _mm_mul_ps(g01z, fz1));
+		__m128 g11 = _mm_add_ps(_mm_mul_ps(g11x, fx1), _mm_mul_ps(g11z, fz1));
+
+		__m128 u = FadeSSE(fx);
+		__m128 v = FadeSSE(fz);
+		__m128 du = FadeSlopeSSE(fx);
+		__m128 dv = FadeSlopeSSE(fz);
+		__m128 nearEdge = _mm_add_ps(g00, _mm_mul_ps(_mm_sub_ps(g10, g00), u));
+		__m128 farEdge = _mm_add_ps(g01, _mm_mul_ps(_mm_sub_ps(g11, g01), u));
+
+		__m128 nearX = _mm_add_ps(_mm_add_ps(g00x, _mm_mul_ps(_mm_sub_ps(g10x, g00x), u)), _mm_mul_ps(_mm_sub_ps(g10, g00), du));
+		__m128 farX = _mm_add_ps(_mm_add_ps(g01x, _mm_mul_ps(_mm_sub_ps(g11x, g01x), u)), _mm_mul_ps(_mm_sub_ps(g11, g01), du));
+		__m128 nearZ = _mm_add_ps(g00z, _mm_mul_ps(_mm_sub_ps(g10z, g00z), u));
+		__m128 farZ = _mm_add_ps(g01z, _mm_mul_ps(_mm_sub_ps(g11z, g01z), u));
+		dx = _mm_add_ps(nearX, _mm_mul_ps(_mm_sub_ps(farX, nearX), v));
+		dz = _mm_add_ps(_mm_add_ps(nearZ, _mm_mul_ps(_mm_sub_ps(farZ, nearZ), v)), _mm_mul_ps(_mm_sub_ps(farEdge, nearEdge), dv));
+		return _mm_add_ps(nearEdge, _mm_mul_ps(_mm_sub_ps(farEdge, nearEdge), v));
+	}
+
+	static void GradientFbmSlopeSSE(const float* x, const float* z, size_t zStep, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 px = _mm_loadu_ps(x + i);
+			__m128 pz = zStep ? _mm_loadu_ps(z + i) : _mm_set1_ps(*z);
+			__m128 total = _mm_setzero_ps();
+			__m128 totalX = _mm_setzero_ps();
+			__m128 totalZ = _mm_setzero_ps();
+			float frequency = settings.frequency;
+			float amplitude = settings.gain;
+
+			for (int octave = 0; octave < settings.octaves; ++octave)
+			{
+				__m128 f = _mm_set1_ps(frequency);
+				__m128 nx, nz;
+				__m128 n = GradientNoiseSlopeSSE(_mm_mul_ps(px, f), _mm_mul_ps(pz, f), settings.seed + (uint32_t)octave, nx, nz);
+				__m128 slopeScale = _mm_set1_ps(amplitude * frequency);
+				total = _mm_add_ps(total, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+				totalX = _mm_add_ps(totalX, _mm_mul_ps(nx, slopeScale));
+				totalZ = _mm_add_ps(totalZ, _mm_mul_ps(nz, slopeScale));
+				frequency *= settings.lacunarity;
+				amplitude *= settings.gain;
+			}
+			__m128 scale = _mm_set1_ps(settings.scale);
+			_mm_storeu_ps(out + i, _mm_mul_ps(total, scale));
+			_mm_storeu_ps(outX + i, _mm_mul_ps(totalX, scale));
+			_mm_storeu_ps(outZ + i, _mm_mul_ps(totalZ, scale));
+		}
+		GradientFbmSlopeScalar(x + i, z + i * zStep, zStep, out + i, outX + i, outZ + i, count - i, settings);
+	}
+
+	static void GradientFbmSSE(const float* x, const float* z, size_t zStep, float* out, size_t count, const NoiseSettings& settings)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 px = _mm_loadu_ps(x + i);
+			__m128 pz = zStep ? _mm_loadu_ps(z + i) : _mm_set1_ps(*z);
+			__m128 total = _mm_setzero_ps();
+			float frequency = settings.frequency;
+			float amplitude = settings.gain;
+
+			for (int octave = 0; octave < settings.octaves; ++octave)
+			{
+				__m128 f = _mm_set1_ps(frequency);
+				__m128 n = GradientNoiseSSE(_mm_mul_ps(px, f), _mm_mul_ps(pz, f), settings.seed + (uint32_t)octave);
+				total = _mm_add_ps(total, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+				frequency *= settings.lacunarity;
+				amplitude *= settings.gain;
+			}
+			_mm_storeu_ps(out + i, _mm_mul_ps(total, _mm_set1_ps(settings.scale)));
+		}
+		GradientFbmScalar(x + i, z + i * zStep, zStep, out + i, count - i, settings); //leftover tail
+	}
+#endif
+
+	static void GradientFbmKernel(SimdLevel level, const float* x, const float* z, size_t zStep, float* out, size_t count, const NoiseSettings& settings)
+	{
+#if defined(UTILAYRE_X86)
+		if (level != SimdLevel::Scalar)
+		{
+			GradientFbmSSE(x, z, zStep, out, count, settings);
+			return;
+		}
+#endif
+		GradientFbmScalar(x, z, zStep, out, count, settings);
+	}
+
+	static void GradientFbmSlopeKernel(SimdLevel level, const float* x, const float* z, size_t zStep, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings)
+	{
+#if defined(UTILAYRE_X86)
+		if (level != SimdLevel::Scalar)
+		{
+			GradientFbmSlopeSSE(x, z, zStep, out, outX, outZ, count, settings);
+			return;
+		}
+#endif
+		GradientFbmSlopeScalar(x, z, zStep, out, outX, outZ, count, settings);
+	}
+
+	void GradientFbmBatch(SimdLevel level, const float* x, const float* z, float* out, size_t count, const NoiseSettings& settings)
+	{
+		GradientFbmKernel(level, x, z, 1, out, count, settings);
+	}
+
+	void GradientFbmBatch(const float* x, const float* z, float* out, size_t count, const NoiseSettings& settings)
+	{
+		static const SimdLevel level = DetectSimdLevel();
+		GradientFbmKernel(level, x, z, 1, out, count, settings);
+	}
+
+	void GradientFbmGrid(const float* xs, size_t countX, const float* zs, size_t countZ, float* out, const NoiseSettings& settings)
+	{
+		static const SimdLevel level = DetectSimdLevel();
+		for (size_t row = 0; row < countZ; ++row)
+		{
+			GradientFbmKernel(level, xs, zs + row, 0, out + row * countX, countX, settings);
+		}
+	}
+
+	void GradientFbmBatch(SimdLevel level, const float* x, const float* z, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings)
+	{
+		GradientFbmSlopeKernel(level, x, z, 1, out, outX, outZ, count, settings);
+	}
+
+	void GradientFbmBatch(const float* x, const float* z, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings)
+	{
+		static const SimdLevel level = DetectSimdLevel();
+		GradientFbmSlopeKernel(level, x, z, 1, out, outX, outZ, count, settings);
+	}
+
+	void GradientFbmGrid(const float* xs, size_t countX, const float* zs, size_t countZ, float* out, float* outX, float* outZ, const NoiseSettings& settings)
+	{
+		static const SimdLevel level = DetectSimdLevel();
+		for (size_t row = 0; row < countZ; ++row)
+		{
+			GradientFbmSlopeKernel(level, xs, zs + row, 0, out + row * countX, outX + row * countX, outZ + row * countX, countX, settings);
+		}
+	}
+
+	void ReportNoiseBenchmark(size_t sampleCount, const NoiseSettings& settings, std::ostream& out)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+
+		//lay the samples out like a 1024 wide terrain with 8 unit spacing
+		std::vector<float> xs(sampleCount), zs(sampleCount);
+		for (size_t i = 0; i < sampleCount; ++i)
+		{
+			xs[i] = (float)(i % 1024) * 8.0f;
+			zs[i] = (float)(i / 1024) * 8.0f;
+		}
+
+		std::vector<float> legacy(sampleCount), scalar(sampleCount), batch(sampleCount);
+
+		auto start = Clock::now();
+		for (size_t i = 0; i < sampleCount; ++i)
+		{
+			legacy[i] = Brownian(glm::vec3(xs[i], 0, zs[i]), settings).y;
+		}
+		double legacyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		GradientFbmBatch(SimdLevel::Scalar, xs.data(), zs.data(), scalar.data(), sampleCount, settings);
+		double scalarMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		GradientFbmBatch(xs.data(), zs.data(), batch.data(), sampleCount, settings);
+		double batchMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+
+		out << "Terrain noise, " << sampleCount << " samples x " << settings.octaves << " octaves" << std::endl;
+		out << "  Brownian (per vertex): " << legacyMs << " ms" << std::endl;
+		out << "  gradient scalar: " << scalarMs << " ms, " << legacyMs / scalarMs << "x" << std::endl;
+		out << "  gradient batch (" << SimdLevelName(DetectSimdLevel()) << "): " << batchMs << " ms, " << legacyMs / batchMs << "x" << std::endl;
+	}
+}
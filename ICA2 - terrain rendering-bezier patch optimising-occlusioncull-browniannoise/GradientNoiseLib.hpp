@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include "NoiseBezierLib.hpp"
+
+/*
+Seeded 2D gradient noise for the terrain detail, replacing the old PerlinNoise/Brownian pair.
+
+The old PerlinNoise took int coordinates, so everything below a whole unit was thrown away and the cosine
+blend was always fed whole numbers (it only ever returned a lattice value). This keeps the fraction:
+each lattice corner hashes (seed, x, z) to one of 8 gradients, the corner dot products are blended with
+the quintic fade curve and there are no trig calls anywhere.
+
+Every sample is a pure function of its coordinates and the settings, and the SSE kernel repeats the scalar
+operation order exactly, so a height comes out the same bits whichever kernel, batch size or thread made it
+*/
+namespace utilAyre
+{
+	float GradientNoise(float x, float z, uint32_t seed);
+
+	/*
+	Fractal sum of NoiseSettings::octaves layers of GradientNoise, already multiplied by the scale.
+	Octave i uses seed + i so the layers don't line up with each other
+	*/
+	float GradientFbm(float x, float z, const NoiseSettings& settings);
+
+	/*
+	Batch versions. out[i] = GradientFbm(x[i], z[i]). The grid version fills countZ rows of countX heights,
+	row major, from one array of column x's and one of row z's, which is all a regular terrain grid needs.
+	Integer hashing needs AVX2 for 8 wide, so the AVX level runs the 4 wide SSE kernel
+	*/
+	void GradientFbmBatch(const float* x, const float* z, float* out, size_t count, const NoiseSettings& settings);
+
+	void GradientFbmBatch(SimdLevel level, const float* x, const float* z, float* out, size_t count, const NoiseSettings& settings);
+
+	void GradientFbmGrid(const float* xs, size_t countX, const float* zs, size_t countZ, float* out, const NoiseSettings& settings);
+
+	/*
+	The same noise plus its analytic gradient, d/dx and d/dz in the units x and z are in. The values are the same
+	bits as the versions without, the slopes come out of the fade curve's derivative and each corner's gradient
+	blended with the same weights, and the SSE kernel matches the scalar one bit for bit here too
+	*/
+	float GradientNoise(float x, float z, uint32_t seed, float& dx, float& dz);
+
+	float GradientFbm(float x, float z, const NoiseSettings& settings, float& dx, float& dz);
+
+	void GradientFbmBatch(const float* x, const float* z, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings);
+
+	void GradientFbmBatch(SimdLevel level, const float* x, const float* z, float* out, float* outX, float* outZ, size_t count, const NoiseSettings& settings);
+
+	void GradientFbmGrid(const float* xs, size_t countX, const float* zs, size_t countZ, float* out, float* outX, float* outZ, const NoiseSettings& settings);
+
+	/*
+	Times the old per-vertex Brownian against the scalar and batched gradient noise over sampleCount points.
+	That the kernels agree bit for bit is the noise_kernels check's job
+	*/
+	void ReportNoiseBenchmark(size_t sampleCount, const NoiseSettings& settings, std::ostream& out);
+}
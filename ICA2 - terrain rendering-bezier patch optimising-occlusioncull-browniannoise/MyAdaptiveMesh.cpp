@@ -0,0 +1,325 @@
+#include "MyAdaptiveMesh.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/*
+Triangles are numbered like a heap: 2 and 3 are the two halves of the square, and the children of id are
+2 * id and 2 * id + 1. Walking the bits of the id from the top gives the corners without storing them, which
+for a 1025 grid saves 16 MB of coordinates. a and b are the ends of the hypotenuse, c the right angle
+*/
+static void
+TriangleCorners(size_t id, int tileSize, int& ax, int& az, int& bx, int& bz, int& cx, int& cz)
+{
+	ax = az = bx = bz = cx = cz = 0;
+	if (id & 1)
+	{
+		bx = bz = cx = tileSize;
+	}
+	else
+	{
+		ax = az = cz = tileSize;
+	}
+
+	while ((id >>= 1) > 1)
+	{
+		int mx = (ax + bx) >> 1;
+		int mz = (az + bz) >> 1;
+
+		if (id & 1) //left half
+		{
+			bx = ax; bz = az;
+			ax = cx; az = cz;
+		}
+		else //right half
+		{
+			ax = bx; az = bz;
+			bx = cx; bz = cz;
+		}
+		cx = mx;
+		cz = mz;
+	}
+}
+
+/*
+Rounds towards minus infinity, for a positive divisor
+*/
+static inline long long
+FloorDivide(long long numerator, long long divisor)
+{
+	return numerator >= 0 ? numerator / divisor : -((-numerator + divisor - 1) / divisor);
+}
+
+/*
+Worst vertical distance between the plane through a triangle's corners and the grid heights inside it (edges
+included). The three edge functions are linear along a row, so each row's inside span is found from them up
+front and the inner loop is straight-line
+*/
+float AdaptiveTerrainMesher::
+TriangleError(int ax, int az, int bx, int bz, int cx, int cz) const
+{
+	long long area = (long long)(bx - ax) * (cz - az) - (long long)(bz - az) * (cx - ax);
+	if (area == 0)
+		return 0;
+
+	//flip to anticlockwise so inside means every edge function is >= 0
+	if (area < 0)
+	{
+		std::swap(bx, cx);
+		std::swap(bz, cz);
+		area = -area;
+	}
+
+	const float ha = HeightAt(ax, az);
+	const float hb = HeightAt(bx, bz);
+	const float hc = HeightAt(cx, cz);
+	const float inverseArea = 1.0f / (float)area;
+
+	const int minX = std::min(ax, std::min(bx, cx)), maxX = std::max(ax, std::max(bx, cx));
+	const int minZ = std::min(az, std::min(bz, cz)), maxZ = std::max(az, std::max(bz, cz));
+
+	const long long stepA = bz - cz;
+	const long long stepB = cz - az;
+	const long long stepC = -stepA - stepB;
+
+	float worst = 0;
+	for (int z = minZ; z <= maxZ; ++z)
+	{
+		//edge functions at x = 0 on this row
+		const long long wa0 = (long long)bx * (cz - z) - (long long)(bz - z) * cx;
+		const long long wb0 = (long long)cx * (az - z) - (long long)(cz - z) * ax;
+		const long long wc0 = area - wa0 - wb0;
+
+		long long first = minX, last = maxX;
+		const long long w0[3] = { wa0, wb0, wc0 };
+		const long long step[3] = { stepA, stepB, stepC };
+		for (int e = 0; e < 3; ++e)
+		{
+			//w0 + step * x >= 0
+			if (step[e] > 0)
+				first = std::max(first, -FloorDivide(w0[e], step[e]));
+			else if (step[e] < 0)
+				last = std::min(last, FloorDivide(w0[e], -step[e]));
+			else if (w0[e] < 0)
+				first = last + 1;
+		}
+
+		const float* row = &heights[(size_t)z * gridSize];
+		for (long long x = first; x <= last; ++x)
+		{
+			float wa = (float)(wa0 + stepA * x);
+			float wb = (float)(wb0 + stepB * x);
+			float wc = (float)(wc0 + stepC * x);
+			float plane = (wa * ha + wb * hb + wc * hc) * inverseArea;
+			worst = std::max(worst, std::fabs(plane - row[x]));
+		}
+	}
+	return worst;
+}
+
+float AdaptiveTerrainMesher::
+HeightAt(int x, int z) const
+{
+	return heights[(size_t)z * gridSize + x];
+}
+
+uint32_t AdaptiveTerrainMesher::
+GridIndex(int x, int z) const
+{
+	size_t cx = std::min((size_t)x, vertsX - 1);
+	size_t cz = std::min((size_t)z, vertsZ - 1);
+	return (uint32_t)(cz * vertsX + cx);
+}
+
+/*
+Smallest triangles first, so by the time a parent is reached its children's midpoints already hold the
+worst error underneath them. A triangle's error is measured against every grid vertex it covers, not just the
+midpoint of its hypotenuse, so leaving it unsplit really does keep the whole of it inside the limit. One that
+runs off the real grid is measured again with its corners clamped, as it gets drawn. That's a pass over the
+grid per level, 20 for a 1025 grid
+*/
+void AdaptiveTerrainMesher::
+Build(const Vertex* vertices, size_t vertsX, size_t vertsZ)
+{
+	this->vertsX = vertsX;
+	this->vertsZ = vertsZ;
+
+	int tileSize = 1;
+	while ((size_t)tileSize + 1 < std::max(vertsX, vertsZ))
+	{
+		tileSize *= 2;
+	}
+	gridSize = tileSize + 1;
+
+	//heights copied out onto the RTIN square with the clamp baked in, 4 bytes a sample instead of a 40 byte stride
+	heights.resize((size_t)gridSize * gridSize);
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			heights[(size_t)z * gridSize + x] = vertices[GridIndex(x, z)].p.y;
+		}
+	}
+
+	errors.assign((size_t)gridSize * gridSize, 0.0f);
+
+	const size_t triangleCount = (size_t)tileSize * tileSize * 2 - 2;
+	const size_t parentCount = triangleCount - (size_t)tileSize * tileSize;
+
+	for (size_t i = triangleCount; i-- > 0;)
+	{
+		int ax, az, bx, bz, cx, cz;
+		TriangleCorners(i + 2, tileSize, ax, az, bx, bz, cx, cz);
+
+		const int mx = (ax + bx) >> 1;
+		const int mz = (az + bz) >> 1;
+		const size_t middle = (size_t)mz * gridSize + mx;
+
+		float error = std::max(errors[middle], TriangleError(ax, az, bx, bz, cx, cz));
+
+		//past the far edges EmitTriangle draws the triangle between the clamped corners, which isn't this one
+		const int lastX = (int)vertsX - 1, lastZ = (int)vertsZ - 1;
+		if (std::max(ax, std::max(bx, cx)) > lastX || std::max(az, std::max(bz, cz)) > lastZ)
+		{
+			error = std::max(error, TriangleError(std::min(ax, lastX), std::min(az, lastZ), std::min(bx, lastX), std::min(bz, lastZ),
+				std::min(cx, lastX), std::min(cz, lastZ)));
+		}
+
+		if (i < parentCount)
+		{
+			const size_t left = (size_t)((az + cz) >> 1) * gridSize + ((ax + cx) >> 1);
+			const size_t right = (size_t)((bz + cz) >> 1) * gridSize + ((bx + cx) >> 1);
+			error = std::max(error, std::max(errors[left], errors[right]));
+		}
+		errors[middle] = error;
+	}
+}
+
+void AdaptiveTerrainMesher::
+Extract(float maxError, AdaptiveMesh& mesh) const
+{
+	mesh.indices.clear();
+	mesh.vertexCount = 0;
+	if (gridSize < 2)
+		return;
+
+	const int tileSize = gridSize - 1;
+	Split(0, 0, tileSize, tileSize, tileSize, 0, maxError, mesh);
+	Split(tileSize, tileSize, 0, 0, 0, tileSize, maxError, mesh);
+
+	std::vector<bool> used(vertsX * vertsZ, false);
+	for (uint32_t index : mesh.indices)
+	{
+		if (!used[index])
+		{
+			used[index] = true;
+			mesh.vertexCount++;
+		}
+	}
+}
+
+void AdaptiveTerrainMesher::
+Split(int ax, int az, int bx, int bz, int cx, int cz, float maxError, AdaptiveMesh& mesh) const
+{
+	const int mx = (ax + bx) >> 1;
+	const int mz = (az + bz) >> 1;
+
+	//a grid cell's halves have legs of 1, so the hypotenuse has no midpoint left to split at
+	if (std::abs(ax - cx) + std::abs(az - cz) > 1 && errors[(size_t)mz * gridSize + mx] > maxError)
+	{
+		Split(cx, cz, ax, az, mx, mz, maxError, mesh);
+		Split(bx, bz, cx, cz, mx, mz, maxError, mesh);
+	}
+	else
+	{
+		EmitTriangle(ax, az, bx, bz, cx, cz, mesh);
+	}
+}
+
+/*
+Corners go through the clamp first, so anything that lands in the strip past the real grid comes out with two
+corners the same and gets dropped. The rest are flipped where needed to wind like MakeMesh, which is
+anticlockwise with x across and z down the grid
+*/
+void AdaptiveTerrainMesher::
+EmitTriangle(int ax, int az, int bx, int bz, int cx, int cz, AdaptiveMesh& mesh) const
+{
+	uint32_t a = GridIndex(ax, az);
+	uint32_t b = GridIndex(bx, bz);
+	uint32_t c = GridIndex(cx, cz);
+	if (a == b || b == c || a == c)
+		return;
+
+	const long long ux = (long long)(b % vertsX) - (long long)(a % vertsX);
+	const long long uz = (long long)(b / vertsX) - (long long)(a / vertsX);
+	const long long vx = (long long)(c % vertsX) - (long long)(a % vertsX);
+	const long long vz = (long long)(c / vertsX) - (long long)(a / vertsX);
+	const long long winding = ux * vz - uz * vx;
+	if (winding == 0)
+		return;
+
+	mesh.indices.push_back(a);
+	if (winding > 0)
+	{
+		mesh.indices.push_back(b);
+		mesh.indices.push_back(c);
+	}
+	else
+	{
+		mesh.indices.push_back(c);
+		mesh.indices.push_back(b);
+	}
+}
+
+std::vector<Vertex>
+CompactAdaptiveMesh(const Vertex* vertices, AdaptiveMesh& mesh)
+{
+	std::vector<Vertex> compacted;
+	compacted.reserve(mesh.vertexCount);
+
+	std::vector<uint32_t> remap;
+	for (uint32_t& index : mesh.indices)
+	{
+		if (index >= remap.size())
+			remap.resize(index + 1, UINT32_MAX);
+
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = (uint32_t)compacted.size();
+			compacted.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	return compacted;
+}
+
+void
+ReportAdaptiveMesh(const Vertex* vertices, size_t vertsX, size_t vertsZ, const std::vector<float>& maxErrors, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	auto start = Clock::now();
+	AdaptiveTerrainMesher mesher;
+	mesher.Build(vertices, vertsX, vertsZ);
+	double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	const size_t fullTriangles = (vertsX - 1) * (vertsZ - 1) * 2;
+	const size_t fullVertices = vertsX * vertsZ;
+
+	out << "Adaptive mesh over " << vertsX << "x" << vertsZ << " (RTIN " << mesher.GridSize() << "), errors built in " << buildMs << " ms" << std::endl;
+	out << "  full grid: " << fullTriangles << " triangles, " << fullVertices << " vertices, "
+		<< (fullTriangles * 3 * sizeof(uint32_t) + fullVertices * sizeof(Vertex)) / 1024 << " KB" << std::endl;
+
+	AdaptiveMesh mesh;
+	for (float maxError : maxErrors)
+	{
+		start = Clock::now();
+		mesher.Extract(maxError, mesh);
+		double extractMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		size_t triangles = mesh.indices.size() / 3;
+		size_t bytes = mesh.indices.size() * sizeof(uint32_t) + mesh.vertexCount * sizeof(Vertex);
+		out << "  max error " << maxError << ": " << triangles << " triangles, " << mesh.vertexCount << " vertices, " << bytes / 1024 << " KB compacted ("
+			<< (double)fullTriangles / std::max<size_t>(triangles, 1) << "x fewer triangles) in " << extractMs << " ms" << std::endl;
+	}
+}
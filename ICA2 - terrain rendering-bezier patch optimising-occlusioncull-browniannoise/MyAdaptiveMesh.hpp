@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "MyTerrain.hpp"
+
+/*
+Error-bounded triangulation of the finished heightfield, as an alternative to MakeMesh's uniform grid.
+
+It's a right-triangulated irregular network (RTIN): the grid is two big right triangles, and any triangle can
+be split in half across its hypotenuse, down to single grid cells. For every vertex that is the midpoint of
+some hypotenuse, Build works out the worst vertical error of leaving that split undone (over every grid vertex
+either triangle covers), folded up from its children so a parent is never coarser than anything under it. Extract then splits top-down wherever that
+error is over the limit. Splits shared by two triangles see the same error on both sides, so the mesh never
+has cracks or T-junctions.
+
+RTIN wants a 2^k + 1 square. Anything else (the 1024 wide hi-res grid, for one) is treated as the next size up
+with the coordinates past the edge clamped back onto it, so the extra strip folds down into zero-area
+triangles, and those are dropped. A triangle crossing the edge gets drawn between its clamped corners, so its
+error is measured on that triangle as well. Every index in the result is a plain grid index, so the mesh draws straight
+from the terrain's existing vertex buffer, and winds the same way as MakeMesh
+*/
+struct AdaptiveMesh
+{
+	std::vector<uint32_t> indices; //GL_TRIANGLES, indexing the full grid
+	size_t vertexCount{ 0 };       //distinct grid vertices the triangles use
+};
+
+class AdaptiveTerrainMesher
+{
+public:
+
+	void
+	Build(const Vertex* vertices, size_t vertsX, size_t vertsZ);
+
+	/*
+	Splits until no grid vertex is more than maxError (world units, vertically) off the surface.
+	0 only leaves out vertices that are exactly on it already, and a negative limit gives back the full grid
+	*/
+	void
+	Extract(float maxError, AdaptiveMesh& mesh) const;
+
+	size_t
+	GridSize() const { return gridSize; }
+
+private:
+
+	float
+	TriangleError(int ax, int az, int bx, int bz, int cx, int cz) const;
+
+	float
+	HeightAt(int x, int z) const;
+
+	uint32_t
+	GridIndex(int x, int z) const;
+
+	void
+	Split(int ax, int az, int bx, int bz, int cx, int cz, float maxError, AdaptiveMesh& mesh) const;
+
+	void
+	EmitTriangle(int ax, int az, int bx, int bz, int cx, int cz, AdaptiveMesh& mesh) const;
+
+	size_t vertsX{ 0 }, vertsZ{ 0 };
+	int gridSize{ 0 }; //2^k + 1, at least the bigger side of the grid
+	std::vector<float> heights; //gridSize * gridSize, clamped copy of the grid
+	std::vector<float> errors;  //gridSize * gridSize, per hypotenuse midpoint
+};
+
+/*
+Drops the vertices the mesh doesn't use and renumbers its indices, for when the adaptive mesh should get its
+own, smaller, vertex buffer
+*/
+std::vector<Vertex>
+CompactAdaptiveMesh(const Vertex* vertices, AdaptiveMesh& mesh);
+
+/*
+Triangles, vertices and buffer sizes against the full grid for each error limit, and the time to build and
+to extract
+*/
+void
+ReportAdaptiveMesh(const Vertex* vertices, size_t vertsX, size_t vertsZ, const std::vector<float>& maxErrors, std::ostream& out);
@@ -0,0 +1,189 @@
+#include "MyBuildProfiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+const char*
+BuildStageName(BuildStage stage)
+{
+	switch (stage)
+	{
+	case BuildStage::MakeMesh: return "make mesh";
+	case BuildStage::Heightmap: return "heightmap";
+	case BuildStage::Interpolation: return "interpolation";
+	case BuildStage::Noise: return "noise";
+	case BuildStage::Normals: return "normals";
+	case BuildStage::Fused: return "fused build";
+	case BuildStage::Upload: return "upload";
+	default: return "?";
+	}
+}
+
+static double
+WallMilliseconds()
+{
+	typedef std::chrono::steady_clock Clock;
+	return std::chrono::duration<double, std::milli>(Clock::now().time_since_epoch()).count();
+}
+
+double
+ProcessCpuMilliseconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) / 10000.0; //100ns ticks
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#endif
+}
+
+size_t
+PeakMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return (size_t)usage.ru_maxrss * 1024; //kilobytes on Linux
+#endif
+}
+
+void BuildProfiler::
+Begin(BuildStage stage)
+{
+	wallStart[(int)stage] = WallMilliseconds();
+	cpuStart[(int)stage] = ProcessCpuMilliseconds();
+}
+
+/*
+A stage that runs more than once (the base and hi-res MakeMesh, say) adds up
+*/
+void BuildProfiler::
+End(BuildStage stage, size_t vertices)
+{
+	StageTiming& timing = timings[(int)stage];
+	timing.ran = true;
+	timing.wallMilliseconds += WallMilliseconds() - wallStart[(int)stage];
+	timing.cpuMilliseconds += ProcessCpuMilliseconds() - cpuStart[(int)stage];
+	timing.vertices += vertices;
+	timing.peakBytes = PeakMemoryBytes();
+}
+
+const StageTiming& BuildProfiler::
+Timing(BuildStage stage) const
+{
+	return timings[(int)stage];
+}
+
+void BuildProfiler::
+Report(std::ostream& out) const
+{
+	out << "Terrain build stages" << std::endl;
+
+	double totalWall = 0, totalCpu = 0;
+	for (int i = 0; i < (int)BuildStage::Count; ++i)
+	{
+		const StageTiming& timing = timings[i];
+		if (!timing.ran)
+			continue;
+
+		totalWall += timing.wallMilliseconds;
+		totalCpu += timing.cpuMilliseconds;
+
+		double verticesPerSecond = timing.wallMilliseconds > 0 ? timing.vertices / (timing.wallMilliseconds / 1000.0) : 0;
+		out << "  " << std::left << std::setw(14) << BuildStageName((BuildStage)i) << std::right
+			<< " wall " << timing.wallMilliseconds << " ms, cpu " << timing.cpuMilliseconds << " ms, "
+			<< verticesPerSecond / 1e6 << " Mverts/s, peak " << timing.peakBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+	out << "  total wall " << totalWall << " ms, cpu " << totalCpu << " ms" << std::endl;
+}
+
+BuildProfiler::Scope::Scope(BuildProfiler& profiler, BuildStage stage, size_t vertices)
+	: profiler(profiler), stage(stage), vertices(vertices)
+{
+	profiler.Begin(stage);
+}
+
+BuildProfiler::Scope::~Scope()
+{
+	profiler.End(stage, vertices);
+}
+
+BuildProgress::BuildProgress(Callback callback, int steps)
+	: callback(callback), steps(steps > 0 ? steps : 1), stage(0), done(0), total(0), lastStep(0)
+{
+}
+
+void BuildProgress::
+BeginStage(BuildStage stage, size_t totalWork)
+{
+	this->stage = (int)stage;
+	done = 0;
+	total = totalWork;
+	lastStep = 0;
+}
+
+/*
+Only the thread that wins the exchange for a step reports it, so every step gets reported exactly once
+*/
+void BuildProgress::
+Advance(size_t work)
+{
+	const size_t stageTotal = total.load(std::memory_order_relaxed);
+	const size_t now = done.fetch_add(work, std::memory_order_relaxed) + work;
+	if (!callback || stageTotal == 0)
+		return;
+
+	int step = (int)(std::min(now, stageTotal) * steps / stageTotal);
+	int last = lastStep.load(std::memory_order_relaxed);
+	while (step > last)
+	{
+		if (lastStep.compare_exchange_weak(last, step, std::memory_order_relaxed))
+		{
+			callback((BuildStage)stage.load(std::memory_order_relaxed), (float)step / steps);
+			return;
+		}
+	}
+}
+
+float BuildProgress::
+Fraction() const
+{
+	const size_t stageTotal = total.load(std::memory_order_relaxed);
+	if (stageTotal == 0)
+		return 0;
+	return std::min(1.0f, (float)done.load(std::memory_order_relaxed) / stageTotal);
+}
+
+BuildStage BuildProgress::
+Stage() const
+{
+	return (BuildStage)stage.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+
+/*
+Instrumentation for the terrain build: wall and CPU time per stage, how many vertices each stage got through
+and the process's peak memory, plus a progress counter the build passes can bump from any thread.
+
+The old build printed "N% Bezier Processed" from inside the interpolation loop. Now the passes only add to an
+atomic counter once per row, and the callback only runs when the total crosses another step, so nothing in
+the hot loops ever waits on a lock or an ostream
+*/
+enum class BuildStage
+{
+	MakeMesh,
+	Heightmap,
+	Interpolation,
+	Noise,
+	Normals,
+	Fused,  //interpolation, noise and normals in one tiled pass
+	Upload,
+	Count
+};
+
+const char*
+BuildStageName(BuildStage stage);
+
+/*
+CPU time of the whole process (every thread) and its peak resident memory so far
+*/
+double
+ProcessCpuMilliseconds();
+
+size_t
+PeakMemoryBytes();
+
+struct StageTiming
+{
+	bool ran{ false };
+	double wallMilliseconds{ 0 };
+	double cpuMilliseconds{ 0 }; //summed over threads, so cpu / wall is roughly how many cores were busy
+	size_t vertices{ 0 };
+	size_t peakBytes{ 0 };       //process peak at the end of the stage
+};
+
+class BuildProfiler
+{
+public:
+
+	void
+	Begin(BuildStage stage);
+
+	void
+	End(BuildStage stage, size_t vertices);
+
+	const StageTiming&
+	Timing(BuildStage stage) const;
+
+	/*
+	One line per stage that ran: wall, CPU, vertices per second and peak memory
+	*/
+	void
+	Report(std::ostream& out) const;
+
+	/*
+	Times a stage for as long as it's in scope
+	*/
+	class Scope
+	{
+	public:
+		Scope(BuildProfiler& profiler, BuildStage stage, size_t vertices);
+		~Scope();
+
+	private:
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+
+		BuildProfiler& profiler;
+		BuildStage stage;
+		size_t vertices;
+	};
+
+private:
+
+	StageTiming timings[(int)BuildStage::Count];
+	double wallStart[(int)BuildStage::Count];
+	double cpuStart[(int)BuildStage::Count];
+};
+
+/*
+Progress through the current stage. Advance is lock-free and safe from any worker; the callback gets called
+once each time the stage passes another 1/steps of its work, on whichever thread got it there, so it has to
+be fine with being called from a worker (and with two steps arriving close together)
+*/
+class BuildProgress
+{
+public:
+	typedef std::function<void(BuildStage stage, float fraction)> Callback;
+
+	explicit BuildProgress(Callback callback = Callback(), int steps = 100);
+
+	void
+	BeginStage(BuildStage stage, size_t totalWork);
+
+	void
+	Advance(size_t work);
+
+	float
+	Fraction() const;
+
+	BuildStage
+	Stage() const;
+
+private:
+
+	Callback callback;
+	int steps;
+	std::atomic<int> stage;
+	std::atomic<size_t> done;
+	std::atomic<size_t> total;
+	std::atomic<int> lastStep;
+};
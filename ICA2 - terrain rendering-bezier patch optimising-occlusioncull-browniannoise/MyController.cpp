@@ -4,7 +4,7 @@
 #include <iostream>
 
 MyController::
-MyController()
+MyController(bool terrain_paging)
 {
     camera_move_speed_[0] = 0;
     camera_move_speed_[1] = 0;
@@ -15,6 +15,7 @@ MyController()
     scene_ = std::make_shared<SceneModel::Context>();
     view_ = std::make_shared<MyView>();
     view_->setScene(scene_);
+    view_->setTerrainPaging(terrain_paging);
 }
 
 MyController::
@@ -31,6 +32,11 @@ windowControlWillStart(std::shared_ptr<tygra::Window> window)
     std::cout << "  F2: Toggle shading mode" << std::endl;
 	std::cout << "  F3: Reduce camera movement speed" << std::endl;
 	std::cout << "  F4: Increase camera movement speed" << std::endl;
+	std::cout << "  F5: Raise the terrain under the camera" << std::endl;
+	std::cout << "  F6: Lower the terrain under the camera" << std::endl;
+	std::cout << "  F7: Toggle the tessellated terrain" << std::endl;
+	std::cout << "  F8: Toggle between the LOD terrain and the full detail grid" << std::endl;
+	std::cout << "  F9: Cycle the full detail grid's index buffer" << std::endl;
 }
 
 void MyController::
@@ -125,6 +131,21 @@ windowControlKeyboardChanged(std::shared_ptr<tygra::Window> window,
 		camera_speed_ = camera_speed_ + 20.f;
 		if (camera_speed_ > 500.f) camera_speed_ = 500.f;
 		break;
+	case tygra::kWindowKeyF5:
+		view_->stampTerrainBrush(10.f);
+		break;
+	case tygra::kWindowKeyF6:
+		view_->stampTerrainBrush(-10.f);
+		break;
+	case tygra::kWindowKeyF7:
+		view_->toggleTessellation();
+		break;
+	case tygra::kWindowKeyF8:
+		view_->toggleLod();
+		break;
+	case tygra::kWindowKeyF9:
+		view_->cycleIndexMode();
+		break;
 	}
 }
 
@@ -9,7 +9,7 @@ class MyController : public tygra::WindowControlDelegate
 {
 public:
 	
-    MyController();
+    MyController(bool terrain_paging = false);
 
     ~MyController();
 
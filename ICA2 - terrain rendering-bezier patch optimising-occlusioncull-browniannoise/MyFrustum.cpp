@@ -78,3 +78,23 @@ bool MyFrustum::IsPointOnScreen(glm::vec3 pos)
 	}
 	return true;
 }
+
+/*
+Only the box corner furthest along each plane's normal needs checking: if even that one is behind the plane
+the whole box is. Boxes that straddle a corner of the frustum can still pass, which just means drawing a bit extra
+*/
+bool MyFrustum::IsBoxOnScreen(glm::vec3 minCorner, glm::vec3 maxCorner)
+{
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		glm::vec3 positive(frustumPlanes[i].a >= 0 ? maxCorner.x : minCorner.x,
+			frustumPlanes[i].b >= 0 ? maxCorner.y : minCorner.y,
+			frustumPlanes[i].c >= 0 ? maxCorner.z : minCorner.z);
+
+		if (frustumPlanes[i].getDistance(positive) < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 /*
 I used my own plane struct to keep simplicity and a low cost to memory
@@ -26,6 +26,8 @@ public:
 
 	bool IsPointOnScreen(glm::vec3 pos);
 
+	bool IsBoxOnScreen(glm::vec3 minCorner, glm::vec3 maxCorner);
+
 private:
 
 	FrustumPlane frustumPlanes[6];
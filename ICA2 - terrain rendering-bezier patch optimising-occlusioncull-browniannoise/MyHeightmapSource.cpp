@@ -0,0 +1,281 @@
+#include "MyHeightmapSource.hpp"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+size_t
+BytesPerHeight(RawHeightFormat format)
+{
+	switch (format)
+	{
+	case RawHeightFormat::R16: return 2;
+	case RawHeightFormat::R32F: return 4;
+	default: return 1;
+	}
+}
+
+/*
+16-bit heights are scaled down into 0-255 so they line up with the 8-bit maps, keeping the extra bits as fraction
+*/
+float
+DecodeHeight(const char* texel, RawHeightFormat format)
+{
+	switch (format)
+	{
+	case RawHeightFormat::R16:
+	{
+		uint16_t value;
+		std::memcpy(&value, texel, sizeof(value));
+		return value * (255.0f / 65535.0f);
+	}
+	case RawHeightFormat::R32F:
+	{
+		float value;
+		std::memcpy(&value, texel, sizeof(value));
+		return value;
+	}
+	default:
+		return (float)*(const uint8_t*)texel;
+	}
+}
+
+/*
+Same mapping as MappedTerrainCache. The file has to hold at least width x height heights
+*/
+MappedRawHeightmapSource::MappedRawHeightmapSource(const std::string& path, size_t width, size_t height, RawHeightFormat format)
+	: width(width), height(height), format(format)
+{
+	const size_t expectedSize = width * height * BytesPerHeight(format);
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Could not open raw heightmap " << path << std::endl;
+		return;
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (size_t)size.QuadPart < expectedSize || expectedSize == 0)
+	{
+		std::cerr << "Raw heightmap " << path << " is smaller than " << width << "x" << height << std::endl;
+		Close();
+		return;
+	}
+	mappingSize = (size_t)size.QuadPart;
+
+	mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle != NULL)
+		mapping = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		std::cerr << "Could not open raw heightmap " << path << std::endl;
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fileDescriptor, &info) != 0 || (size_t)info.st_size < expectedSize || expectedSize == 0)
+	{
+		std::cerr << "Raw heightmap " << path << " is smaller than " << width << "x" << height << std::endl;
+		Close();
+		return;
+	}
+	mappingSize = (size_t)info.st_size;
+
+	void* view = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	mapping = view == MAP_FAILED ? nullptr : (const char*)view;
+#endif
+
+	if (mapping == nullptr)
+	{
+		std::cerr << "Could not map raw heightmap " << path << std::endl;
+		Close();
+	}
+}
+
+MappedRawHeightmapSource::~MappedRawHeightmapSource()
+{
+	Close();
+}
+
+void MappedRawHeightmapSource::
+Close()
+{
+#ifdef _WIN32
+	if (mapping != nullptr)
+		UnmapViewOfFile(mapping);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (mapping != nullptr)
+		munmap((void*)mapping, mappingSize);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+}
+
+bool MappedRawHeightmapSource::
+IsOpen() const
+{
+	return mapping != nullptr;
+}
+
+size_t MappedRawHeightmapSource::
+Width() const
+{
+	return width;
+}
+
+size_t MappedRawHeightmapSource::
+Height() const
+{
+	return height;
+}
+
+bool MappedRawHeightmapSource::
+ReadRows(size_t firstRow, size_t rowCount, float* out)
+{
+	if (mapping == nullptr || firstRow + rowCount > height)
+		return false;
+
+	const size_t texelSize = BytesPerHeight(format);
+	const char* texel = mapping + firstRow * width * texelSize;
+	const size_t count = rowCount * width;
+
+	for (size_t i = 0; i < count; ++i, texel += texelSize)
+	{
+		out[i] = DecodeHeight(texel, format);
+	}
+	return true;
+}
+
+#ifndef TERRAIN_HEADLESS
+ImageHeightmapSource::ImageHeightmapSource(tygra::Image image)
+	: image(std::move(image))
+{
+}
+
+bool ImageHeightmapSource::
+IsOpen() const
+{
+	return image.doesContainData() && (image.bytesPerComponent() == 1 || image.bytesPerComponent() == 2);
+}
+
+size_t ImageHeightmapSource::
+Width() const
+{
+	return image.width();
+}
+
+size_t ImageHeightmapSource::
+Height() const
+{
+	return image.height();
+}
+
+/*
+PNG stores 16-bit samples big-endian and the decoder hands them over as they are in the file
+*/
+bool ImageHeightmapSource::
+ReadRows(size_t firstRow, size_t rowCount, float* out)
+{
+	if (!IsOpen() || firstRow + rowCount > Height())
+		return false;
+
+	const size_t width = Width();
+	const size_t pixelSize = image.componentsPerPixel() * image.bytesPerComponent();
+	const uint8_t* pixels = (const uint8_t*)image.pixelData();
+
+	for (size_t row = 0; row < rowCount; ++row)
+	{
+		const uint8_t* pixel = pixels + (firstRow + row) * width * pixelSize;
+		float* heights = out + row * width;
+
+		if (image.bytesPerComponent() == 2)
+		{
+			for (size_t x = 0; x < width; ++x, pixel += pixelSize)
+			{
+				heights[x] = (uint16_t)(pixel[0] << 8 | pixel[1]) * (255.0f / 65535.0f);
+			}
+		}
+		else
+		{
+			for (size_t x = 0; x < width; ++x, pixel += pixelSize)
+			{
+				heights[x] = (float)pixel[0];
+			}
+		}
+	}
+	return true;
+}
+#endif
+
+static bool
+EndsWith(const std::string& text, const std::string& ending)
+{
+	return text.size() >= ending.size() && text.compare(text.size() - ending.size(), ending.size(), ending) == 0;
+}
+
+std::unique_ptr<HeightmapSource>
+OpenHeightmapSource(const std::string& path)
+{
+	const bool raw16 = EndsWith(path, ".r16");
+	if (raw16 || EndsWith(path, ".r32"))
+	{
+		const RawHeightFormat format = raw16 ? RawHeightFormat::R16 : RawHeightFormat::R32F;
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		size_t heights = file ? (size_t)file.tellg() / BytesPerHeight(format) : 0;
+		size_t side = (size_t)std::sqrt((double)heights);
+		while (side * side < heights)
+			side++;
+		while (side * side > heights)
+			side--;
+
+		if (side < 2 || side * side != heights)
+		{
+			std::cerr << "Raw heightmap " << path << " isn't square, open it with its size instead" << std::endl;
+			return nullptr;
+		}
+
+		std::unique_ptr<MappedRawHeightmapSource> source(new MappedRawHeightmapSource(path, side, side, format));
+		if (!source->IsOpen())
+			return nullptr;
+		return std::unique_ptr<HeightmapSource>(std::move(source));
+	}
+
+#ifdef TERRAIN_HEADLESS
+	std::cerr << "Could not load heightmap " << path << ", the headless build only reads .r16 and .r32" << std::endl;
+	return nullptr;
+#else
+	std::unique_ptr<ImageHeightmapSource> source(new ImageHeightmapSource(tygra::imageFromPNG(path)));
+	if (!source->IsOpen())
+	{
+		std::cerr << "Could not load heightmap " << path << std::endl;
+		return nullptr;
+	}
+	return std::unique_ptr<HeightmapSource>(std::move(source));
+#endif
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#ifndef TERRAIN_HEADLESS
+#include <tygra/Image.hpp>
+#endif
+
+/*
+Anything the terrain can pull heights out of, a band of rows at a time. Heights come out as floats in the
+same 0-255 range the 8-bit PNG path has always used, so wider formats just add precision
+*/
+class HeightmapSource
+{
+public:
+	virtual ~HeightmapSource() {}
+
+	virtual size_t
+	Width() const = 0;
+
+	virtual size_t
+	Height() const = 0;
+
+	virtual bool
+	ReadRows(size_t firstRow, size_t rowCount, float* out) = 0;
+};
+
+enum class RawHeightFormat { R8, R16, R32F };
+
+/*
+Headerless raw heightmap mapped straight into memory. Nothing is read up front: ReadRows decodes from the
+mapping into the caller's buffer, so the only copy is the one into the grid and the OS pages the file in as
+the rows get touched. Fine for heightmaps of hundreds of MB
+*/
+class MappedRawHeightmapSource : public HeightmapSource
+{
+public:
+	MappedRawHeightmapSource(const std::string& path, size_t width, size_t height, RawHeightFormat format);
+	~MappedRawHeightmapSource();
+
+	bool
+	IsOpen() const;
+
+	size_t
+	Width() const override;
+
+	size_t
+	Height() const override;
+
+	bool
+	ReadRows(size_t firstRow, size_t rowCount, float* out) override;
+
+private:
+
+	MappedRawHeightmapSource(const MappedRawHeightmapSource&);
+	MappedRawHeightmapSource& operator=(const MappedRawHeightmapSource&);
+
+	void
+	Close();
+
+	size_t width, height;
+	RawHeightFormat format;
+
+	const char* mapping{ nullptr };
+	size_t mappingSize{ 0 };
+#ifdef _WIN32
+	void* fileHandle{ nullptr };
+	void* mappingHandle{ nullptr };
+#else
+	int fileDescriptor{ -1 };
+#endif
+};
+
+#ifndef TERRAIN_HEADLESS
+/*
+A decoded image, read in place. The image is moved in, never copied, and the height is the first channel of
+each pixel at its real width: 8-bit as it is, 16-bit scaled into 0-255 with the extra bits kept as fraction.
+Any width and height, square or not. Not in the headless build (TERRAIN_HEADLESS), which has no tygra to decode with
+*/
+class ImageHeightmapSource : public HeightmapSource
+{
+public:
+	explicit ImageHeightmapSource(tygra::Image image);
+
+	bool
+	IsOpen() const;
+
+	size_t
+	Width() const override;
+
+	size_t
+	Height() const override;
+
+	bool
+	ReadRows(size_t firstRow, size_t rowCount, float* out) override;
+
+private:
+
+	tygra::Image image;
+};
+#endif
+
+/*
+Picks a source from the file extension. .r16 and .r32 are raw 16-bit and float maps, mapped, and taken to be
+square since a raw file doesn't carry its size (use MappedRawHeightmapSource directly for anything else).
+Everything else goes through the PNG decoder, or fails in the headless build. Returns null if the file can't be used
+*/
+std::unique_ptr<HeightmapSource>
+OpenHeightmapSource(const std::string& path);
+
+size_t
+BytesPerHeight(RawHeightFormat format);
+
+float
+DecodeHeight(const char* texel, RawHeightFormat format);
@@ -0,0 +1,410 @@
+#include "MyLazyTerrain.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+LazyTerrain::LazyTerrain(const TerrainGL& base, const LazyTerrainSettings& settings)
+	: settings(settings)
+{
+	vertsX = settings.targetSizeX + 1;
+	vertsZ = settings.targetSizeZ + 1;
+	tileSize = std::max<size_t>(settings.tileSize, 1);
+	tilesX = (vertsX + tileSize - 1) / tileSize;
+	tilesZ = (vertsZ + tileSize - 1) / tileSize;
+
+	//same tables SeparableInterpolation builds, so the same offsets and weights per vertex
+	columns = utilAyre::BuildBernsteinTable(base.width, vertsX);
+	rows = utilAyre::BuildBernsteinTable(base.height, vertsZ);
+	slopeScale = vertsX > 1 && vertsZ > 1 ? TerrainGL::PatchSlopeScale(base.width, base.height, Position(0, 0), Position(vertsX - 1, vertsZ - 1), vertsX, vertsZ, 3) : glm::vec2(0);
+
+	ReloadControlPoints(base);
+}
+
+void LazyTerrain::
+ReloadControlPoints(const TerrainGL& base)
+{
+	sourceWidth = base.verts_x;
+	sourceRows = (size_t)base.verts_z;
+
+	control.resize(base.terrain_data.size());
+	for (size_t i = 0; i < control.size(); ++i)
+	{
+		control[i] = base.terrain_data[i].p.y;
+	}
+	ClearCache();
+}
+
+/*
+Cache hit moves the tile to the front of the usage list, a miss evaluates it and evicts from the back until
+the cache fits its budget again
+*/
+std::shared_ptr<const LazyTerrainTile> LazyTerrain::
+Tile(size_t tileX, size_t tileZ)
+{
+	const size_t key = tileZ * tilesX + tileX;
+
+	auto found = cache.find(key);
+	if (found != cache.end())
+	{
+		stats.hits++;
+		usage.splice(usage.begin(), usage, found->second.usage);
+		return found->second.tile;
+	}
+
+	stats.misses++;
+	std::shared_ptr<const LazyTerrainTile> tile = EvaluateTile(tileX, tileZ);
+
+	usage.push_front(key);
+	cache[key] = CacheEntry{ tile, usage.begin() };
+	cachedBytes += tile->Bytes();
+	EvictToBudget();
+	return tile;
+}
+
+float LazyTerrain::
+Height(size_t x, size_t z)
+{
+	std::shared_ptr<const LazyTerrainTile> tile = Tile(x / tileSize, z / tileSize);
+	return tile->heights[(z - tile->firstZ) * tile->vertsX + x - tile->firstX];
+}
+
+glm::vec3 LazyTerrain::
+Normal(size_t x, size_t z)
+{
+	std::shared_ptr<const LazyTerrainTile> tile = Tile(x / tileSize, z / tileSize);
+	return tile->normals[(z - tile->firstZ) * tile->vertsX + x - tile->firstX];
+}
+
+Vertex LazyTerrain::
+VertexAt(size_t x, size_t z)
+{
+	std::shared_ptr<const LazyTerrainTile> tile = Tile(x / tileSize, z / tileSize);
+	size_t i = (z - tile->firstZ) * tile->vertsX + x - tile->firstX;
+
+	Vertex vertex = Vertex();
+	vertex.p = Position(x, z);
+	vertex.p.y = tile->heights[i];
+	vertex.n = tile->normals[i];
+	vertex.globalUV = glm::vec2((float)x / vertsX, (float)z / (float)vertsZ);
+	return vertex;
+}
+
+/*
+Walks the region a tile at a time rather than a vertex at a time, so each tile is looked up once
+*/
+void LazyTerrain::
+CopyRegion(const TerrainRegion& region, Vertex* out)
+{
+	if (region.Empty())
+		return;
+
+	const size_t width = region.endX - region.firstX;
+
+	for (size_t tz = region.firstZ / tileSize; tz * tileSize < region.endZ; ++tz)
+	{
+		for (size_t tx = region.firstX / tileSize; tx * tileSize < region.endX; ++tx)
+		{
+			std::shared_ptr<const LazyTerrainTile> tile = Tile(tx, tz);
+
+			size_t firstX = std::max(region.firstX, tile->firstX);
+			size_t endX = std::min(region.endX, tile->firstX + tile->vertsX);
+			size_t firstZ = std::max(region.firstZ, tile->firstZ);
+			size_t endZ = std::min(region.endZ, tile->firstZ + tile->vertsZ);
+
+			for (size_t z = firstZ; z < endZ; ++z)
+			{
+				for (size_t x = firstX; x < endX; ++x)
+				{
+					size_t i = (z - tile->firstZ) * tile->vertsX + x - tile->firstX;
+
+					Vertex& vertex = out[(z - region.firstZ) * width + x - region.firstX];
+					vertex = Vertex();
+					vertex.p = Position(x, z);
+					vertex.p.y = tile->heights[i];
+					vertex.n = tile->normals[i];
+					vertex.globalUV = glm::vec2((float)x / vertsX, (float)z / (float)vertsZ);
+				}
+			}
+		}
+	}
+}
+
+void LazyTerrain::
+EvaluateRegion(const TerrainRegion& region, Vertex* out) const
+{
+	if (region.Empty())
+		return;
+
+	std::shared_ptr<LazyTerrainTile> block = EvaluateBlock(region.firstX, region.firstZ, region.endX - region.firstX, region.endZ - region.firstZ);
+
+	for (size_t z = region.firstZ; z < region.endZ; ++z)
+	{
+		for (size_t x = region.firstX; x < region.endX; ++x)
+		{
+			size_t i = (z - region.firstZ) * block->vertsX + x - region.firstX;
+
+			Vertex& vertex = out[i];
+			vertex = Vertex();
+			vertex.p = Position(x, z);
+			vertex.p.y = block->heights[i];
+			vertex.n = block->normals[i];
+			vertex.globalUV = glm::vec2((float)x / vertsX, (float)z / (float)vertsZ);
+		}
+	}
+}
+
+void LazyTerrain::
+SetCacheBytes(size_t bytes)
+{
+	settings.cacheBytes = bytes;
+	EvictToBudget();
+}
+
+void LazyTerrain::
+ClearCache()
+{
+	stats.evictions += cache.size();
+	cache.clear();
+	usage.clear();
+	cachedBytes = 0;
+}
+
+LazyTerrainStats LazyTerrain::
+Stats() const
+{
+	LazyTerrainStats result = stats;
+	result.residentTiles = cache.size();
+	result.residentBytes = cachedBytes + control.capacity() * sizeof(float) +
+		(columns.offsets.capacity() + rows.offsets.capacity()) * sizeof(int) +
+		(columns.weights.capacity() + rows.weights.capacity() + columns.slopes.capacity() + rows.slopes.capacity()) * sizeof(std::array<float, 4>);
+	return result;
+}
+
+/*
+Always keeps the tile just evaluated, even if it alone is over the budget, or Tile would hand out
+something the cache had already forgotten on every call
+*/
+void LazyTerrain::
+EvictToBudget()
+{
+	while (cachedBytes > settings.cacheBytes && cache.size() > 1)
+	{
+		auto oldest = cache.find(usage.back());
+		cachedBytes -= oldest->second.tile->Bytes();
+		cache.erase(oldest);
+		usage.pop_back();
+		stats.evictions++;
+	}
+}
+
+glm::vec3 LazyTerrain::
+Position(size_t x, size_t z) const
+{
+	return TerrainGL::GridPosition(x, z, vertsX, (float)vertsZ, settings.worldSizeX, settings.worldSizeZ);
+}
+
+/*
+Heights for the tile plus a one-vertex apron go through the horizontal then the vertical Bernstein pass, noise
+gets added a row at a time through the grid kernel, and then the normals take their central differences
+across the apron, one-sided where the apron runs off the edge of the world.
+Analytic normals only need the tile's own vertices: the slopes ride along with the heights through both passes
+and the noise, and the normals are finished a row at a time with them
+*/
+std::shared_ptr<const LazyTerrainTile> LazyTerrain::
+EvaluateTile(size_t tileX, size_t tileZ) const
+{
+	return EvaluateBlock(tileX * tileSize, tileZ * tileSize, std::min(tileSize, vertsX - tileX * tileSize), std::min(tileSize, vertsZ - tileZ * tileSize));
+}
+
+std::shared_ptr<LazyTerrainTile> LazyTerrain::
+EvaluateBlock(size_t firstX, size_t firstZ, size_t blockVertsX, size_t blockVertsZ) const
+{
+	std::shared_ptr<LazyTerrainTile> tile = std::make_shared<LazyTerrainTile>();
+	tile->firstX = firstX;
+	tile->firstZ = firstZ;
+	tile->vertsX = blockVertsX;
+	tile->vertsZ = blockVertsZ;
+
+	const bool analytic = settings.analyticNormals && vertsX > 1 && vertsZ > 1;
+	const size_t apron = analytic ? 0 : 1;
+
+	const size_t apronFirstX = tile->firstX >= apron ? tile->firstX - apron : 0;
+	const size_t apronFirstZ = tile->firstZ >= apron ? tile->firstZ - apron : 0;
+	const size_t apronVertsX = std::min(tile->firstX + tile->vertsX - 1 + apron, vertsX - 1) - apronFirstX + 1;
+	const size_t apronVertsZ = std::min(tile->firstZ + tile->vertsZ - 1 + apron, vertsZ - 1) - apronFirstZ + 1;
+
+	//offsets never go down along an axis, so the apron's first and last row bound every source row it reads
+	const size_t firstRow = rows.offsets[apronFirstZ];
+	const size_t rowCount = rows.offsets[apronFirstZ + apronVertsZ - 1] + 4 - firstRow;
+
+	std::vector<float> horizontal(rowCount * apronVertsX);
+	std::vector<float> horizontalSlope(analytic ? horizontal.size() : 0);
+	float taps[4];
+	for (size_t r = 0; r < rowCount; ++r)
+	{
+		const float* sourceRow = &control[(firstRow + r) * sourceWidth];
+		for (size_t i = 0; i < apronVertsX; ++i)
+		{
+			const size_t x = apronFirstX + i;
+			const float* first = sourceRow + columns.offsets[x];
+			taps[0] = first[0];
+			taps[1] = first[1];
+			taps[2] = first[2];
+			taps[3] = first[3];
+			horizontal[r * apronVertsX + i] = utilAyre::BernsteinFilter(taps, 1, columns.weights[x]);
+
+			if (analytic)
+				horizontalSlope[r * apronVertsX + i] = utilAyre::BernsteinFilter(taps, 1, columns.slopes[x]);
+		}
+	}
+
+	if (analytic)
+	{
+		tile->normals.resize(tile->vertsX * tile->vertsZ);
+	}
+
+	std::vector<float> noiseColumns(apronVertsX), noiseRow(apronVertsX);
+	std::vector<float> noiseSlopeX(analytic ? apronVertsX : 0), noiseSlopeZ(analytic ? apronVertsX : 0);
+	for (size_t i = 0; i < apronVertsX; ++i)
+	{
+		noiseColumns[i] = Position(apronFirstX + i, 0).x;
+	}
+
+	std::vector<float> heights(apronVertsZ * apronVertsX);
+	for (size_t j = 0; j < apronVertsZ; ++j)
+	{
+		const size_t z = apronFirstZ + j;
+		const float* rowTaps = &horizontal[(rows.offsets[z] - firstRow) * apronVertsX];
+
+		if (settings.applyNoise)
+		{
+			float worldZ = Position(0, z).z;
+			if (analytic)
+				utilAyre::GradientFbmGrid(noiseColumns.data(), apronVertsX, &worldZ, 1, noiseRow.data(), noiseSlopeX.data(), noiseSlopeZ.data(), settings.noise);
+			else
+				utilAyre::GradientFbmGrid(noiseColumns.data(), apronVertsX, &worldZ, 1, noiseRow.data(), settings.noise);
+		}
+
+		for (size_t i = 0; i < apronVertsX; ++i)
+		{
+			float height = utilAyre::BernsteinFilter(rowTaps + i, apronVertsX, rows.weights[z]);
+
+			if (settings.applyNoise)
+				height += noiseRow[i];
+
+			heights[j * apronVertsX + i] = height;
+		}
+
+		if (analytic)
+		{
+			const float* slopeTaps = &horizontalSlope[(rows.offsets[z] - firstRow) * apronVertsX];
+			for (size_t i = 0; i < apronVertsX; ++i)
+			{
+				float du = utilAyre::BernsteinFilter(slopeTaps + i, apronVertsX, rows.weights[z]);
+				float dv = utilAyre::BernsteinFilter(rowTaps + i, apronVertsX, rows.slopes[z]);
+				glm::vec3 normal = TerrainGL::SlopeNormal(du * slopeScale.x, dv * slopeScale.y);
+
+				if (settings.applyNoise)
+					normal = TerrainGL::TiltNormal(normal, noiseSlopeX[i], noiseSlopeZ[i]);
+
+				tile->normals[j * apronVertsX + i] = normal;
+			}
+		}
+	}
+
+	if (analytic)
+	{
+		tile->heights.swap(heights); //no apron, so the heights are the tile's already
+		return tile;
+	}
+
+	auto position = [&](size_t x, size_t z)
+	{
+		glm::vec3 p = Position(x, z);
+		p.y = heights[(z - apronFirstZ) * apronVertsX + x - apronFirstX];
+		return p;
+	};
+
+	tile->heights.resize(tile->vertsX * tile->vertsZ);
+	tile->normals.resize(tile->vertsX * tile->vertsZ);
+	for (size_t j = 0; j < tile->vertsZ; ++j)
+	{
+		const size_t z = tile->firstZ + j;
+		const size_t up = z > 0 ? z - 1 : z;
+		const size_t down = z + 1 < vertsZ ? z + 1 : z;
+
+		for (size_t i = 0; i < tile->vertsX; ++i)
+		{
+			const size_t x = tile->firstX + i;
+			const size_t left = x > 0 ? x - 1 : x;
+			const size_t right = x + 1 < vertsX ? x + 1 : x;
+
+			tile->heights[j * tile->vertsX + i] = heights[(z - apronFirstZ) * apronVertsX + x - apronFirstX];
+			tile->normals[j * tile->vertsX + i] = TerrainGL::GridNormal(position(left, z), position(right, z), position(x, up), position(x, down));
+		}
+	}
+	return tile;
+}
+
+bool
+ReportLazyTerrain(LazyTerrain& lazy, const TerrainGL& reference, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	if (reference.verts_x != lazy.VertsX() || (size_t)reference.verts_z != lazy.VertsZ())
+	{
+		out << "Lazy terrain report: reference grid is a different size" << std::endl;
+		return false;
+	}
+
+	lazy.ClearCache();
+
+	//a row of tiles at a time so the whole check only ever needs one row of them cached
+	size_t mismatches = 0;
+	std::vector<Vertex> row(lazy.VertsX());
+	auto coldStart = Clock::now();
+	for (size_t z = 0; z < lazy.VertsZ(); ++z)
+	{
+		TerrainRegion region;
+		region.firstX = 0;
+		region.endX = lazy.VertsX();
+		region.firstZ = z;
+		region.endZ = z + 1;
+		lazy.CopyRegion(region, row.data());
+
+		for (size_t x = 0; x < row.size(); ++x)
+		{
+			const Vertex& expected = reference.terrain_data[z * reference.verts_x + x];
+			if (row[x].p != expected.p || row[x].n != expected.n)
+				mismatches++;
+		}
+	}
+	double fullMs = std::chrono::duration<double, std::milli>(Clock::now() - coldStart).count();
+
+	LazyTerrainStats stats = lazy.Stats();
+	size_t tiles = lazy.TilesX() * lazy.TilesZ();
+
+	//lookups spread over one cached tile
+	const size_t kLookups = 100000;
+	volatile float sink = 0;
+	lazy.Height(0, 0);
+	auto warmStart = Clock::now();
+	for (size_t i = 0; i < kLookups; ++i)
+	{
+		sink = sink + lazy.Height(i % lazy.TileSize() % lazy.VertsX(), (i / lazy.TileSize()) % lazy.TileSize() % lazy.VertsZ());
+	}
+	double warmNs = std::chrono::duration<double, std::nano>(Clock::now() - warmStart).count() / kLookups;
+
+	size_t referenceBytes = reference.terrain_data.capacity() * sizeof(Vertex);
+
+	out << "Lazy terrain " << lazy.VertsX() << "x" << lazy.VertsZ() << ", " << lazy.TileSize() << " vertex tiles" << std::endl;
+	if (mismatches == 0)
+		out << "  bit-identical to the full build" << std::endl;
+	else
+		out << "  " << mismatches << " vertices differ from the full build" << std::endl;
+	out << "  every tile evaluated once: " << fullMs << " ms, " << fullMs / std::max<size_t>(tiles, 1) << " ms per tile" << std::endl;
+	out << "  cached height lookup: " << warmNs << " ns" << std::endl;
+	out << "  resident: " << stats.residentBytes / 1024 << " KB in " << stats.residentTiles << " tiles vs "
+		<< referenceBytes / 1024 << " KB of vertices, " << (double)referenceBytes / std::max<size_t>(stats.residentBytes, 1) << "x smaller" << std::endl;
+	return mismatches == 0;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+
+/*
+Settings for a terrain that is never built in full. Sizes are in segments like TerrainGL's meshSize
+*/
+struct LazyTerrainSettings
+{
+	size_t targetSizeX{ 1023 };
+	size_t targetSizeZ{ 1023 };
+	int worldSizeX{ 8192 };
+	int worldSizeZ{ 8192 };
+	size_t tileSize{ 64 };                 //vertices along each side of a cached tile
+	size_t cacheBytes{ 2 * 1024 * 1024 };  //evaluated tiles kept around, least recently used go first
+	bool applyNoise{ true };
+	bool analyticNormals{ true };          //normals from the patch and noise derivatives, as TerrainGL::analyticNormals
+	utilAyre::NoiseSettings noise;
+};
+
+/*
+One evaluated square of the grid. Only the heights and normals are kept, positions and UVs fall straight
+out of the grid coordinates so there's no point paying for them in every cached vertex
+*/
+struct LazyTerrainTile
+{
+	size_t firstX, firstZ;
+	size_t vertsX, vertsZ;
+	std::vector<float> heights;
+	std::vector<glm::vec3> normals;
+
+	size_t
+	Bytes() const { return heights.capacity() * sizeof(float) + normals.capacity() * sizeof(glm::vec3) + sizeof(*this); }
+};
+
+struct LazyTerrainStats
+{
+	size_t hits{ 0 };
+	size_t misses{ 0 };
+	size_t evictions{ 0 };
+	size_t residentTiles{ 0 };
+	size_t residentBytes{ 0 }; //control points plus the cached tiles
+};
+
+/*
+Terrain held as nothing but the heightmap control points, with the hi-res heights and normals worked out a
+tile at a time when something asks for them.
+
+A tile goes through the same steps as the full build (SeparableInterpolation, ApplyNoise, CalculateGridNormals):
+the same Bernstein taps in the same order, the same noise per grid position and the same central differences,
+with a one-vertex apron of heights around the tile so the normals on its edges see their real neighbours (or,
+with analyticNormals, the patch and noise slopes that SeparableInterpolation and ApplyNoise use then). So
+every height and normal comes out bit-identical to the materialized TerrainGL, just without 40 bytes per vertex
+sitting in memory for the whole world.
+
+Not thread safe, the cache is shared state. Tiles handed out stay valid after they're evicted, they just
+stop being cached
+*/
+class LazyTerrain
+{
+public:
+	LazyTerrain(const TerrainGL& base, const LazyTerrainSettings& settings);
+
+	/*
+	Takes new control heights (after an edit of the base) and drops every cached tile
+	*/
+	void
+	ReloadControlPoints(const TerrainGL& base);
+
+	std::shared_ptr<const LazyTerrainTile>
+	Tile(size_t tileX, size_t tileZ);
+
+	float
+	Height(size_t x, size_t z);
+
+	glm::vec3
+	Normal(size_t x, size_t z);
+
+	/*
+	The vertex the full build would have at (x, z), UVs and all
+	*/
+	Vertex
+	VertexAt(size_t x, size_t z);
+
+	/*
+	Fills out with the region's vertices, row major, for uploading part of the grid
+	*/
+	void
+	CopyRegion(const TerrainRegion& region, Vertex* out);
+
+	/*
+	CopyRegion straight from the control points, without going near the cache. Nothing shared gets written, so
+	any number of threads can call it at once (the terrain pager's workers do)
+	*/
+	void
+	EvaluateRegion(const TerrainRegion& region, Vertex* out) const;
+
+	void
+	SetCacheBytes(size_t bytes);
+
+	void
+	ClearCache();
+
+	LazyTerrainStats
+	Stats() const;
+
+	size_t
+	VertsX() const { return vertsX; }
+
+	size_t
+	VertsZ() const { return vertsZ; }
+
+	size_t
+	TilesX() const { return tilesX; }
+
+	size_t
+	TilesZ() const { return tilesZ; }
+
+	size_t
+	TileSize() const { return tileSize; }
+
+private:
+
+	typedef std::list<size_t> UsageList; //tile keys, most recently used at the front
+
+	struct CacheEntry
+	{
+		std::shared_ptr<const LazyTerrainTile> tile;
+		UsageList::iterator usage;
+	};
+
+	std::shared_ptr<const LazyTerrainTile>
+	EvaluateTile(size_t tileX, size_t tileZ) const;
+
+	std::shared_ptr<LazyTerrainTile>
+	EvaluateBlock(size_t firstX, size_t firstZ, size_t blockVertsX, size_t blockVertsZ) const;
+
+	glm::vec3
+	Position(size_t x, size_t z) const;
+
+	void
+	EvictToBudget();
+
+	LazyTerrainSettings settings;
+	size_t sourceWidth, sourceRows;
+	size_t vertsX, vertsZ;
+	size_t tileSize, tilesX, tilesZ;
+	std::vector<float> control; //source heights, row major
+	utilAyre::BernsteinTable columns, rows;
+	glm::vec2 slopeScale;
+
+	UsageList usage;
+	std::unordered_map<size_t, CacheEntry> cache;
+	size_t cachedBytes{ 0 };
+	LazyTerrainStats stats;
+};
+
+/*
+Checks every vertex of the lazy terrain against a fully built one, then prints the resident memory of both
+and the cost of a cold tile and a cached lookup. True if every vertex matched bit for bit
+*/
+bool
+ReportLazyTerrain(LazyTerrain& lazy, const TerrainGL& reference, std::ostream& out);
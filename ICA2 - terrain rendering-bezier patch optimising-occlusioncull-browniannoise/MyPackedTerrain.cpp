@@ -0,0 +1,130 @@
+#include "MyPackedTerrain.hpp"
+#include <algorithm>
+#include <cmath>
+
+uint16_t
+QuantizeHeight(float height, float scale, float bias)
+{
+	if (scale <= 0)
+		return 0;
+
+	float unorm = std::min(std::max((height - bias) / scale, 0.0f), 1.0f);
+	return (uint16_t)std::lround(unorm * 65535.0f);
+}
+
+float
+DequantizeHeight(uint16_t value, float scale, float bias)
+{
+	return bias + (value / 65535.0f) * scale;
+}
+
+static float
+SignNotZero(float value)
+{
+	return value >= 0 ? 1.0f : -1.0f;
+}
+
+static int16_t
+ToSnorm16(float value)
+{
+	return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+/*
+Project onto the octahedron |x|+|y|+|z| = 1, then fold the lower half (z < 0) out over the corners
+so the whole sphere fits in the [-1,1] square
+*/
+void
+EncodeOctahedral(const glm::vec3& normal, int16_t out[2])
+{
+	float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (l1 == 0)
+	{
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float px = normal.x / l1;
+	float py = normal.y / l1;
+
+	if (normal.z < 0)
+	{
+		float fx = (1 - std::fabs(py)) * SignNotZero(px);
+		float fy = (1 - std::fabs(px)) * SignNotZero(py);
+		px = fx;
+		py = fy;
+	}
+
+	out[0] = ToSnorm16(px);
+	out[1] = ToSnorm16(py);
+}
+
+/*
+Must match decodeOctahedral in terrain_packed_vs.glsl
+*/
+glm::vec3
+DecodeOctahedral(const int16_t encoded[2])
+{
+	float px = encoded[0] / 32767.0f;
+	float py = encoded[1] / 32767.0f;
+	glm::vec3 v(px, py, 1 - std::fabs(px) - std::fabs(py));
+
+	if (v.z < 0)
+	{
+		v.x = (1 - std::fabs(py)) * SignNotZero(px);
+		v.y = (1 - std::fabs(px)) * SignNotZero(py);
+	}
+	return glm::normalize(v);
+}
+
+void
+PackVertices(const Vertex* vertices, size_t count, float scale, float bias, PackedVertex* out)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i].height = QuantizeHeight(vertices[i].p.y, scale, bias);
+		out[i].padding = 0;
+		EncodeOctahedral(vertices[i].n, out[i].octahedral);
+	}
+}
+
+/*
+Scale and bias are fitted to the terrain's own height range so the 16 bits cover only heights that exist
+*/
+PackedTerrain
+PackTerrain(const Vertex* vertices, size_t vertexCount, size_t vertsX)
+{
+	PackedTerrain packed;
+	packed.vertsX = vertsX;
+	packed.vertsZ = vertsX > 0 ? vertexCount / vertsX : 0;
+	packed.vertices.resize(vertexCount);
+
+	if (vertexCount == 0)
+		return packed;
+
+	float minHeight = vertices[0].p.y;
+	float maxHeight = vertices[0].p.y;
+	for (size_t i = 1; i < vertexCount; ++i)
+	{
+		minHeight = std::min(minHeight, vertices[i].p.y);
+		maxHeight = std::max(maxHeight, vertices[i].p.y);
+	}
+	packed.heightBias = minHeight;
+	packed.heightScale = maxHeight > minHeight ? maxHeight - minHeight : 1.0f;
+
+	PackVertices(vertices, vertexCount, packed.heightScale, packed.heightBias, packed.vertices.data());
+	return packed;
+}
+
+size_t
+FullVertexBytes(size_t vertexCount)
+{
+	return vertexCount * sizeof(Vertex);
+}
+
+size_t
+PackedVertexBytes(size_t vertexCount)
+{
+	return vertexCount * sizeof(PackedVertex);
+}
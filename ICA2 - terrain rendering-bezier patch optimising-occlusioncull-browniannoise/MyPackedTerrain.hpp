@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+
+/*
+8 byte terrain vertex. The shaders only need a position and a normal, and on a regular grid x/z come for free
+from the vertex index (gl_VertexID), so all that is stored is:
+	height - 16-bit unorm, height = bias + value / 65535 * scale
+	normal - octahedral encoding, two 16-bit snorms
+The second slot is padding to keep the normal 4-byte aligned for the vertex fetch.
+
+Error bounds (packed_round_trip in MyTerrainChecks.cpp holds every vertex of a built terrain to them):
+	height - half a step, scale / 131070, plus float rounding. For the 0-255 heightmap plus noise that's about 0.002 units
+	normal - under 0.004 degrees between the original and the decoded unit vector (worst seen 0.0037)
+*/
+struct PackedVertex
+{
+	uint16_t height;
+	uint16_t padding;
+	int16_t octahedral[2];
+};
+
+struct PackedTerrain
+{
+	std::vector<PackedVertex> vertices;
+	float heightScale{ 1 };
+	float heightBias{ 0 };
+	size_t vertsX{ 0 }, vertsZ{ 0 };
+};
+
+const float kPackedHeightMaxError = 0.5f / 65535.0f; //times heightScale
+const float kPackedNormalMaxErrorDegrees = 0.004f;
+
+uint16_t
+QuantizeHeight(float height, float scale, float bias);
+
+float
+DequantizeHeight(uint16_t value, float scale, float bias);
+
+void
+EncodeOctahedral(const glm::vec3& normal, int16_t out[2]);
+
+glm::vec3
+DecodeOctahedral(const int16_t encoded[2]);
+
+/*
+Packs a run of vertices against an existing scale and bias, for re-uploading part of a packed terrain.
+Heights outside bias to bias + scale get clamped, so an edit that goes past them needs a full PackTerrain
+*/
+void
+PackVertices(const Vertex* vertices, size_t count, float scale, float bias, PackedVertex* out);
+
+PackedTerrain
+PackTerrain(const Vertex* vertices, size_t vertexCount, size_t vertsX);
+
+size_t
+FullVertexBytes(size_t vertexCount);
+
+size_t
+PackedVertexBytes(size_t vertexCount);
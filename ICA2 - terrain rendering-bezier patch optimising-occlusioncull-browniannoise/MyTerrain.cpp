@@ -1,10 +1,38 @@
 #include "MyTerrain.hpp"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <cmath>
+
+/*
+Shared by the scatter and gather normal passes so both produce exactly the same bits for a face
+*/
+static inline glm::vec3
+FaceNormal(const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3)
+{
+	glm::vec3 u = p2 - p1;
+	glm::vec3 v = p3 - p1;
+
+	return glm::cross(u, v);
+}
+
+static inline glm::vec3
+SafeNormalize(const glm::vec3& v)
+{
+	float length = glm::length(v);
+	return length > 0 ? v / length : glm::vec3(0, 1, 0);
+}
 
 TerrainGL::TerrainGL(int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ)
 {
 	MakeMesh(meshSizeX, meshSizeZ, targetSizeX, targetSizeZ);
 }
 
+TerrainGL::TerrainGL()
+	: width(0), height(0), verts_x(0), verts_z(0)
+{
+}
+
 TerrainGL::~TerrainGL()
 {
 }
@@ -29,21 +57,33 @@ MakeMesh(int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ)
 		for (signed int x = 0; x < verts_x; ++x)
 		{
 			// Basic data, we reverse the z to make sure the grid is below cubes
-			glm::vec3 thisVertex = glm::vec3(x * targetSizeX / verts_x, 0, -z * targetSizeZ / verts_z);
+			glm::vec3 thisVertex = GridPosition(x, z, verts_x, verts_z, targetSizeX, targetSizeZ);
 
 			float U = (float)x / verts_x;
 			float V = (float)z / verts_z;
 
 			// Global UV
 			terrain_data[x + z * verts_x].p = thisVertex;
-			terrain_data[x + z * (size_t)verts_z].globalUV = glm::vec2(U, V);
+			terrain_data[x + z * verts_x].globalUV = glm::vec2(U, V);
 		}
 	}
 
+	MakeElements(meshSizeX, meshSizeZ);
+
+	width = meshSizeX;
+	height = meshSizeZ;
+}
+
+void TerrainGL::
+MakeElements(int meshSizeX, int meshSizeZ)
+{
 #pragma region ElementOptimising //Indexing optimisation
+	terrain_elements.clear();
+	terrain_elements.reserve((size_t)meshSizeX * meshSizeZ * 6); //six per quad, so the push_backs never reallocate
+
 	for (int z = 0; z < (int)meshSizeZ; ++z)
 	{
-		int K = z * (int)verts_z;
+		int K = z * (int)verts_x; //rows are verts_x long, which only matters once the mesh isn't square
 
 		for (int x = 0; x < (int)meshSizeX; ++x)
 		{
@@ -74,39 +114,66 @@ MakeMesh(int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ)
 	}
 
 #pragma endregion
-
-	width = meshSizeX;
-	height = meshSizeZ;
 }
 
 
+/*
+World position of grid vertex (x, z). The x goes through integer maths, same as it always has in MakeMesh,
+so anything building vertices outside of MakeMesh lines up with it exactly
+*/
+glm::vec3 TerrainGL::
+GridPosition(size_t x, size_t z, size_t vertsX, float vertsZ, int targetSizeX, int targetSizeZ)
+{
+	return glm::vec3(x * targetSizeX / vertsX, 0, -(int)z * targetSizeZ / vertsZ);
+}
+
 /*
 While the below function assumes a direct equality between the mesh and the miage size,
 using the bezier interpolation function allows higher resolution translation of the initial heightmapped mesh
+
+The heights come out of the source a band of rows at a time straight into the vertices, so nothing the size
+of the whole map is ever held on top of the mesh. Width and height are checked separately, any shape works
 */
-void TerrainGL::
-ApplyHeightMap(tygra::Image heightImage)
+bool TerrainGL::
+ApplyHeightMap(HeightmapSource& source)
 {
-	int index = 0; //quicker than calling maths each loop to calc array position, just have a tracking index
-	for (size_t z = 0; z < (int)heightImage.height(); ++z)
+	const size_t rows = (size_t)verts_z;
+	if (source.Width() != verts_x || source.Height() != rows)
 	{
-		for (size_t x = 0; x < (int)heightImage.height(); ++x)
+		std::cerr << "Heightmap is " << source.Width() << "x" << source.Height() << " but the mesh has "
+			<< verts_x << "x" << rows << " vertices" << std::endl;
+		return false;
+	}
+
+	const size_t kBandRows = 64;
+	std::vector<float> band(std::min(kBandRows, rows) * verts_x);
+
+	for (size_t firstRow = 0; firstRow < rows; firstRow += kBandRows)
+	{
+		size_t bandRows = std::min(kBandRows, rows - firstRow);
+		if (!source.ReadRows(firstRow, bandRows, band.data()))
+		{
+			std::cerr << "Heightmap rows " << firstRow << " to " << firstRow + bandRows << " could not be read" << std::endl;
+			return false;
+		}
+
+		Vertex* vertices = &terrain_data[firstRow * verts_x];
+		for (size_t i = 0; i < bandRows * verts_x; ++i)
 		{
-			uint8_t height = *(uint8_t*)heightImage(x, z); //height of this pixel
-			terrain_data[index].p.y = height; //store it as the y value for the corresponding vertex
-			index++;
+			vertices[i].p.y = band[i]; //store it as the y value for the corresponding vertex
 		}
 	}
+	return true;
 }
 
 /*Get the patch of control points going upwards in ascending U-V order.
 We do this rather than my old dprecated method of pushing back to a vector as it is quicker to load 
 and there is no reason to store this info
 */
-std::vector<glm::vec3> TerrainGL::
+utilAyre::BezierPatch TerrainGL::
 DefinePatches(TerrainGL* sourceMesh, bool upperPointversion, int offset)
 {
-	std::vector<glm::vec3> thisPatch{ 16 }; //this patches four corner control points will be in here
+	utilAyre::BezierPatch thisPatch; //fixed size, so copying a patch out never allocates
 
 	thisPatch[0] = sourceMesh->terrain_data[offset].p;
 	thisPatch[1] = sourceMesh->terrain_data[offset + 1].p;
@@ -131,80 +198,381 @@ DefinePatches(TerrainGL* sourceMesh, bool upperPointversion, int offset)
 	return thisPatch;
 }
 
+/*
+Same control points as DefinePatches but without copying them out, the patch is read straight from terrain_data
+*/
+utilAyre::PatchView TerrainGL::
+ViewPatch(int offset) const
+{
+	utilAyre::PatchView view;
+	view.origin = (const char*)&terrain_data[offset].p;
+	view.pointStride = sizeof(Vertex);
+	view.rowStride = sizeof(Vertex) * verts_x;
+	return view;
+}
+
 /*PIECEWISE USING THE PATCH OFFSET MODULUS 
 AGAINST 3 DUE TO HAVING ROW AND COLUMN OF 4 CPS
+
+Progress used to be printed from in here; hook a BuildProgress up to the mesh to see it now
 */
 void TerrainGL::
 PieceWiseInterpolation(TerrainGL* sourceMesh)
+{
+	ThreadPool serial(1);
+	PieceWiseInterpolation(sourceMesh, serial);
+}
+
+/*
+Same interpolation split into bands of rows across the pool. Every vertex only reads the source mesh
+and writes itself, so the result is bit-identical to the serial version
+*/
+void TerrainGL::
+PieceWiseInterpolation(TerrainGL* sourceMesh, ThreadPool& pool)
+{
+	pool.ParallelFor((size_t)verts_z, [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; ++y)
+		{
+			InterpolateRow(sourceMesh, y);
+			ReportProgress(verts_x);
+		}
+	});
+}
+
+/*
+Works out which patch of the source mesh a vertex falls in, and where inside that patch it is. The patches are
+laid out by LocatePatchSample, the same as BuildBernsteinTable, so on a source that isn't a multiple of 3
+segments the last row and column of patches are shorter ones rather than reading past the edge
+*/
+int TerrainGL::
+PatchCoordinates(TerrainGL* sourceMesh, size_t offset, utilAyre::PatchSampleOf<3>& column, utilAyre::PatchSampleOf<3>& row) const
 {
 	int sourceWidth = sourceMesh->verts_x;
-	int percentTracker = terrain_data.size() / 100;
-	int percent = 0;
-	int percentIndex = 0;
 
-	for (size_t y = 0; y < verts_z; ++y)
+	float X = (terrain_data[offset].globalUV.x  *  ((float)sourceMesh->width));
+	float Y = (terrain_data[offset].globalUV.y  *  ((float)sourceMesh->height));
+
+	column = utilAyre::LocatePatchSample<3>(sourceMesh->width, X);
+	row = utilAyre::LocatePatchSample<3>(sourceMesh->height, Y);
+
+	return column.offset + row.offset * sourceWidth;
+}
+
+/*
+Neighbouring vertices along a row mostly land in the same patch, so the row is cut into runs that share
+a patch and each run goes through the SIMD height kernel in one call (at most 16 samples at a time).
+Vertices in a shorter edge patch have weights the kernel can't make from a u and v, so they go one at a time
+*/
+void TerrainGL::
+InterpolateRow(TerrainGL* sourceMesh, size_t y)
+{
+	const size_t kBatch = 16;
+	float U[kBatch], V[kBatch], heights[kBatch];
+	const size_t rowStart = y * verts_x;
+
+	size_t x = 0;
+	while (x < verts_x)
 	{
-		for (size_t x = 0; x < verts_x; ++x)
+		utilAyre::PatchSampleOf<3> column, row;
+		int patchID = PatchCoordinates(sourceMesh, rowStart + x, column, row);
+		utilAyre::HeightPatch patch = utilAyre::HeightsOf(sourceMesh->ViewPatch(patchID));
+
+		if (column.degree < 3 || row.degree < 3)
 		{
-			size_t offset = x + y * verts_x;
+			terrain_data[rowStart + x].p.y = utilAyre::BezierHeight(patch, utilAyre::PatchSampleWeights(column), utilAyre::PatchSampleWeights(row));
+			x++;
+			continue;
+		}
 
-			float X = (terrain_data[offset].globalUV.x  *  ((float)sourceMesh->width));
-			float Y = (terrain_data[offset].globalUV.y  *  ((float)sourceMesh->height));
+		U[0] = column.t;
+		V[0] = row.t;
+		size_t count = 1;
+		while (count < kBatch && x + count < verts_x &&
+			PatchCoordinates(sourceMesh, rowStart + x + count, column, row) == patchID)
+		{
+			U[count] = column.t;
+			V[count] = row.t;
+			count++;
+		}
 
-			int xPatchOffset = (int)X - (int)X % 3; //acts as a patch toggle based on the 4 control points per patch X/Z axis
-			int yPatchOffset = (int)Y - (int)Y % 3;
+		utilAyre::BezierHeightBatch(patch, U, V, heights, count);
 
-			int patchID = xPatchOffset + yPatchOffset * sourceWidth;
+		for (size_t i = 0; i < count; ++i)
+		{
+			terrain_data[rowStart + x + i].p.y = heights[i];
+		}
+		x += count;
+	}
+}
 
-			float U = (X - xPatchOffset) / 3;
-			float V = (Y - yPatchOffset) / 3;
+/*
+Tensor-product version of the same surface. The hi-res grid is regular, so every output column reuses the same
+patch offset and u weights on every row (and likewise for rows and v). Both sets go into tables up front, then a
+horizontal pass filters every source row out to the target width and a vertical pass filters those down to the
+target height: two 4-tap filters per vertex instead of a 16 point patch.
+Works for any source/target size, and both lay the patches out with LocatePatchSample and sum in the same order,
+so it gives exactly the same heights as PieceWiseInterpolation, shorter edge patches and all
+*/
+void TerrainGL::
+SeparableInterpolation(TerrainGL* sourceMesh)
+{
+	ThreadPool serial(1);
+	SeparableInterpolation(sourceMesh, serial);
+}
 
-			terrain_data[offset].p.y = utilAyre::BezierPatchSixteenPoints(DefinePatches(sourceMesh, true, patchID), U, V).y;
+void TerrainGL::
+SeparableInterpolation(TerrainGL* sourceMesh, ThreadPool& pool)
+{
+	SeparableInterpolationOfDegree<3>(sourceMesh, pool);
+}
 
-			percentIndex++;
-			if (percentIndex == percentTracker)
+void TerrainGL::
+SeparableInterpolation(TerrainGL* sourceMesh, ThreadPool& pool, int degree)
+{
+	switch (degree)
+	{
+	case 2:
+		SeparableInterpolationOfDegree<2>(sourceMesh, pool);
+		break;
+	case 3:
+		SeparableInterpolationOfDegree<3>(sourceMesh, pool);
+		break;
+	default:
+		std::cerr << "No " << degree << " degree patches, using bi-cubic" << std::endl;
+		SeparableInterpolationOfDegree<3>(sourceMesh, pool);
+		break;
+	}
+}
+
+/*
+The tables and the filter come from the degree templates, so the taps per vertex are known at compile time
+and the filters unroll. At degree 3 they're the same weights and sums as BuildBernsteinTable/BernsteinFilter
+*/
+template<int Degree>
+void TerrainGL::
+SeparableInterpolationOfDegree(TerrainGL* sourceMesh, ThreadPool& pool)
+{
+	const size_t sourceRows = (size_t)sourceMesh->verts_z;
+	const size_t sourceStride = sourceMesh->verts_x;
+	const size_t targetColumns = verts_x;
+
+	const utilAyre::BernsteinTableOf<Degree> columns = utilAyre::BuildBernsteinTableOf<Degree>(sourceMesh->width, targetColumns);
+	const utilAyre::BernsteinTableOf<Degree> rows = utilAyre::BuildBernsteinTableOf<Degree>(sourceMesh->height, (size_t)verts_z);
+
+	const bool normals = analyticNormals && verts_x > 1 && verts_z > 1;
+
+	std::vector<float> horizontal(sourceRows * targetColumns); //every source row, already stretched to the target width
+	std::vector<float> horizontalSlope(normals ? horizontal.size() : 0); //and its d/du
+
+	pool.ParallelFor(sourceRows, [&](size_t begin, size_t end)
+	{
+		float taps[Degree + 1];
+		for (size_t r = begin; r < end; ++r)
+		{
+			const Vertex* sourceRow = &sourceMesh->terrain_data[r * sourceStride];
+			for (size_t x = 0; x < targetColumns; ++x)
+			{
+				const Vertex* first = sourceRow + columns.offsets[x];
+				for (int k = 0; k <= Degree; ++k)
+				{
+					taps[k] = first[k].p.y;
+				}
+				horizontal[r * targetColumns + x] = utilAyre::BernsteinFilterOf<Degree>(taps, 1, columns.weights[x]);
+
+				if (normals)
+					horizontalSlope[r * targetColumns + x] = utilAyre::BernsteinFilterOf<Degree>(taps, 1, columns.slopes[x]);
+			}
+		}
+	});
+
+	//d/du comes down through the same v weights as the heights, d/dv is the heights through the v slopes
+	const glm::vec2 slopeScale = normals ? PatchSlopeScale(sourceMesh->width, sourceMesh->height, terrain_data.front().p, terrain_data.back().p,
+		verts_x, (size_t)verts_z, Degree) : glm::vec2(0);
+
+	pool.ParallelFor((size_t)verts_z, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; ++z)
+		{
+			const float* taps = &horizontal[rows.offsets[z] * targetColumns];
+			for (size_t x = 0; x < targetColumns; ++x)
 			{
-				percent++;
-				std::cout << percent << "% Bezier Processed" << std::endl;
-				percentIndex = 0;
+				terrain_data[x + z * verts_x].p.y = utilAyre::BernsteinFilterOf<Degree>(taps + x, targetColumns, rows.weights[z]);
 			}
+
+			if (normals)
+			{
+				const float* slopeTaps = &horizontalSlope[rows.offsets[z] * targetColumns];
+				for (size_t x = 0; x < targetColumns; ++x)
+				{
+					float du = utilAyre::BernsteinFilterOf<Degree>(slopeTaps + x, targetColumns, rows.weights[z]);
+					float dv = utilAyre::BernsteinFilterOf<Degree>(taps + x, targetColumns, rows.slopes[z]);
+					terrain_data[x + z * verts_x].n = SlopeNormal(du * slopeScale.x, dv * slopeScale.y);
+				}
+			}
+			ReportProgress(verts_x);
+		}
+	});
+}
+
+/*
+The separable pass for just a rectangle of the target, for edits. Only the source rows and columns the region's
+filters touch get the horizontal pass, and the taps are the same values summed in the same order, so the
+region comes out bit-identical to the same vertices of a full SeparableInterpolation
+*/
+void TerrainGL::
+SeparableInterpolationRegion(TerrainGL* sourceMesh, const TerrainRegion& region)
+{
+	if (region.Empty())
+		return;
+
+	const size_t sourceStride = sourceMesh->verts_x;
+	const size_t width = region.endX - region.firstX;
+
+	const utilAyre::BernsteinTable columns = utilAyre::BuildBernsteinTable(sourceMesh->width, verts_x);
+	const utilAyre::BernsteinTable rows = utilAyre::BuildBernsteinTable(sourceMesh->height, (size_t)verts_z);
+
+	//offsets never go down along an axis, so the first and last sample bound every row the region reads
+	const size_t firstRow = rows.offsets[region.firstZ];
+	const size_t rowCount = rows.offsets[region.endZ - 1] + 4 - firstRow;
+
+	const bool normals = analyticNormals && verts_x > 1 && verts_z > 1;
+
+	std::vector<float> horizontal(rowCount * width);
+	std::vector<float> horizontalSlope(normals ? horizontal.size() : 0);
+	float taps[4];
+	for (size_t r = 0; r < rowCount; ++r)
+	{
+		const Vertex* sourceRow = &sourceMesh->terrain_data[(firstRow + r) * sourceStride];
+		for (size_t x = region.firstX; x < region.endX; ++x)
+		{
+			const Vertex* first = sourceRow + columns.offsets[x];
+			taps[0] = first[0].p.y;
+			taps[1] = first[1].p.y;
+			taps[2] = first[2].p.y;
+			taps[3] = first[3].p.y;
+			horizontal[r * width + x - region.firstX] = utilAyre::BernsteinFilter(taps, 1, columns.weights[x]);
+
+			if (normals)
+				horizontalSlope[r * width + x - region.firstX] = utilAyre::BernsteinFilter(taps, 1, columns.slopes[x]);
 		}
 	}
 
+	const glm::vec2 slopeScale = normals ? PatchSlopeScale(sourceMesh->width, sourceMesh->height, terrain_data.front().p, terrain_data.back().p,
+		verts_x, (size_t)verts_z, 3) : glm::vec2(0);
+
+	for (size_t z = region.firstZ; z < region.endZ; ++z)
+	{
+		const float* rowTaps = &horizontal[(rows.offsets[z] - firstRow) * width];
+		for (size_t x = region.firstX; x < region.endX; ++x)
+		{
+			terrain_data[x + z * verts_x].p.y = utilAyre::BernsteinFilter(rowTaps + x - region.firstX, width, rows.weights[z]);
+		}
+
+		if (normals)
+		{
+			const float* slopeTaps = &horizontalSlope[(rows.offsets[z] - firstRow) * width];
+			for (size_t x = region.firstX; x < region.endX; ++x)
+			{
+				float du = utilAyre::BernsteinFilter(slopeTaps + x - region.firstX, width, rows.weights[z]);
+				float dv = utilAyre::BernsteinFilter(rowTaps + x - region.firstX, width, rows.slopes[z]);
+				terrain_data[x + z * verts_x].n = SlopeNormal(du * slopeScale.x, dv * slopeScale.y);
+			}
+		}
+	}
 }
 
 /*
-Apply a simplistic brownian Perlin noise to the mesh's y value per vertex
+Apply a fractal gradient noise to the mesh's y value per vertex
 I aimed for a very minor and rough detail similar to grassland
 */
 void TerrainGL::
 ApplyNoise()
 {
-	for (size_t i = 0; i < terrain_data.size(); i++)
+	ApplyNoiseRange(0, terrain_data.size());
+}
+
+/*
+Each height only depends on its own vertex, so any split of the range gives the same bits
+*/
+void TerrainGL::
+ApplyNoise(ThreadPool& pool)
+{
+	pool.ParallelFor(terrain_data.size(), [&](size_t begin, size_t end)
 	{
-		terrain_data[i].p = utilAyre::Brownian(terrain_data[i].p, 400, 8, 1.7f, 0.65f, 1.5f);
+		ApplyNoiseRange(begin, end);
+	});
+}
+
+/*
+Pulls the x/z of a block of vertices out into flat arrays so the batch noise can run over them
+*/
+void TerrainGL::
+ApplyNoiseRange(size_t begin, size_t end)
+{
+	const size_t kBlock = 256;
+	float xs[kBlock], zs[kBlock], heights[kBlock];
+	float slopesX[kBlock], slopesZ[kBlock];
+
+	for (size_t first = begin; first < end; first += kBlock)
+	{
+		size_t count = std::min(kBlock, end - first);
+		for (size_t i = 0; i < count; ++i)
+		{
+			xs[i] = terrain_data[first + i].p.x;
+			zs[i] = terrain_data[first + i].p.z;
+		}
+
+		if (analyticNormals)
+		{
+			utilAyre::GradientFbmBatch(xs, zs, heights, slopesX, slopesZ, count, noiseSettings);
+			for (size_t i = 0; i < count; ++i)
+			{
+				terrain_data[first + i].p.y += heights[i];
+				terrain_data[first + i].n = TiltNormal(terrain_data[first + i].n, slopesX[i], slopesZ[i]);
+			}
+		}
+		else
+		{
+			utilAyre::GradientFbmBatch(xs, zs, heights, count, noiseSettings);
+			for (size_t i = 0; i < count; ++i)
+			{
+				terrain_data[first + i].p.y += heights[i];
+			}
+		}
+		ReportProgress(count);
 	}
 }
 
+void TerrainGL::
+ReportProgress(size_t vertices) const
+{
+	if (progress)
+		progress->Advance(vertices);
+}
+
 /*
 Calculates the cross product of the traingles points in order to get the surface normal per triangle
-Normalises every normal at the end
+Normalises every normal at the end. The cross products aren't normalised first, so bigger faces count
+for more: this is the area-weighted reference the faster grid normals get checked against
 */
 void TerrainGL::
 CalculateNormals()
 {
 	glm::vec3 tempNormal;
 
+	for (size_t i = 0; i < terrain_data.size(); ++i) //start from nothing so running this twice gives the same answer
+	{
+		terrain_data[i].n = glm::vec3(0);
+	}
+
 	for (size_t i = 0; i < terrain_elements.size(); i += 3) // for each triangle in the entire terrain
 	{
 		glm::vec3 p1 = terrain_data[terrain_elements[i]].p; //get the triangle positions out of the three elements
 		glm::vec3 p2 = terrain_data[terrain_elements[i + 1]].p;
 		glm::vec3 p3 = terrain_data[terrain_elements[i + 2]].p;
 
-		glm::vec3 u = p2 - p1;
-		glm::vec3 v = p3 - p1;
-
-		tempNormal = glm::cross(u, v);
+		tempNormal = FaceNormal(p1, p2, p3);
 
 		terrain_data[terrain_elements[i]].n += tempNormal; // push this normal into the list
 		terrain_data[terrain_elements[i + 1]].n += tempNormal; // push this normal into the list
@@ -212,10 +580,419 @@ CalculateNormals()
 
 	}
 
-	for (size_t i = 0; i < terrain_elements.size(); i += 3)
+	for (size_t i = 0; i < terrain_data.size(); ++i)
+	{
+		terrain_data[i].n = SafeNormalize(terrain_data[i].n);
+	}
+}
+
+/*
+The scatter above races if split across threads, so the parallel version flips it into a gather:
+each vertex visits the (up to) four quads around it and adds the faces it belongs to, in the same
+ascending triangle order as the scatter loop. Same additions in the same order = same bits
+*/
+void TerrainGL::
+CalculateNormals(ThreadPool& pool)
+{
+	pool.ParallelFor((size_t)verts_z, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; ++z)
+		{
+			for (size_t x = 0; x < verts_x; ++x)
+			{
+				GatherVertexNormal(x, z);
+			}
+			ReportProgress(verts_x);
+		}
+	});
+}
+
+void TerrainGL::
+GatherVertexNormal(size_t x, size_t z)
+{
+	const int vertex = (int)(x + z * verts_x);
+	glm::vec3 normal = glm::vec3(0);
+
+	for (int qz = (int)z - 1; qz <= (int)z; ++qz)
+	{
+		if (qz < 0 || qz >= (int)height)
+			continue;
+
+		for (int qx = (int)x - 1; qx <= (int)x; ++qx)
+		{
+			if (qx < 0 || qx >= (int)width)
+				continue;
+
+			size_t quad = (qx + qz * width) * 6; //MakeMesh pushes six elements per quad, row by row
+
+			for (size_t i = quad; i < quad + 6; i += 3)
+			{
+				if (terrain_elements[i] != vertex && terrain_elements[i + 1] != vertex && terrain_elements[i + 2] != vertex)
+					continue;
+
+				normal += FaceNormal(terrain_data[terrain_elements[i]].p,
+					terrain_data[terrain_elements[i + 1]].p,
+					terrain_data[terrain_elements[i + 2]].p);
+			}
+		}
+	}
+
+	terrain_data[vertex].n = SafeNormalize(normal);
+}
+
+/*
+Heightfield-only normals. On a grid the neighbours of a vertex are just the vertices either side of it in
+the row and the same column in the rows above and below, so there's no need to go through the triangles:
+the normal is the cross of the two central differences. Each vertex only reads positions and only writes
+its own normal, so rows split across threads with no clashes, and the inner loop is straight-line maths.
+Falls back to one-sided differences along the edges of the grid.
+
+It stays within kGridNormalToleranceDegrees of the area-weighted CalculateNormals (the normal_deviation
+check). The worst of it is along the patch seams, where the slope changes suddenly and the triangles either
+side weight it differently to the differences: 1.20 degrees for a 63x63 base at 255x255, 0.33 at 1023x1023 and
+1.33 for 40x70 at 300x200. The noise adds a little on top (1.26, 0.50 and 1.60), since the triangles see the
+finest octaves through their diagonals and the differences don't
+*/
+glm::vec3 TerrainGL::
+GridNormal(const glm::vec3& left, const glm::vec3& right, const glm::vec3& up, const glm::vec3& down)
+{
+	float dxX = right.x - left.x;
+	float dxY = right.y - left.y;
+	float dzY = down.y - up.y;
+	float dzZ = down.z - up.z;
+
+	//cross((dxX, dxY, 0), (0, dzY, dzZ)) written out, so the compiler has nothing to shuffle
+	float nx = dxY * dzZ;
+	float ny = -dxX * dzZ;
+	float nz = dxX * dzY;
+	float inverseLength = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz);
+
+	return glm::vec3(nx * inverseLength, ny * inverseLength, nz * inverseLength);
+}
+
+glm::vec3 TerrainGL::
+SlopeNormal(float dhdx, float dhdz)
+{
+	float inverseLength = 1.0f / std::sqrt(dhdx * dhdx + 1.0f + dhdz * dhdz);
+	return glm::vec3(-dhdx * inverseLength, inverseLength, -dhdz * inverseLength);
+}
+
+glm::vec3 TerrainGL::
+TiltNormal(const glm::vec3& normal, float dhdx, float dhdz)
+{
+	return SlopeNormal(dhdx - normal.x / normal.y, dhdz - normal.z / normal.y);
+}
+
+/*
+Sample i of an axis sits at X = i * segments / samples along the source and u = (X - offset) / degree within its
+patch, so du/di is segments / (samples * degree), and a sample is one grid spacing of world apart
+*/
+glm::vec2 TerrainGL::
+PatchSlopeScale(size_t sourceSegmentsX, size_t sourceSegmentsZ, const glm::vec3& firstVertex, const glm::vec3& lastVertex,
+	size_t vertsX, size_t vertsZ, int degree)
+{
+	float spacingX = (lastVertex.x - firstVertex.x) / (float)(vertsX - 1);
+	float spacingZ = (firstVertex.z - lastVertex.z) / (float)(vertsZ - 1);
+	return glm::vec2((float)sourceSegmentsX / ((float)(vertsX * degree) * spacingX),
+		-(float)sourceSegmentsZ / ((float)(vertsZ * degree) * spacingZ));
+}
+
+void TerrainGL::
+CalculateGridNormals()
+{
+	ThreadPool serial(1);
+	CalculateGridNormals(serial);
+}
+
+void TerrainGL::
+CalculateGridNormals(ThreadPool& pool)
+{
+	const size_t rows = (size_t)verts_z;
+	const size_t columns = verts_x;
+
+	if (rows < 2 || columns < 2)
+		return;
+
+	pool.ParallelFor(rows, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; ++z)
+		{
+			Vertex* row = &terrain_data[z * columns];
+			const Vertex* up = &terrain_data[(z > 0 ? z - 1 : z) * columns];
+			const Vertex* down = &terrain_data[(z + 1 < rows ? z + 1 : z) * columns];
+
+			row[0].n = GridNormal(row[0].p, row[1].p, up[0].p, down[0].p);
+
+			for (size_t x = 1; x + 1 < columns; ++x)
+			{
+				row[x].n = GridNormal(row[x - 1].p, row[x + 1].p, up[x].p, down[x].p);
+			}
+
+			row[columns - 1].n = GridNormal(row[columns - 2].p, row[columns - 1].p, up[columns - 1].p, down[columns - 1].p);
+			ReportProgress(columns);
+		}
+	});
+}
+
+/*
+Noise for a rectangle of the grid, a row of the region at a time
+*/
+void TerrainGL::
+ApplyNoiseRegion(const TerrainRegion& region)
+{
+	for (size_t z = region.firstZ; z < region.endZ; ++z)
+	{
+		ApplyNoiseRange(z * verts_x + region.firstX, z * verts_x + region.endX);
+	}
+}
+
+/*
+Grid normals for a rectangle. Same neighbours and edge fallbacks as the full pass, so the same bits
+*/
+void TerrainGL::
+CalculateGridNormalsRegion(const TerrainRegion& region)
+{
+	const size_t rows = (size_t)verts_z;
+	const size_t columns = verts_x;
+
+	if (rows < 2 || columns < 2)
+		return;
+
+	for (size_t z = region.firstZ; z < region.endZ; ++z)
+	{
+		Vertex* row = &terrain_data[z * columns];
+		const Vertex* up = &terrain_data[(z > 0 ? z - 1 : z) * columns];
+		const Vertex* down = &terrain_data[(z + 1 < rows ? z + 1 : z) * columns];
+
+		for (size_t x = region.firstX; x < region.endX; ++x)
+		{
+			size_t left = x > 0 ? x - 1 : x;
+			size_t right = x + 1 < columns ? x + 1 : x;
+			row[x].n = GridNormal(row[left].p, row[right].p, up[x].p, down[x].p);
+		}
+	}
+}
+
+/*
+Largest angle between this terrain's normals and another's, for checking one normal pass against another
+*/
+float TerrainGL::
+MaxNormalDeviationDegrees(const TerrainGL& other) const
+{
+	float worst = 0;
+	for (size_t i = 0; i < terrain_data.size() && i < other.terrain_data.size(); ++i)
+	{
+		const glm::vec3& a = terrain_data[i].n;
+		const glm::vec3& b = other.terrain_data[i].n;
+		float angle = std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)) * 57.2957795f;
+		worst = std::max(worst, angle);
+	}
+	return worst;
+}
+
+bool TerrainGL::
+IsBitIdentical(const TerrainGL& other) const
+{
+	return terrain_data.size() == other.terrain_data.size() &&
+		terrain_elements == other.terrain_elements &&
+		std::memcmp(terrain_data.data(), other.terrain_data.data(), terrain_data.size() * sizeof(Vertex)) == 0;
+}
+
+/*
+Builds the hi-res terrain once serially as the reference, then once per thread count up to the
+hardware concurrency (or maxThreads), printing the time, speedup and whether the output matched the reference
+bit for bit
+*/
+bool TerrainGL::
+ReportThreadScaling(TerrainGL* sourceMesh, int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ, std::ostream& out,
+	unsigned int maxThreads)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	TerrainGL reference(meshSizeX, meshSizeZ, targetSizeX, targetSizeZ);
+	auto start = Clock::now();
+	reference.PieceWiseInterpolation(sourceMesh);
+	reference.ApplyNoise();
+	reference.CalculateNormals();
+	double serialMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	out << "Terrain build thread scaling (" << meshSizeX << "x" << meshSizeZ << ")" << std::endl;
+	out << "  serial: " << serialMs << " ms" << std::endl;
+
+	if (maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	bool identical = true;
+
+	for (unsigned int threads = 1; threads <= maxThreads; ++threads)
 	{
-		glm::normalize(tempNormal);
+		ThreadPool pool(threads);
+		TerrainGL terrain(meshSizeX, meshSizeZ, targetSizeX, targetSizeZ);
+
+		start = Clock::now();
+		terrain.PieceWiseInterpolation(sourceMesh, pool);
+		terrain.ApplyNoise(pool);
+		terrain.CalculateNormals(pool);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		const bool same = terrain.IsBitIdentical(reference);
+		identical = identical && same;
+		out << "  " << threads << " threads: " << ms << " ms, speedup " << serialMs / ms << "x, "
+			<< (same ? "bit-identical" : "MISMATCH") << std::endl;
 	}
+	return identical;
+}
+
+/*
+The positions and UVs come out of GridPosition and the same divides MakeMesh does, so nothing but the elements
+needs a pass of its own, and those never touch the vertices. Tiles only write their own vertices, so they go
+to the pool in any order
+*/
+void TerrainGL::
+FusedBuild(TerrainGL* sourceMesh, int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ, ThreadPool& pool)
+{
+	verts_x = meshSizeX + 1;
+	verts_z = (float)meshSizeZ + 1;
+	width = meshSizeX;
+	height = meshSizeZ;
+	analyticNormals = true;
+
+	const size_t rows = (size_t)verts_z;
+	terrain_data.resize(verts_x * rows);
+	MakeElements(meshSizeX, meshSizeZ);
+
+	const utilAyre::BernsteinTable columnTable = utilAyre::BuildBernsteinTable(sourceMesh->width, verts_x);
+	const utilAyre::BernsteinTable rowTable = utilAyre::BuildBernsteinTable(sourceMesh->height, rows);
+	const glm::vec2 slopeScale = PatchSlopeScale(sourceMesh->width, sourceMesh->height,
+		GridPosition(0, 0, verts_x, verts_z, targetSizeX, targetSizeZ),
+		GridPosition(verts_x - 1, rows - 1, verts_x, verts_z, targetSizeX, targetSizeZ), verts_x, rows, 3);
+
+	const size_t tilesX = (verts_x + kFusedTileSize - 1) / kFusedTileSize;
+	const size_t tilesZ = (rows + kFusedTileSize - 1) / kFusedTileSize;
+
+	pool.ParallelFor(tilesX * tilesZ, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; ++t)
+		{
+			TerrainRegion tile;
+			tile.firstX = (t % tilesX) * kFusedTileSize;
+			tile.firstZ = (t / tilesX) * kFusedTileSize;
+			tile.endX = std::min(tile.firstX + kFusedTileSize, verts_x);
+			tile.endZ = std::min(tile.firstZ + kFusedTileSize, rows);
+			FusedTile(sourceMesh, tile, columnTable, rowTable, slopeScale, targetSizeX, targetSizeZ);
+		}
+	});
+}
+
+/*
+SeparableInterpolationRegion's horizontal pass over just the source rows and columns under the tile, then a row
+at a time: the noise and its slopes through the grid kernel, and every vertex finished in one write
+*/
+void TerrainGL::
+FusedTile(TerrainGL* sourceMesh, const TerrainRegion& tile, const utilAyre::BernsteinTable& columns, const utilAyre::BernsteinTable& rows,
+	const glm::vec2& slopeScale, int targetSizeX, int targetSizeZ)
+{
+	const size_t sourceStride = sourceMesh->verts_x;
+	const size_t width = tile.endX - tile.firstX;
+	const size_t firstRow = rows.offsets[tile.firstZ];
+	const size_t rowCount = rows.offsets[tile.endZ - 1] + 4 - firstRow;
+
+	std::vector<float> horizontal(rowCount * width), horizontalSlope(rowCount * width);
+	float taps[4];
+	for (size_t r = 0; r < rowCount; ++r)
+	{
+		const Vertex* sourceRow = &sourceMesh->terrain_data[(firstRow + r) * sourceStride];
+		for (size_t x = tile.firstX; x < tile.endX; ++x)
+		{
+			const Vertex* first = sourceRow + columns.offsets[x];
+			taps[0] = first[0].p.y;
+			taps[1] = first[1].p.y;
+			taps[2] = first[2].p.y;
+			taps[3] = first[3].p.y;
+			horizontal[r * width + x - tile.firstX] = utilAyre::BernsteinFilter(taps, 1, columns.weights[x]);
+			horizontalSlope[r * width + x - tile.firstX] = utilAyre::BernsteinFilter(taps, 1, columns.slopes[x]);
+		}
+	}
+
+	std::vector<float> xs(width), noise(width), noiseX(width), noiseZ(width);
+	for (size_t x = tile.firstX; x < tile.endX; ++x)
+	{
+		xs[x - tile.firstX] = GridPosition(x, 0, verts_x, verts_z, targetSizeX, targetSizeZ).x;
+	}
+
+	for (size_t z = tile.firstZ; z < tile.endZ; ++z)
+	{
+		const float worldZ = GridPosition(0, z, verts_x, verts_z, targetSizeX, targetSizeZ).z;
+		utilAyre::GradientFbmGrid(xs.data(), width, &worldZ, 1, noise.data(), noiseX.data(), noiseZ.data(), noiseSettings);
+
+		const float* rowTaps = &horizontal[(rows.offsets[z] - firstRow) * width];
+		const float* slopeTaps = &horizontalSlope[(rows.offsets[z] - firstRow) * width];
+		const float V = (float)z / verts_z;
+
+		for (size_t i = 0; i < width; ++i)
+		{
+			const size_t x = tile.firstX + i;
+
+			float y = utilAyre::BernsteinFilter(rowTaps + i, width, rows.weights[z]);
+			y += noise[i];
+
+			float du = utilAyre::BernsteinFilter(slopeTaps + i, width, rows.weights[z]);
+			float dv = utilAyre::BernsteinFilter(rowTaps + i, width, rows.slopes[z]);
+
+			Vertex& vertex = terrain_data[x + z * verts_x];
+			vertex.p = glm::vec3(xs[i], y, worldZ);
+			vertex.n = TiltNormal(SlopeNormal(du * slopeScale.x, dv * slopeScale.y), noiseX[i], noiseZ[i]);
+			vertex.globalUV = glm::vec2((float)x / verts_x, V);
+			vertex.localUV = glm::vec2(0);
+		}
+		ReportProgress(width);
+	}
+}
+
+/*
+Best of three runs each, both on the same pool. The traffic is counted from the passes rather than measured:
+every pass over terrain_data reads and writes the whole array, the resize that first touches it writes it once
+more, and the horizontal buffers go out and back once
+*/
+void TerrainGL::
+ReportFusedBuild(TerrainGL* sourceMesh, int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ,
+	const utilAyre::NoiseSettings& noise, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	ThreadPool pool;
+
+	std::unique_ptr<TerrainGL> multiPass, fused;
+	double multiMs = 0, fusedMs = 0;
+	for (int run = 0; run < 3; ++run)
+	{
+		multiPass.reset();
+		auto start = Clock::now();
+		multiPass.reset(new TerrainGL(meshSizeX, meshSizeZ, targetSizeX, targetSizeZ));
+		multiPass->noiseSettings = noise;
+		multiPass->analyticNormals = true;
+		multiPass->SeparableInterpolation(sourceMesh, pool);
+		multiPass->ApplyNoise(pool);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		multiMs = run == 0 ? ms : std::min(multiMs, ms);
+
+		fused.reset();
+		start = Clock::now();
+		fused.reset(new TerrainGL());
+		fused->noiseSettings = noise;
+		fused->FusedBuild(sourceMesh, meshSizeX, meshSizeZ, targetSizeX, targetSizeZ, pool);
+		ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		fusedMs = run == 0 ? ms : std::min(fusedMs, ms);
+	}
+
+	const double vertexMB = fused->terrain_data.size() * sizeof(Vertex) / (1024.0 * 1024.0);
+	const double horizontalMB = 2.0 * (size_t)sourceMesh->verts_z * fused->verts_x * sizeof(float) / (1024.0 * 1024.0);
+	const double multiMB = vertexMB * (1 + 2 * 3) + horizontalMB * 2; //resize, then MakeMesh, interpolation and noise
+	const double fusedMB = vertexMB * (1 + 2);                          //resize, then the tiles
+
+	out << "Fused terrain build (" << meshSizeX << "x" << meshSizeZ << ", " << kFusedTileSize << " vertex tiles, " << pool.ThreadCount() << " threads)" << std::endl;
+	out << "  multi-pass: " << multiMs << " ms, ~" << multiMB << " MB of vertex traffic (estimated), " << horizontalMB << " MB scratch" << std::endl;
+	out << "  fused: " << fusedMs << " ms, ~" << fusedMB << " MB of vertex traffic (estimated), speedup " << multiMs / fusedMs << "x, "
+		<< (fused->IsBitIdentical(*multiPass) ? "bit-identical" : "MISMATCH") << std::endl;
 }
 
 void TerrainGL::
@@ -5,9 +5,13 @@
 #include <numeric>
 #include <random>
 #include <algorithm>
-#include <glm\glm.hpp>
-#include <tygra\Image.hpp>
+#include <ostream>
+#include <glm/glm.hpp>
 #include "NoiseBezierLib.hpp" //include my perlin noise and bezier library
+#include "GradientNoiseLib.hpp"
+#include "MyThreadPool.hpp"
+#include "MyHeightmapSource.hpp"
+#include "MyBuildProfiler.hpp"
 
 struct Perlin
 {
@@ -30,10 +34,30 @@ struct Vertex
 	glm::vec2 localUV;
 };
 
+/*
+A rectangle of grid vertices, first inclusive and end exclusive, used to redo part of a terrain after an edit
+*/
+struct TerrainRegion
+{
+	size_t firstX{ 0 }, firstZ{ 0 };
+	size_t endX{ 0 }, endZ{ 0 };
+
+	bool
+	Empty() const { return endX <= firstX || endZ <= firstZ; }
+};
+
+const float kGridNormalToleranceDegrees = 2.0f; //grid normals vs area-weighted face normals, worst is at the patch seams
+const size_t kFusedTileSize = 64; //vertices along a side of a FusedBuild tile, 64x64 Vertex is 160 KB so a tile and its scratch fit in L2
+
 class TerrainGL
 {
 public:
 	TerrainGL(int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ);
+
+	/*
+	No mesh at all, for FusedBuild to fill in
+	*/
+	TerrainGL();
 	~TerrainGL();
 
 	std::vector<Vertex> terrain_data;
@@ -41,35 +65,175 @@ public:
 	size_t width, height;
 	size_t verts_x;
 	float verts_z; //this has to be a float for some visual calculations
+	utilAyre::NoiseSettings noiseSettings;
+	BuildProgress* progress{ nullptr }; //optional, the passes add the vertices they finish to it a row at a time
+
+	/*
+	When set, SeparableInterpolation (and its region version) writes each vertex's normal from the patch's own
+	partial derivatives, and ApplyNoise (and its region version) tilts it by the noise's analytic gradient, so the
+	normals are done when the heights are and no normal pass is needed after. ApplyNoise then relies on the
+	normals the interpolation left behind
+	*/
+	bool analyticNormals{ false };
+
+	static glm::vec3
+	GridPosition(size_t x, size_t z, size_t vertsX, float vertsZ, int targetSizeX, int targetSizeZ);
+
+	/*
+	Normal from the positions either side of a vertex along the row and the column, what CalculateGridNormals
+	does per vertex
+	*/
+	static glm::vec3
+	GridNormal(const glm::vec3& left, const glm::vec3& right, const glm::vec3& up, const glm::vec3& down);
+
+	/*
+	Upward unit normal of a heightfield with slopes dh/dx and dh/dz (world units) at a point
+	*/
+	static glm::vec3
+	SlopeNormal(float dhdx, float dhdz);
+
+	/*
+	The normal after adding a height whose slopes are dhdx, dhdz: the surface slopes are read back off the normal
+	(it has to point up), the two added and the result normalized again
+	*/
+	static glm::vec3
+	TiltNormal(const glm::vec3& normal, float dhdx, float dhdz);
+
+	/*
+	What a patch derivative along u and v gets multiplied by to give dh/dx and dh/dz in world units, for a grid
+	of vertsX by vertsZ from firstVertex to lastVertex resampled from patches of the given degree over a source of
+	sourceSegmentsX by sourceSegmentsZ. z is negated since the rows run towards -z
+	*/
+	static glm::vec2
+	PatchSlopeScale(size_t sourceSegmentsX, size_t sourceSegmentsZ, const glm::vec3& firstVertex, const glm::vec3& lastVertex,
+		size_t vertsX, size_t vertsZ, int degree);
 
 	void
 	MakeMesh(int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ);
 
-	std::vector<glm::vec3> TerrainGL::
+	utilAyre::BezierPatch
 	DefinePatches(TerrainGL* sourceMesh, bool upperPointversion, int offset);
 
-	void
-	ApplyHeightMap(tygra::Image heightImage);
+	utilAyre::PatchView
+	ViewPatch(int offset) const;
+
+	bool
+	ApplyHeightMap(HeightmapSource& source);
 
 	void
 	PieceWiseInterpolation(TerrainGL* sourceMesh);
 
+	void
+	PieceWiseInterpolation(TerrainGL* sourceMesh, ThreadPool& pool);
+
+	void
+	SeparableInterpolation(TerrainGL* sourceMesh);
+
+	void
+	SeparableInterpolation(TerrainGL* sourceMesh, ThreadPool& pool);
+
+	/*
+	Same pass with patches of another degree: 2 for bi-quadratic (patches 2 segments wide) or 3 for the usual
+	bi-cubic. Anything else falls back to 3
+	*/
+	void
+	SeparableInterpolation(TerrainGL* sourceMesh, ThreadPool& pool, int degree);
+
+	/*
+	MakeMesh, SeparableInterpolation, ApplyNoise and the analytic normals in one go, a kFusedTileSize square of
+	the grid at a time, so each vertex is written once while its tile is in cache rather than the whole array
+	being streamed through once per pass. Comes out bit-identical to that multi-pass build with analyticNormals
+	on (which it leaves set, so region edits afterwards match)
+	*/
+	void
+	FusedBuild(TerrainGL* sourceMesh, int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ, ThreadPool& pool);
+
+	/*
+	Builds the hi-res terrain both ways and prints the times, an estimate of how much vertex data each way
+	streams through memory (counted from the passes, not measured) and whether the two match bit for bit
+	*/
+	static void
+	ReportFusedBuild(TerrainGL* sourceMesh, int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ,
+		const utilAyre::NoiseSettings& noise, std::ostream& out);
+
 	void
 	BezierInterpolation(TerrainGL* sourceMesh);
 
 	void 
 	DoTheBezier();
 
+	void
+	SeparableInterpolationRegion(TerrainGL* sourceMesh, const TerrainRegion& region);
+
 	void
 	ApplyNoise();
 
+	void
+	ApplyNoise(ThreadPool& pool);
+
 	void
 	CalculateNormals();
 
+	void
+	CalculateNormals(ThreadPool& pool);
+
+	void
+	CalculateGridNormals();
+
+	void
+	CalculateGridNormals(ThreadPool& pool);
+
+	void
+	ApplyNoiseRegion(const TerrainRegion& region);
+
+	void
+	CalculateGridNormalsRegion(const TerrainRegion& region);
+
+	float
+	MaxNormalDeviationDegrees(const TerrainGL& other) const;
+
+	bool
+	IsBitIdentical(const TerrainGL& other) const;
+
+	/*
+	True if every thread count built the same bits as the serial build. maxThreads 0 goes up to the hardware's
+	*/
+	static bool
+	ReportThreadScaling(TerrainGL* sourceMesh, int meshSizeX, int meshSizeZ, int targetSizeX, int targetSizeZ, std::ostream& out,
+		unsigned int maxThreads = 0);
+
 	void 
 	LeftIndexing(int K, int x, int meshSizeX);
 
 	void 
 	RightIndexing(int K, int x, int meshSizeX);
+
+private:
+
+	template<int Degree>
+	void
+	SeparableInterpolationOfDegree(TerrainGL* sourceMesh, ThreadPool& pool);
+
+	void
+	MakeElements(int meshSizeX, int meshSizeZ);
+
+	void
+	FusedTile(TerrainGL* sourceMesh, const TerrainRegion& tile, const utilAyre::BernsteinTable& columns, const utilAyre::BernsteinTable& rows,
+		const glm::vec2& slopeScale, int targetSizeX, int targetSizeZ);
+
+	int
+	PatchCoordinates(TerrainGL* sourceMesh, size_t offset, utilAyre::PatchSampleOf<3>& column, utilAyre::PatchSampleOf<3>& row) const;
+
+	void
+	InterpolateRow(TerrainGL* sourceMesh, size_t y);
+
+	void
+	GatherVertexNormal(size_t x, size_t z);
+
+	void
+	ApplyNoiseRange(size_t begin, size_t end);
+
+	void
+	ReportProgress(size_t vertices) const;
 };
 
@@ -0,0 +1,271 @@
+#include "MyTerrainBenchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "GradientNoiseLib.hpp"
+#include "MyTerrain.hpp"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct BenchmarkResult
+{
+	std::string name;
+	int resolution;  //0 for the kernels
+	size_t items;    //vertices or samples per run
+	double medianMs;
+	double p95Ms;
+};
+
+/*
+Nearest rank, so with a handful of repeats the p95 is simply the slowest run
+*/
+static double
+Percentile(std::vector<double> times, double percentile)
+{
+	std::sort(times.begin(), times.end());
+	size_t rank = (size_t)std::ceil(percentile * times.size());
+	return times[std::min(std::max(rank, (size_t)1), times.size()) - 1];
+}
+
+/*
+setup runs before every repeat and isn't timed, so each run starts from the same state
+*/
+static BenchmarkResult
+Measure(const std::string& name, int resolution, size_t items, int repeats, const std::function<void()>& setup, const std::function<void()>& run)
+{
+	std::vector<double> times;
+	for (int i = 0; i < repeats; ++i)
+	{
+		if (setup)
+			setup();
+
+		auto start = Clock::now();
+		run();
+		times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+
+	BenchmarkResult result;
+	result.name = name;
+	result.resolution = resolution;
+	result.items = items;
+	result.medianMs = Percentile(times, 0.5);
+	result.p95Ms = Percentile(times, 0.95);
+	return result;
+}
+
+static void
+FillSyntheticHeightmap(TerrainGL& base)
+{
+	utilAyre::NoiseSettings hills;
+	hills.frequency = 1.0f / 2048.0f;
+	hills.octaves = 4;
+	hills.scale = 100.0f;
+	hills.seed = 7;
+
+	for (Vertex& v : base.terrain_data)
+	{
+		v.p.y = 128.0f + utilAyre::GradientFbm(v.p.x, v.p.z, hills);
+	}
+}
+
+static void
+WriteResults(const std::vector<BenchmarkResult>& results, const char* itemName, std::ostream& json)
+{
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		double throughput = result.medianMs > 0 ? result.items / (result.medianMs * 1000.0) : 0; //millions per second
+
+		json << "    { \"name\": \"" << result.name << "\", ";
+		if (result.resolution > 0)
+			json << "\"resolution\": " << result.resolution << ", ";
+		json << "\"" << itemName << "\": " << result.items << ", \"median_ms\": " << result.medianMs << ", \"p95_ms\": " << result.p95Ms
+			<< ", \"m" << itemName << "_per_s\": " << throughput << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+}
+
+void
+RunTerrainBenchmarks(const TerrainBenchmarkSettings& settings, std::ostream& json, std::ostream& log)
+{
+	const unsigned int threads = settings.threads > 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+	const int repeats = std::max(1, settings.repeats);
+	ThreadPool pool(threads);
+
+	std::vector<BenchmarkResult> stages;
+	for (int resolution : settings.resolutions)
+	{
+		if (resolution < 16)
+			continue;
+
+		const int segments = resolution - 1;
+		const int baseSegments = std::max(3, resolution / 4 - 1);
+		const size_t vertices = (size_t)resolution * resolution;
+
+		TerrainGL base(baseSegments, baseSegments, settings.worldSize, settings.worldSize);
+		FillSyntheticHeightmap(base);
+
+		std::unique_ptr<TerrainGL> terrain;
+		stages.push_back(Measure("make_mesh", resolution, vertices, repeats,
+			[&] { terrain.reset(); },
+			[&] { terrain.reset(new TerrainGL(segments, segments, settings.worldSize, settings.worldSize)); }));
+
+		stages.push_back(Measure("piecewise_interpolation", resolution, vertices, repeats, nullptr,
+			[&] { terrain->PieceWiseInterpolation(&base, pool); }));
+
+		stages.push_back(Measure("separable_interpolation", resolution, vertices, repeats, nullptr,
+			[&] { terrain->SeparableInterpolation(&base, pool); }));
+
+		//noise adds onto the heights, so put the interpolated ones back before each run
+		stages.push_back(Measure("apply_noise", resolution, vertices, repeats,
+			[&] { terrain->SeparableInterpolation(&base, pool); },
+			[&] { terrain->ApplyNoise(pool); }));
+
+		stages.push_back(Measure("calculate_normals", resolution, vertices, repeats, nullptr,
+			[&] { terrain->CalculateNormals(pool); }));
+
+		stages.push_back(Measure("grid_normals", resolution, vertices, repeats, nullptr,
+			[&] { terrain->CalculateGridNormals(pool); }));
+
+		//the same two passes with the normals coming out of them, which is the whole build with no normal pass
+		terrain->analyticNormals = true;
+		stages.push_back(Measure("analytic_interpolation", resolution, vertices, repeats, nullptr,
+			[&] { terrain->SeparableInterpolation(&base, pool); }));
+
+		stages.push_back(Measure("analytic_noise", resolution, vertices, repeats,
+			[&] { terrain->SeparableInterpolation(&base, pool); },
+			[&] { terrain->ApplyNoise(pool); }));
+		terrain->analyticNormals = false;
+
+		//the whole build both ways, from nothing to finished vertices
+		stages.push_back(Measure("multi_pass_build", resolution, vertices, repeats,
+			[&] { terrain.reset(); },
+			[&]
+			{
+				terrain.reset(new TerrainGL(segments, segments, settings.worldSize, settings.worldSize));
+				terrain->analyticNormals = true;
+				terrain->SeparableInterpolation(&base, pool);
+				terrain->ApplyNoise(pool);
+			}));
+
+		stages.push_back(Measure("fused_build", resolution, vertices, repeats,
+			[&] { terrain.reset(); },
+			[&]
+			{
+				terrain.reset(new TerrainGL());
+				terrain->FusedBuild(&base, segments, segments, settings.worldSize, settings.worldSize, pool);
+			}));
+
+		log << "benchmarked " << resolution << "x" << resolution << std::endl;
+	}
+
+	//the kernels on their own, single threaded, over the same samples every run
+	const size_t samples = std::max((size_t)1, settings.kernelSamples);
+	std::vector<float> us(samples), vs(samples), xs(samples), zs(samples), heights(samples);
+	for (size_t i = 0; i < samples; ++i)
+	{
+		us[i] = (i % 1021) / 1021.0f;
+		vs[i] = (i % 1019) / 1019.0f;
+		xs[i] = (float)(i % 1024) * 8.0f;
+		zs[i] = -(float)(i / 1024) * 8.0f;
+	}
+
+	utilAyre::BezierPatch patch;
+	for (int i = 0; i < 16; ++i)
+	{
+		patch[i] = glm::vec3((float)(i % 4), (float)((i * 37) % 11), (float)(i / 4));
+	}
+	const utilAyre::HeightPatch heightPatch = utilAyre::HeightsOf(utilAyre::PatchView{ (const char*)patch.data(), sizeof(glm::vec3), sizeof(glm::vec3) * 4 });
+	const utilAyre::NoiseSettings noise;
+
+	std::vector<BenchmarkResult> kernels;
+	kernels.push_back(Measure("bezier_patch_sixteen_points", 0, samples, repeats, nullptr, [&]
+	{
+		for (size_t i = 0; i < samples; ++i)
+			heights[i] = utilAyre::BezierPatchSixteenPoints(patch, us[i], vs[i]).y;
+	}));
+	kernels.push_back(Measure("bezier_height_batch", 0, samples, repeats, nullptr, [&]
+	{
+		utilAyre::BezierHeightBatch(heightPatch, us.data(), vs.data(), heights.data(), samples);
+	}));
+	kernels.push_back(Measure("brownian", 0, samples, repeats, nullptr, [&]
+	{
+		for (size_t i = 0; i < samples; ++i)
+			heights[i] = utilAyre::Brownian(glm::vec3(xs[i], 0, zs[i]), noise).y;
+	}));
+	kernels.push_back(Measure("gradient_fbm_batch", 0, samples, repeats, nullptr, [&]
+	{
+		utilAyre::GradientFbmBatch(xs.data(), zs.data(), heights.data(), samples, noise);
+	}));
+	log << "benchmarked kernels" << std::endl;
+
+	json << "{\n";
+	json << "  \"threads\": " << threads << ",\n";
+	json << "  \"simd\": \"" << utilAyre::SimdLevelName(utilAyre::DetectSimdLevel()) << "\",\n";
+	json << "  \"repeats\": " << repeats << ",\n";
+	json << "  \"stages\": [\n";
+	WriteResults(stages, "vertices", json);
+	json << "  ],\n";
+	json << "  \"kernels\": [\n";
+	WriteResults(kernels, "samples", json);
+	json << "  ]\n";
+	json << "}" << std::endl;
+}
+
+#ifdef TERRAIN_BENCHMARK_MAIN
+/*
+Standalone entry point for the headless build, the terrain_benchmark target in CMakeLists.txt:
+	terrain_benchmark [--repeats n] [--threads n] [--samples n] [--out file.json] [resolution ...]
+*/
+int main(int argc, char *argv[])
+{
+	TerrainBenchmarkSettings settings;
+	std::vector<int> resolutions;
+	const char* outPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--repeats") == 0 && hasValue)
+			settings.repeats = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+			settings.threads = (unsigned int)std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--samples") == 0 && hasValue)
+			settings.kernelSamples = (size_t)std::atoll(argv[++i]);
+		else if (std::strcmp(argv[i], "--out") == 0 && hasValue)
+			outPath = argv[++i];
+		else if (std::atoi(argv[i]) > 0)
+			resolutions.push_back(std::atoi(argv[i]));
+		else
+		{
+			std::cerr << "unknown argument " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	if (!resolutions.empty())
+		settings.resolutions = resolutions;
+
+	if (outPath == nullptr)
+	{
+		RunTerrainBenchmarks(settings, std::cout, std::cerr);
+		return 0;
+	}
+
+	std::ofstream out(outPath);
+	if (!out)
+	{
+		std::cerr << "could not open " << outPath << std::endl;
+		return 1;
+	}
+	RunTerrainBenchmarks(settings, out, std::cerr);
+	return 0;
+}
+#endif
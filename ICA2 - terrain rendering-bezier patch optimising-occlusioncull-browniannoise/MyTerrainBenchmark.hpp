@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+/*
+Headless benchmarks for the terrain build, no window or GL context needed, so regressions can be caught on
+a build machine. Each build stage runs over a sweep of terrain resolutions on a synthetic heightmap, and the
+Bezier and noise kernels run on their own, every one of them repeated and written out as JSON with the
+median, the 95th percentile and throughput.
+
+The heightmap is generated from the seeded gradient noise, so every run sees the same input. It has a
+quarter of the terrain's vertices along each side, like the 256 pixel map under the 1024 terrain, so most
+resolutions get shorter patches along the far edges too
+*/
+struct TerrainBenchmarkSettings
+{
+	std::vector<int> resolutions{ 256, 512, 1024, 2048, 4096 }; //vertices along each side of the built terrain
+	int repeats{ 5 };
+	size_t kernelSamples{ 1 << 20 };
+	int worldSize{ 8192 };
+	unsigned int threads{ 0 }; //0 for one per hardware thread
+};
+
+/*
+Runs the lot and writes the JSON to json. Progress lines go to log as each stage finishes
+*/
+void
+RunTerrainBenchmarks(const TerrainBenchmarkSettings& settings, std::ostream& json, std::ostream& log);
@@ -0,0 +1,213 @@
+#include "MyTerrainCache.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+64-bit FNV-1a, chain calls by passing the previous hash back in
+*/
+uint64_t
+HashBytes(const void* data, size_t byteCount, uint64_t hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < byteCount; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t
+TerrainCacheKey(uint64_t heightMapHash, int hiResSizeX, int hiResSizeZ, int worldSizeX, int worldSizeZ, const utilAyre::NoiseSettings& noise)
+{
+	const int sizes[4] = { hiResSizeX, hiResSizeZ, worldSizeX, worldSizeZ };
+
+	uint64_t hash = HashBytes(&heightMapHash, sizeof(heightMapHash));
+	hash = HashBytes(sizes, sizeof(sizes), hash);
+	hash = HashBytes(&noise.frequency, sizeof(noise.frequency), hash);
+	hash = HashBytes(&noise.octaves, sizeof(noise.octaves), hash);
+	hash = HashBytes(&noise.lacunarity, sizeof(noise.lacunarity), hash);
+	hash = HashBytes(&noise.gain, sizeof(noise.gain), hash);
+	hash = HashBytes(&noise.scale, sizeof(noise.scale), hash);
+	hash = HashBytes(&noise.seed, sizeof(noise.seed), hash);
+	return hash;
+}
+
+bool
+ReadFileBytes(const std::string& path, std::vector<char>& bytes)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	bytes.resize((size_t)file.tellg());
+	file.seekg(0);
+	return (bool)file.read(bytes.data(), (std::streamsize)bytes.size());
+}
+
+bool
+HashFile(const std::string& path, uint64_t& hash)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::vector<char> block(1 << 20);
+	hash = HashBytes(nullptr, 0);
+	while (file)
+	{
+		file.read(block.data(), (std::streamsize)block.size());
+		hash = HashBytes(block.data(), (size_t)file.gcount(), hash);
+	}
+	return file.eof();
+}
+
+bool
+WriteTerrainCache(const std::string& path, uint64_t key, const TerrainGL& terrain, double buildMilliseconds)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Could not write terrain cache " << path << std::endl;
+		return false;
+	}
+
+	TerrainCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "TCCH", 4);
+	header.version = kTerrainCacheVersion;
+	header.key = key;
+	header.vertexCount = terrain.terrain_data.size();
+	header.elementCount = terrain.terrain_elements.size();
+	header.vertexStride = sizeof(Vertex);
+	header.elementStride = sizeof(int);
+	header.buildMilliseconds = buildMilliseconds;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)terrain.terrain_data.data(), (std::streamsize)(terrain.terrain_data.size() * sizeof(Vertex)));
+	file.write((const char*)terrain.terrain_elements.data(), (std::streamsize)(terrain.terrain_elements.size() * sizeof(int)));
+	return (bool)file;
+}
+
+MappedTerrainCache::MappedTerrainCache()
+{
+}
+
+MappedTerrainCache::~MappedTerrainCache()
+{
+	Close();
+}
+
+bool MappedTerrainCache::
+Open(const std::string& path, uint64_t key)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	fileHandle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(TerrainCacheHeader))
+	{
+		Close();
+		return false;
+	}
+	mappingSize = (size_t)size.QuadPart;
+
+	mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		Close();
+		return false;
+	}
+	mapping = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fileDescriptor, &info) != 0 || info.st_size < (off_t)sizeof(TerrainCacheHeader))
+	{
+		Close();
+		return false;
+	}
+	mappingSize = (size_t)info.st_size;
+
+	void* view = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	mapping = view == MAP_FAILED ? nullptr : (const char*)view;
+#endif
+
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	const TerrainCacheHeader& header = Header();
+	size_t expectedSize = sizeof(TerrainCacheHeader) + header.vertexCount * sizeof(Vertex) + header.elementCount * sizeof(int);
+
+	if (std::memcmp(header.magic, "TCCH", 4) != 0 || header.version != kTerrainCacheVersion || header.key != key ||
+		header.vertexStride != sizeof(Vertex) || header.elementStride != sizeof(int) || mappingSize != expectedSize)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedTerrainCache::
+Close()
+{
+#ifdef _WIN32
+	if (mapping != nullptr)
+		UnmapViewOfFile(mapping);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (mapping != nullptr)
+		munmap((void*)mapping, mappingSize);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+}
+
+const TerrainCacheHeader& MappedTerrainCache::
+Header() const
+{
+	return *(const TerrainCacheHeader*)mapping;
+}
+
+const Vertex* MappedTerrainCache::
+Vertices() const
+{
+	return (const Vertex*)(mapping + sizeof(TerrainCacheHeader));
+}
+
+const int* MappedTerrainCache::
+Elements() const
+{
+	return (const int*)(mapping + sizeof(TerrainCacheHeader) + Header().vertexCount * sizeof(Vertex));
+}
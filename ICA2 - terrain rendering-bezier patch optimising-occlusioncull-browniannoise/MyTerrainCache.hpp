@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MyTerrain.hpp"
+
+/*
+Binary cache of the finished hi-res terrain. The file is a fixed header followed by the raw Vertex array and
+then the raw element array, so once it is mapped both arrays can go straight into glBufferData.
+
+Bump kTerrainCacheVersion whenever the build pipeline starts producing different output for the same inputs
+*/
+const uint32_t kTerrainCacheVersion = 4;
+
+struct TerrainCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t vertexCount;
+	uint64_t elementCount;
+	uint32_t vertexStride;
+	uint32_t elementStride;
+	double buildMilliseconds; //how long the cold build took, so a warm start can report both
+	uint8_t padding[16];
+};
+
+uint64_t
+HashBytes(const void* data, size_t byteCount, uint64_t hash = 14695981039346656037ULL);
+
+/*
+The heightmap goes in as the hash of its file. The base mesh is sized from the heightmap itself, so its size
+is already covered by that
+*/
+uint64_t
+TerrainCacheKey(uint64_t heightMapHash, int hiResSizeX, int hiResSizeZ, int worldSizeX, int worldSizeZ, const utilAyre::NoiseSettings& noise);
+
+bool
+ReadFileBytes(const std::string& path, std::vector<char>& bytes);
+
+/*
+HashBytes over a whole file, read a block at a time so a big heightmap never has to fit in memory
+*/
+bool
+HashFile(const std::string& path, uint64_t& hash);
+
+bool
+WriteTerrainCache(const std::string& path, uint64_t key, const TerrainGL& terrain, double buildMilliseconds);
+
+/*
+Read-only mapping of a cache file. Open fails (and leaves nothing mapped) if the file is missing,
+truncated, from another version or was built from different inputs
+*/
+class MappedTerrainCache
+{
+public:
+	MappedTerrainCache();
+	~MappedTerrainCache();
+
+	bool
+	Open(const std::string& path, uint64_t key);
+
+	void
+	Close();
+
+	const TerrainCacheHeader&
+	Header() const;
+
+	const Vertex*
+	Vertices() const;
+
+	const int*
+	Elements() const;
+
+private:
+
+	MappedTerrainCache(const MappedTerrainCache&);
+	MappedTerrainCache& operator=(const MappedTerrainCache&);
+
+	const char* mapping{ nullptr };
+	size_t mappingSize{ 0 };
+#ifdef _WIN32
+	void* fileHandle{ nullptr };
+	void* mappingHandle{ nullptr };
+#else
+	int fileDescriptor{ -1 };
+#endif
+};
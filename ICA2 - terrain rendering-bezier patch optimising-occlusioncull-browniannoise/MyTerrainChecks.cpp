@@ -0,0 +1,1350 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+#include "BezierTemplateLib.hpp"
+#include "MyAdaptiveMesh.hpp"
+#include "MyHeightmapSource.hpp"
+#include "MyLazyTerrain.hpp"
+#include "GradientNoiseLib.hpp"
+#include "MyPackedTerrain.hpp"
+#include "MyTerrain.hpp"
+#include "MyTerrainChunks.hpp"
+#include "MyTerrainEditor.hpp"
+#include "MyTerrainIndexing.hpp"
+#include "MyTerrainLod.hpp"
+#include "MyTerrainPager.hpp"
+#include "MyTerrainQuery.hpp"
+#include "MyTerrainTessellation.hpp"
+#include "MyTiledTerrain.hpp"
+
+/*
+Headless checks for the terrain code, the terrain_checks target in CMakeLists.txt, which registers each one
+with ctest by name:
+	terrain_checks [check ...]
+No names runs them all. A check prints what it measured and returns false if anything it expects doesn't
+hold, and the exit code is non-zero if any check failed. The maps are small and seeded, so every run sees the
+same terrain and the whole lot takes seconds
+*/
+
+static const int kWorldSize = 2048;
+
+/*
+Every allocation in the program goes through these, so a check can count what a call allocates
+*/
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size)
+{
+	allocations++;
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+static bool
+Expect(bool condition, const char* what)
+{
+	if (!condition)
+		std::cout << "  expected " << what << std::endl;
+	return condition;
+}
+
+/*
+A base terrain with seeded hills on it, like the benchmark's, standing in for a loaded heightmap
+*/
+static std::unique_ptr<TerrainGL>
+MakeBaseTerrain(int segmentsX, int segmentsZ)
+{
+	utilAyre::NoiseSettings hills;
+	hills.frequency = 1.0f / 512.0f;
+	hills.octaves = 4;
+	hills.scale = 100.0f;
+	hills.seed = 7;
+
+	std::unique_ptr<TerrainGL> base(new TerrainGL(segmentsX, segmentsZ, kWorldSize, kWorldSize));
+	for (Vertex& v : base->terrain_data)
+	{
+		v.p.y = 128.0f + utilAyre::GradientFbm(v.p.x, v.p.z, hills);
+	}
+	return base;
+}
+
+/*
+The pooled build against the serial one, with more threads than rows per thread so the splits land mid-patch
+*/
+static bool
+CheckThreadScaling()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(63, 63);
+	return Expect(TerrainGL::ReportThreadScaling(base.get(), 255, 255, kWorldSize, kWorldSize, std::cout, 4),
+		"every thread count to build the serial build's bits");
+}
+
+/*
+The patch evaluation reads its control points in place and keeps everything else on the stack, so a whole
+PieceWiseInterpolation on a pool that's already running doesn't allocate, edge patches included. Neither does
+evaluating a patch on its own
+*/
+static bool
+CheckPieceWiseAllocations()
+{
+	size_t before = allocations;
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(64, 62);
+	TerrainGL terrain(255, 255, kWorldSize, kWorldSize);
+	ThreadPool pool(2);
+	if (!Expect(allocations > before, "the setup's allocations to be counted"))
+		return false;
+
+	before = allocations;
+	terrain.PieceWiseInterpolation(base.get(), pool);
+	const size_t interpolation = allocations - before;
+
+	before = allocations;
+	float sum = 0;
+	for (int offset = 0; offset < 3 * 20; offset += 3)
+	{
+		sum += terrain.DefinePatches(base.get(), true, offset)[5].y;
+		sum += utilAyre::BezierPatchSixteenPoints(base->ViewPatch(offset), 0.25f, 0.75f).y;
+		sum += utilAyre::BezierHeight(utilAyre::HeightsOf(base->ViewPatch(offset)), 0.5f, 0.5f);
+	}
+	const size_t patches = allocations - before;
+
+	std::cout << "  " << interpolation << " allocations over a 256x256 PieceWiseInterpolation, " << patches
+		<< " over 60 patch evaluations (sum " << sum << ")" << std::endl;
+	return Expect(interpolation == 0, "PieceWiseInterpolation not to allocate") &&
+		Expect(patches == 0, "patch evaluation not to allocate");
+}
+
+static bool
+CheckBezierDegrees()
+{
+	return Expect(utilAyre::ReportBezierDegrees(20000, std::cout), "the degree 3 templates to match the cubic functions bit for bit");
+}
+
+/*
+The height batch at every SIMD level this CPU has against BezierHeight a sample at a time, on random patches
+and counts that leave a tail of 1 to 7 after the last whole vector. The slot after the last sample has to
+come back untouched
+*/
+static bool
+CheckBezierBatch()
+{
+	using utilAyre::SimdLevel;
+	const SimdLevel detected = utilAyre::DetectSimdLevel();
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX };
+	const size_t counts[] = { 1, 3, 7, 8, 13, 100, 1001 };
+	const float guard = -12345.0f;
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> height(-200.0f, 400.0f);
+
+	bool passed = true;
+	for (SimdLevel level : levels)
+	{
+		if ((int)level > (int)detected)
+		{
+			std::cout << "  " << utilAyre::SimdLevelName(level) << ": not on this CPU, skipped" << std::endl;
+			continue;
+		}
+
+		int worst = 0;
+		bool guardKept = true;
+		for (size_t count : counts)
+		{
+			utilAyre::HeightPatch cps;
+			for (float& h : cps)
+				h = height(random);
+
+			std::vector<float> u(count), v(count), out(count + 1, guard);
+			for (size_t i = 0; i < count; ++i)
+			{
+				u[i] = unit(random);
+				v[i] = unit(random);
+			}
+
+			utilAyre::BezierHeightBatch(level, cps, u.data(), v.data(), out.data(), count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				worst = std::max(worst, utilAyre::UlpDistance(out[i], utilAyre::BezierHeight(cps, u[i], v[i])));
+			}
+			guardKept = guardKept && out[count] == guard;
+		}
+
+		std::cout << "  " << utilAyre::SimdLevelName(level) << ": worst " << worst << " ulp (bound " << utilAyre::kBezierBatchMaxUlp << ")" << std::endl;
+		passed = Expect(worst <= utilAyre::kBezierBatchMaxUlp, "the batch within kBezierBatchMaxUlp of BezierHeight") && passed;
+		passed = Expect(guardKept, "nothing written past the last sample") && passed;
+	}
+	return passed;
+}
+
+/*
+The gradient noise has to come out the same bits whichever way it's asked for: each SIMD level of the batch
+against GradientFbm a sample at a time, heights and slopes, the grid version against the batch over the same
+points, and ApplyNoise on any number of threads. Counts leave a tail after the last whole vector
+*/
+static bool
+CheckNoiseKernels()
+{
+	using utilAyre::SimdLevel;
+	utilAyre::NoiseSettings settings;
+	const SimdLevel detected = utilAyre::DetectSimdLevel();
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX };
+	const size_t count = 1027;
+
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> coordinate(-3000.0f, 3000.0f);
+	std::vector<float> xs(count), zs(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		xs[i] = coordinate(random);
+		zs[i] = coordinate(random);
+	}
+
+	auto sameBits = [](const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+	};
+
+	std::vector<float> single(count), singleX(count), singleZ(count);
+	for (size_t i = 0; i < count; ++i)
+		single[i] = utilAyre::GradientFbm(xs[i], zs[i], settings, singleX[i], singleZ[i]);
+
+	bool passed = true;
+	for (SimdLevel level : levels)
+	{
+		if ((int)level > (int)detected)
+		{
+			std::cout << "  " << utilAyre::SimdLevelName(level) << ": not on this CPU, skipped" << std::endl;
+			continue;
+		}
+
+		std::vector<float> heights(count), slopeHeights(count), slopesX(count), slopesZ(count);
+		utilAyre::GradientFbmBatch(level, xs.data(), zs.data(), heights.data(), count, settings);
+		utilAyre::GradientFbmBatch(level, xs.data(), zs.data(), slopeHeights.data(), slopesX.data(), slopesZ.data(), count, settings);
+
+		const bool same = sameBits(heights, single) && sameBits(slopeHeights, single) && sameBits(slopesX, singleX) && sameBits(slopesZ, singleZ);
+		std::cout << "  " << utilAyre::SimdLevelName(level) << " batch: " << (same ? "bit-identical" : "MISMATCH") << std::endl;
+		passed = Expect(same, "the batch heights and slopes to be GradientFbm's bits") && passed;
+	}
+
+	//a 37 x 29 grid, against the batch on every point of it spelled out
+	const size_t countX = 37, countZ = 29;
+	std::vector<float> gridXs(xs.begin(), xs.begin() + countX), gridZs(zs.begin(), zs.begin() + countZ);
+	std::vector<float> pointXs, pointZs;
+	for (size_t z = 0; z < countZ; ++z)
+	{
+		for (size_t x = 0; x < countX; ++x)
+		{
+			pointXs.push_back(gridXs[x]);
+			pointZs.push_back(gridZs[z]);
+		}
+	}
+
+	std::vector<float> grid(countX * countZ), gridX(grid.size()), gridZ(grid.size()), gridSlopeHeights(grid.size());
+	std::vector<float> batch(grid.size()), batchX(grid.size()), batchZ(grid.size()), batchSlopeHeights(grid.size());
+	utilAyre::GradientFbmGrid(gridXs.data(), countX, gridZs.data(), countZ, grid.data(), settings);
+	utilAyre::GradientFbmGrid(gridXs.data(), countX, gridZs.data(), countZ, gridSlopeHeights.data(), gridX.data(), gridZ.data(), settings);
+	utilAyre::GradientFbmBatch(pointXs.data(), pointZs.data(), batch.data(), batch.size(), settings);
+	utilAyre::GradientFbmBatch(pointXs.data(), pointZs.data(), batchSlopeHeights.data(), batchX.data(), batchZ.data(), batch.size(), settings);
+	const bool gridSame = sameBits(grid, batch) && sameBits(gridSlopeHeights, batchSlopeHeights) && sameBits(gridX, batchX) && sameBits(gridZ, batchZ);
+	std::cout << "  grid against batch: " << (gridSame ? "bit-identical" : "MISMATCH") << std::endl;
+	passed = Expect(gridSame, "the grid noise to be the batch's bits") && passed;
+
+	//with and without the analytic normals, since those take the slope kernels
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(63, 63);
+	for (int analytic = 0; analytic < 2; ++analytic)
+	{
+		TerrainGL serial(255, 255, kWorldSize, kWorldSize);
+		serial.analyticNormals = analytic != 0;
+		serial.SeparableInterpolation(base.get());
+		serial.ApplyNoise();
+
+		for (unsigned int threads : { 2u, 3u, 7u })
+		{
+			ThreadPool pool(threads);
+			TerrainGL pooled(255, 255, kWorldSize, kWorldSize);
+			pooled.analyticNormals = analytic != 0;
+			pooled.SeparableInterpolation(base.get());
+			pooled.ApplyNoise(pool);
+
+			const bool same = pooled.IsBitIdentical(serial);
+			std::cout << "  ApplyNoise on " << threads << " threads" << (analytic ? " with slopes: " : ": ")
+				<< (same ? "bit-identical" : "MISMATCH") << std::endl;
+			passed = Expect(same, "the noise to be the same bits on any number of threads") && passed;
+		}
+	}
+	return passed;
+}
+
+/*
+One axis of a piecewise grid over a row of hashed heights, at every boundary between patches: the patch on the
+left at its t = 1 end has to land on exactly the height the patch on the right starts from, the shorter last
+patch included. Also that every sample reads inside the grid, and that the shorter patch's slopes agree with
+its heights
+*/
+template<int Degree>
+static bool
+CheckPatchEdgesOf(size_t segments)
+{
+	typedef utilAyre::PatchSampleOf<Degree> Sample;
+
+	std::vector<float> heights(segments + 1);
+	for (size_t i = 0; i < heights.size(); ++i)
+	{
+		heights[i] = (float)(((uint32_t)i * 2654435761u) >> 24);
+	}
+	auto evaluate = [&](const Sample& sample)
+	{
+		return utilAyre::BernsteinFilterOf<Degree>(&heights[sample.offset], 1, utilAyre::PatchSampleWeights(sample));
+	};
+
+	size_t seams = 0;
+	for (size_t boundary = Degree; boundary < segments; boundary += Degree)
+	{
+		Sample left = utilAyre::LocatePatchSample<Degree>(segments, (float)boundary - 0.5f);
+		left.t = 1.0f;
+		if (evaluate(left) != evaluate(utilAyre::LocatePatchSample<Degree>(segments, (float)boundary)))
+			seams++;
+	}
+
+	size_t outside = 0;
+	for (size_t samples : { segments, segments * 4 + 1, segments * 7 })
+	{
+		const utilAyre::BernsteinTableOf<Degree> table = utilAyre::BuildBernsteinTableOf<Degree>(segments, samples);
+		for (int offset : table.offsets)
+		{
+			if (offset < 0 || offset + Degree > (int)segments)
+				outside++;
+		}
+	}
+
+	//central difference over the shorter patch, against the slope weights at a per-segment scale
+	float worstSlope = 0;
+	const float h = 1.0f / 64;
+	for (float X = (float)(segments - segments % Degree) + h; X < (float)segments - h; X += 0.125f)
+	{
+		const Sample sample = utilAyre::LocatePatchSample<Degree>(segments, X);
+		float slope = utilAyre::BernsteinFilterOf<Degree>(&heights[sample.offset], 1, utilAyre::PatchSampleSlopes(sample)) / Degree;
+		float difference = (evaluate(utilAyre::LocatePatchSample<Degree>(segments, X + h)) -
+			evaluate(utilAyre::LocatePatchSample<Degree>(segments, X - h))) / (2 * h);
+		worstSlope = std::max(worstSlope, std::abs(slope - difference));
+	}
+
+	std::cout << "  degree " << Degree << " over " << segments << " segments: " << seams << " seams, " << outside
+		<< " samples outside the grid, worst slope error " << worstSlope << std::endl;
+	return Expect(seams == 0, "every patch to start on the height the last one ended on") &&
+		Expect(outside == 0, "every sample to read inside the grid") &&
+		Expect(worstSlope < 0.5f, "the shorter patch's slopes to match its heights");
+}
+
+static bool
+CheckPatchEdges()
+{
+	bool passed = true;
+	for (size_t segments : { 3, 4, 5, 255, 256, 257 })
+	{
+		passed = CheckPatchEdgesOf<2>(segments) && passed;
+		passed = CheckPatchEdgesOf<3>(segments) && passed;
+	}
+	return passed;
+}
+
+/*
+PieceWiseInterpolation on a source that's a multiple of 3 segments along neither side, against each vertex
+worked out here from scratch: whole cubic patches from the start, then whatever is left over as one patch of
+that lower degree. An edge patch that read past the end of a row would pick up the next row's heights
+*/
+static bool
+CheckPieceWiseEdges()
+{
+	const int segmentsX = 64, segmentsZ = 62;
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(segmentsX, segmentsZ);
+	TerrainGL terrain(255, 255, kWorldSize, kWorldSize);
+	terrain.PieceWiseInterpolation(base.get());
+
+	auto locate = [](float X, int segments, int& start, int& degree, float& t)
+	{
+		start = (int)X / 3 * 3;
+		degree = std::min(3, segments - start);
+		t = (X - start) / degree;
+	};
+
+	float worst = 0;
+	for (size_t z = 0; z < (size_t)terrain.verts_z; ++z)
+	{
+		for (size_t x = 0; x < terrain.verts_x; ++x)
+		{
+			const Vertex& vertex = terrain.terrain_data[x + z * terrain.verts_x];
+			int startX, degreeX, startZ, degreeZ;
+			float u, v;
+			locate(vertex.globalUV.x * segmentsX, segmentsX, startX, degreeX, u);
+			locate(vertex.globalUV.y * segmentsZ, segmentsZ, startZ, degreeZ, v);
+
+			float height = 0;
+			for (int j = 0; j <= degreeZ; ++j)
+			{
+				for (int i = 0; i <= degreeX; ++i)
+				{
+					height += base->terrain_data[(startX + i) + (startZ + j) * base->verts_x].p.y *
+						utilAyre::BernsteinWeight(degreeX, i, u) * utilAyre::BernsteinWeight(degreeZ, j, v);
+				}
+			}
+			worst = std::max(worst, std::abs(height - vertex.p.y));
+		}
+	}
+
+	std::cout << "  " << segmentsX << "x" << segmentsZ << " segments to 255x255: worst height error " << worst << std::endl;
+	return Expect(worst < 0.01f, "the edge patches to be the lower degree patches over the last control points");
+}
+
+/*
+The separable passes share their edge rule with PieceWiseInterpolation through the Bernstein tables, so the
+two have to agree bit for bit on sources that aren't whole patches as well as ones that are. So does a region
+of the separable pass over the far corner, where both the shorter patches meet
+*/
+static bool
+CheckSeparableMatchesPieceWise()
+{
+	bool passed = true;
+	const int sizes[][3] = { { 63, 63, 255 }, { 64, 62, 255 }, { 127, 128, 511 } };
+	for (const int* size : sizes)
+	{
+		std::unique_ptr<TerrainGL> base = MakeBaseTerrain(size[0], size[1]);
+		TerrainGL piecewise(size[2], size[2], kWorldSize, kWorldSize);
+		piecewise.PieceWiseInterpolation(base.get());
+		TerrainGL separable(size[2], size[2], kWorldSize, kWorldSize);
+		separable.SeparableInterpolation(base.get());
+
+		//start from the flat grid again and only fill the corner in
+		TerrainGL region(size[2], size[2], kWorldSize, kWorldSize);
+		TerrainRegion corner;
+		corner.firstX = region.verts_x - 40;
+		corner.firstZ = (size_t)region.verts_z - 40;
+		corner.endX = region.verts_x;
+		corner.endZ = (size_t)region.verts_z;
+		region.SeparableInterpolationRegion(base.get(), corner);
+
+		size_t cornerMismatches = 0;
+		for (size_t z = corner.firstZ; z < corner.endZ; ++z)
+		{
+			for (size_t x = corner.firstX; x < corner.endX; ++x)
+			{
+				if (region.terrain_data[x + z * region.verts_x].p.y != separable.terrain_data[x + z * separable.verts_x].p.y)
+					cornerMismatches++;
+			}
+		}
+
+		const bool same = separable.IsBitIdentical(piecewise);
+		std::cout << "  " << size[0] << "x" << size[1] << " segments to " << size[2] << "x" << size[2] << ": "
+			<< (same ? "bit-identical" : "MISMATCH") << ", " << cornerMismatches << " corner region mismatches" << std::endl;
+		passed = Expect(same, "the separable build to match PieceWiseInterpolation bit for bit") &&
+			Expect(cornerMismatches == 0, "the region pass to match the full separable pass") && passed;
+	}
+	return passed;
+}
+
+/*
+CalculateGridNormals against the area-weighted CalculateNormals on the same heights, smooth and with the
+noise on, square and not. The doc on GridNormal quotes these numbers
+*/
+static bool
+CheckNormalDeviation()
+{
+	const int sizes[3][4] = { { 63, 63, 255, 255 }, { 63, 63, 1023, 1023 }, { 40, 70, 300, 200 } };
+	bool passed = true;
+	for (const auto& size : sizes)
+	{
+		std::unique_ptr<TerrainGL> base = MakeBaseTerrain(size[0], size[1]);
+		for (int noise = 0; noise < 2; ++noise)
+		{
+			TerrainGL weighted(size[2], size[3], kWorldSize, kWorldSize);
+			weighted.SeparableInterpolation(base.get());
+			if (noise)
+				weighted.ApplyNoise();
+
+			TerrainGL grid = weighted;
+			weighted.CalculateNormals();
+			grid.CalculateGridNormals();
+
+			const float worst = weighted.MaxNormalDeviationDegrees(grid);
+			std::cout << "  " << size[0] << "x" << size[1] << " at " << size[2] << "x" << size[3] << (noise ? " with noise" : " smooth")
+				<< ": worst " << worst << " degrees" << std::endl;
+			passed = Expect(worst <= kGridNormalToleranceDegrees, "grid normals within kGridNormalToleranceDegrees") && passed;
+		}
+	}
+	return passed;
+}
+
+/*
+FusedBuild against the multi-pass build it replaces, analytic normals and all, on targets that leave part-filled
+tiles along the far edges and a source that isn't whole patches. Both run on a pool with more than one thread
+*/
+static bool
+CheckFusedBuild()
+{
+	bool passed = true;
+	const int sizes[][4] = { { 63, 63, 299, 189 }, { 64, 62, 129, 129 } };
+	ThreadPool pool(3);
+	for (const auto& size : sizes)
+	{
+		std::unique_ptr<TerrainGL> base = MakeBaseTerrain(size[0], size[1]);
+		TerrainGL multiPass(size[2], size[3], kWorldSize, kWorldSize);
+		multiPass.analyticNormals = true;
+		multiPass.SeparableInterpolation(base.get(), pool);
+		multiPass.ApplyNoise(pool);
+
+		TerrainGL fused;
+		fused.FusedBuild(base.get(), size[2], size[3], kWorldSize, kWorldSize, pool);
+
+		const bool identical = fused.IsBitIdentical(multiPass);
+		std::cout << "  " << size[2] << "x" << size[3] << " from " << size[0] << "x" << size[1] << ": "
+			<< (identical ? "bit-identical" : "MISMATCH") << std::endl;
+		passed = Expect(identical, "the fused build to give the multi-pass build's bits") && passed;
+		passed = Expect(fused.analyticNormals, "the fused build to leave analyticNormals set") && passed;
+	}
+	return passed;
+}
+
+/*
+Regenerate after a brush in the middle, a brush over the corner and a region write running off the far edge,
+with the normals from the grid pass and from the analytic derivatives. Each has to give the bits of a fresh
+build from the edited base, only change vertices inside the region it hands back, and hand back less than
+the whole grid
+*/
+static bool
+CheckEditorRegenerate()
+{
+	bool passed = true;
+	for (int analytic = 0; analytic < 2; ++analytic)
+	{
+		std::unique_ptr<TerrainGL> base = MakeBaseTerrain(63, 63);
+		auto build = [&]()
+		{
+			std::unique_ptr<TerrainGL> terrain(new TerrainGL(255, 255, kWorldSize, kWorldSize));
+			terrain->analyticNormals = analytic != 0;
+			terrain->SeparableInterpolation(base.get());
+			terrain->ApplyNoise();
+			if (!analytic)
+				terrain->CalculateGridNormals();
+			return terrain;
+		};
+
+		std::unique_ptr<TerrainGL> hiRes = build();
+		TerrainEditor editor(*base, *hiRes);
+		const std::vector<float> plateau(10 * 8, 150.0f);
+		const glm::vec3 middle = base->terrain_data[32 * base->verts_x + 30].p;
+		const glm::vec3 corner = base->terrain_data[0].p;
+
+		for (int edit = 0; edit < 3; ++edit)
+		{
+			const char* names[3] = { "middle brush", "corner brush", "edge region" };
+			if (edit == 0)
+				editor.StampBrush(middle.x, middle.z, 150.0f, 40.0f);
+			else if (edit == 1)
+				editor.StampBrush(corner.x, corner.z, 200.0f, -30.0f);
+			else
+				editor.ReplaceRegion(base->verts_x - 4, 20, 10, 8, plateau.data());
+
+			const std::vector<Vertex> before = hiRes->terrain_data;
+			const TerrainRegion region = editor.Regenerate();
+			std::unique_ptr<TerrainGL> fresh = build();
+
+			size_t outside = 0;
+			for (size_t z = 0; z < (size_t)hiRes->verts_z; ++z)
+			{
+				for (size_t x = 0; x < hiRes->verts_x; ++x)
+				{
+					const bool inside = x >= region.firstX && x < region.endX && z >= region.firstZ && z < region.endZ;
+					const size_t i = z * hiRes->verts_x + x;
+					if (!inside && std::memcmp(&before[i], &hiRes->terrain_data[i], sizeof(Vertex)) != 0)
+						outside++;
+				}
+			}
+
+			const size_t area = (region.endX - region.firstX) * (region.endZ - region.firstZ);
+			std::cout << "  " << names[edit] << (analytic ? ", analytic normals" : ", grid normals") << ": region "
+				<< region.endX - region.firstX << "x" << region.endZ - region.firstZ << " from (" << region.firstX << ", "
+				<< region.firstZ << "), " << editor.LastRegenerateMilliseconds() << " ms" << std::endl;
+			passed = Expect(hiRes->IsBitIdentical(*fresh), "Regenerate to give a fresh build's bits") && passed;
+			passed = Expect(outside == 0, "nothing outside the region handed back to change") && passed;
+			passed = Expect(!region.Empty() && area < hiRes->terrain_data.size() && region.endX <= hiRes->verts_x &&
+				region.endZ <= (size_t)hiRes->verts_z, "a region inside the grid and smaller than it") && passed;
+		}
+	}
+	return passed;
+}
+
+/*
+Every vertex of a finished terrain, hills, noise and analytic normals, packed and unpacked again against the
+error bounds MyPackedTerrain.hpp gives. The height bound is half a quantisation step plus a few ulp of the
+heights themselves for the float maths either side
+*/
+static bool
+CheckPackedRoundTrip()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(64, 62);
+	TerrainGL terrain(255, 255, kWorldSize, kWorldSize);
+	terrain.analyticNormals = true;
+	terrain.SeparableInterpolation(base.get());
+	terrain.ApplyNoise();
+
+	const PackedTerrain packed = PackTerrain(terrain.terrain_data.data(), terrain.terrain_data.size(), terrain.verts_x);
+	const float rounding = 4 * std::numeric_limits<float>::epsilon() * (std::abs(packed.heightBias) + packed.heightScale);
+	const float heightBound = kPackedHeightMaxError * packed.heightScale + rounding;
+
+	float worstHeight = 0, worstNormal = 0;
+	for (size_t i = 0; i < packed.vertices.size(); ++i)
+	{
+		const Vertex& vertex = terrain.terrain_data[i];
+		const PackedVertex& packedVertex = packed.vertices[i];
+
+		float height = DequantizeHeight(packedVertex.height, packed.heightScale, packed.heightBias);
+		worstHeight = std::max(worstHeight, std::abs(height - vertex.p.y));
+
+		glm::vec3 a = glm::normalize(vertex.n);
+		glm::vec3 b = DecodeOctahedral(packedVertex.octahedral);
+		worstNormal = std::max(worstNormal, std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)) * 57.2957795f);
+	}
+
+	std::cout << "  " << packed.vertices.size() << " vertices over " << packed.heightScale << " units of height: worst height error "
+		<< worstHeight << " (bound " << heightBound << "), worst normal error " << worstNormal << " degrees (bound "
+		<< kPackedNormalMaxErrorDegrees << ")" << std::endl;
+	return Expect(worstHeight <= heightBound, "every height within the packed height bound") &&
+		Expect(worstNormal <= kPackedNormalMaxErrorDegrees, "every normal within the packed normal bound");
+}
+
+/*
+The lazy terrain against the full build it stands in for, with grid and analytic normals. Tiles that don't
+divide the grid leave part tiles along the far edges, and the cache only holds a few of them, so tiles get
+evicted and evaluated again on the way through
+*/
+static bool
+CheckLazyTerrain()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(63, 63);
+	bool passed = true;
+	for (int analytic = 0; analytic < 2; ++analytic)
+	{
+		TerrainGL reference(255, 255, kWorldSize, kWorldSize);
+		reference.analyticNormals = analytic != 0;
+		reference.SeparableInterpolation(base.get());
+		reference.ApplyNoise();
+		if (!analytic)
+			reference.CalculateGridNormals();
+
+		LazyTerrainSettings settings;
+		settings.targetSizeX = settings.targetSizeZ = 255;
+		settings.worldSizeX = settings.worldSizeZ = kWorldSize;
+		settings.tileSize = 48;
+		settings.cacheBytes = 256 * 1024;
+		settings.analyticNormals = analytic != 0;
+		LazyTerrain lazy(*base, settings);
+
+		passed = Expect(ReportLazyTerrain(lazy, reference, std::cout), "the lazy terrain to be the full build's bits") && passed;
+		passed = Expect(lazy.Stats().evictions > 0, "the small cache to have evicted tiles") && passed;
+	}
+	return passed;
+}
+
+/*
+A small 16-bit raw map that isn't square, taller than one of ApplyHeightMap's bands, read through the mapped
+source into a mesh of the same shape. Every height has to be the 16-bit value scaled into 0-255, rows in the
+right order. OpenHeightmapSource can't tell the size of a raw file that isn't square, so it has to refuse it,
+and a mesh of the wrong shape has to refuse the map. The file goes in the working directory
+*/
+static bool
+CheckRawHeightmap()
+{
+	const size_t width = 37, height = 70;
+	const char* path = "heightmap_check.r16";
+	std::vector<uint16_t> values(width * height);
+	for (size_t i = 0; i < values.size(); ++i)
+		values[i] = (uint16_t)(i * 977 % 65536);
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write((const char*)values.data(), (std::streamsize)(values.size() * sizeof(uint16_t)));
+		if (!Expect((bool)file, "the raw heightmap to be written"))
+			return false;
+	}
+
+	MappedRawHeightmapSource source(path, width, height, RawHeightFormat::R16);
+	if (!Expect(source.IsOpen(), "the raw heightmap to map"))
+		return false;
+
+	TerrainGL terrain((int)width - 1, (int)height - 1, kWorldSize, kWorldSize);
+	const bool applied = terrain.ApplyHeightMap(source);
+
+	size_t wrong = 0;
+	for (size_t i = 0; i < values.size() && applied; ++i)
+	{
+		wrong += terrain.terrain_data[i].p.y != values[i] * (255.0f / 65535.0f);
+	}
+
+	TerrainGL transposed((int)height - 1, (int)width - 1, kWorldSize, kWorldSize);
+	std::cout << "  " << width << "x" << height << " .r16: " << wrong << " heights wrong" << std::endl;
+	return Expect(applied && wrong == 0, "every height read back in place") &&
+		Expect(!transposed.ApplyHeightMap(source), "a mesh of the wrong shape to refuse the map") &&
+		Expect(OpenHeightmapSource(path) == nullptr, "OpenHeightmapSource to refuse a raw map that isn't square");
+}
+
+/*
+The out-of-core build from a raw float heightmap, through the same OpenHeightmapSource the terrain_tiles tool
+uses, with tiles small enough that there are 16 of them. Every tile read back has to have exactly the heights
+and grid normals a single in-memory build gives, seams included. Files go in the working directory
+*/
+static bool
+CheckTiledBuild()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(64, 64);
+	const char* sourcePath = "tiled_check_source.r32";
+	{
+		std::ofstream file(sourcePath, std::ios::binary);
+		for (const Vertex& v : base->terrain_data)
+			file.write((const char*)&v.p.y, sizeof(float));
+		if (!Expect((bool)file, "the raw heightmap to be written"))
+			return false;
+	}
+
+	std::unique_ptr<HeightmapSource> source = OpenHeightmapSource(sourcePath);
+	if (!Expect(source != nullptr, "the raw heightmap to open"))
+		return false;
+
+	TiledBuildSettings settings;
+	settings.targetSizeX = settings.targetSizeZ = 255;
+	settings.worldSizeX = settings.worldSizeZ = kWorldSize;
+	settings.tileSize = 64;
+	TiledBuildResult result;
+	TiledTerrainBuilder builder(*source, settings);
+	if (!Expect(builder.Build(result), "the tiled build to succeed"))
+		return false;
+
+	TerrainGL single(255, 255, kWorldSize, kWorldSize);
+	single.SeparableInterpolation(base.get());
+	single.ApplyNoise();
+	single.CalculateGridNormals();
+
+	size_t heightsDiffering = 0, normalsDiffering = 0;
+	size_t tilesRead = 0, verticesRead = 0;
+	for (size_t tz = 0; tz < 4; ++tz)
+	{
+		for (size_t tx = 0; tx < 4; ++tx)
+		{
+			std::ifstream file(TiledTerrainBuilder::TilePath(".", tx, tz), std::ios::binary);
+			TerrainTileHeader header;
+			if (!file.read((char*)&header, sizeof(header)))
+				continue;
+
+			std::vector<Vertex> tile((size_t)header.vertsX * header.vertsZ);
+			if (!file.read((char*)tile.data(), (std::streamsize)(tile.size() * sizeof(Vertex))))
+				continue;
+
+			for (size_t j = 0; j < header.vertsZ; ++j)
+			{
+				for (size_t i = 0; i < header.vertsX; ++i)
+				{
+					const Vertex& reference = single.terrain_data[(header.firstVertexX + i) + (header.firstVertexZ + j) * single.verts_x];
+					const Vertex& read = tile[i + j * header.vertsX];
+					heightsDiffering += read.p.y != reference.p.y;
+					normalsDiffering += read.n != reference.n;
+				}
+			}
+			tilesRead++;
+			verticesRead += tile.size();
+		}
+	}
+
+	std::cout << "  " << result.tilesWritten << " tiles written, " << tilesRead << " read back with " << verticesRead
+		<< " vertices, " << heightsDiffering << " heights and " << normalsDiffering << " normals differing from the single build" << std::endl;
+	return Expect(result.tilesWritten == 16 && tilesRead == 16, "16 tiles written and read back") &&
+		Expect(verticesRead == 65 * 65 * 9 + 65 * 64 * 6 + 64 * 64, "the tiles to share their edge vertices") &&
+		Expect(heightsDiffering == 0, "the tiles to have the single build's heights") &&
+		Expect(normalsDiffering == 0, "the tiles to have the single build's normals");
+}
+
+/*
+Chunks over grids wide enough that the requested chunk size has to shrink to keep 16-bit indices: every quad
+has to come out exactly once, with every index plus its chunk's base vertex inside the grid and under 65536
+from the base. Rows too wide for even a one-quad chunk get no chunks rather than indices that wrap
+*/
+static bool
+CheckChunkIndices()
+{
+	bool passed = true;
+	const size_t widths[] = { 257, 4097, 21846, 32768 };
+	for (size_t vertsX : widths)
+	{
+		const size_t vertsZ = 5;
+		std::vector<Vertex> vertices(vertsX * vertsZ, Vertex());
+		TerrainChunks terrain = BuildTerrainChunks(vertices.data(), vertsX, vertsZ, kTerrainChunkQuads);
+
+		size_t quads = 0;
+		bool inside = true;
+		for (const TerrainChunk& chunk : terrain.chunks)
+		{
+			//a wrapped index wouldn't be a quad's corner any more
+			for (size_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i += 6)
+			{
+				const size_t v00 = terrain.indices[i];
+				inside = inside && (size_t)chunk.baseVertex + terrain.indices[i + 2] < vertsX * vertsZ &&
+					terrain.indices[i + 1] == v00 + 1 && terrain.indices[i + 2] == v00 + vertsX + 1 &&
+					terrain.indices[i + 5] == v00 + vertsX;
+			}
+			quads += chunk.indexCount / 6;
+		}
+
+		std::cout << "  " << vertsX << " wide: " << terrain.chunks.size() << " chunks of " << terrain.chunkQuads << " quads, "
+			<< quads << " quads" << std::endl;
+		passed = Expect(terrain.chunkQuads >= 1, "chunks at least one quad across") && passed;
+		passed = Expect(quads == (vertsX - 1) * (vertsZ - 1), "every quad in exactly one chunk") && passed;
+		passed = Expect(inside, "every quad's indices to land on its corners inside the grid") && passed;
+	}
+
+	std::vector<Vertex> wide(32769 * 2, Vertex());
+	TerrainChunks tooWide = BuildTerrainChunks(wide.data(), 32769, 2, kTerrainChunkQuads);
+	return Expect(tooWide.chunks.empty() && tooWide.indices.empty(), "no chunks for rows over 32768 vertices") && passed;
+}
+
+/*
+Triangles as (x, z) grid quads: every quad has to be covered exactly once by two triangles that between them
+use all four corners, each wound the same way as reference. Returns the number of triangles that weren't
+*/
+static size_t
+CountBadQuads(const std::vector<uint32_t>& triangles, size_t vertsX, size_t vertsZ, float reference)
+{
+	std::vector<uint8_t> corners((vertsX - 1) * (vertsZ - 1), 0);
+	std::vector<uint8_t> count(corners.size(), 0);
+	size_t bad = 0;
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+	{
+		long x[3], z[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			x[k] = (long)(triangles[i + k] % vertsX);
+			z[k] = (long)(triangles[i + k] / vertsX);
+		}
+		const long minX = std::min(x[0], std::min(x[1], x[2])), minZ = std::min(z[0], std::min(z[1], z[2]));
+		const long maxX = std::max(x[0], std::max(x[1], x[2])), maxZ = std::max(z[0], std::max(z[1], z[2]));
+		const float area = (float)((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0]));
+		if (maxX - minX != 1 || maxZ - minZ != 1 || (size_t)maxZ >= vertsZ || area * reference <= 0)
+		{
+			bad++;
+			continue;
+		}
+
+		const size_t quad = minZ * (vertsX - 1) + minX;
+		count[quad]++;
+		for (int k = 0; k < 3; ++k)
+			corners[quad] |= (uint8_t)(1 << ((z[k] - minZ) * 2 + (x[k] - minX)));
+	}
+
+	for (size_t quad = 0; quad < corners.size(); ++quad)
+	{
+		if (count[quad] != 2 || corners[quad] != 0xF)
+			bad++;
+	}
+	return bad;
+}
+
+/*
+The strip and 16-bit chunk orderings against MakeMesh's list: the same quads, each once, wound the same way,
+over grids that need one band and several, and the widest one 16-bit indices can still band. The FIFO
+simulation is checked by hand on sequences where a hit refreshing its entry would change the count
+*/
+static bool
+CheckIndexOrderings()
+{
+	TerrainGL reference(6, 4, kWorldSize, kWorldSize);
+	const std::vector<int>& list = reference.terrain_elements;
+	const float winding = (float)((list[1] % 7 - list[0] % 7) * (list[2] / 7 - list[0] / 7) -
+		(list[2] % 7 - list[0] % 7) * (list[1] / 7 - list[0] / 7));
+	bool passed = Expect(CountBadQuads(std::vector<uint32_t>(list.begin(), list.end()), 7, 5, winding) == 0,
+		"MakeMesh to cover every quad once, all wound the same way");
+
+	const size_t sizes[3][2] = { { 7, 5 }, { 300, 260 }, { 32768, 3 } };
+	for (const auto& size : sizes)
+	{
+		const size_t vertsX = size[0], vertsZ = size[1];
+		const size_t triangles = (vertsX - 1) * (vertsZ - 1) * 2;
+
+		//strips alternate winding every triangle, so the odd ones swap their first two to be read as GL draws them
+		std::vector<uint32_t> strips = BuildTriangleStrips(vertsX, vertsZ);
+		std::vector<uint32_t> stripTriangles;
+		size_t start = 0;
+		for (size_t i = 0; i <= strips.size(); ++i)
+		{
+			if (i < strips.size() && strips[i] != kStripRestartIndex)
+				continue;
+			for (size_t t = start; t + 2 < i; ++t)
+			{
+				const bool odd = (t - start) & 1;
+				stripTriangles.push_back(strips[odd ? t + 1 : t]);
+				stripTriangles.push_back(strips[odd ? t : t + 1]);
+				stripTriangles.push_back(strips[t + 2]);
+			}
+			start = i + 1;
+		}
+
+		ChunkedIndices16 chunked = BuildChunkedIndices16(vertsX, vertsZ, kDefaultStripeWidth);
+		std::vector<uint32_t> expanded = ExpandChunks(chunked);
+
+		VertexCacheStats stripStats = SimulateFifoCache(strips, true, 16);
+		VertexCacheStats chunkStats = SimulateFifoCache(expanded, false, 16);
+		std::cout << "  " << vertsX << "x" << vertsZ << ": " << chunked.chunks.size() << " chunks, fifo16 ACMR strips "
+			<< stripStats.acmr << ", chunks " << chunkStats.acmr << std::endl;
+
+		passed = Expect(CountBadQuads(stripTriangles, vertsX, vertsZ, winding) == 0, "strips to cover every quad once, wound like MakeMesh") && passed;
+		passed = Expect(CountBadQuads(expanded, vertsX, vertsZ, winding) == 0, "16-bit chunks to cover every quad once, wound like MakeMesh") && passed;
+		passed = Expect(stripStats.triangles == triangles && chunkStats.triangles == triangles, "the cache simulation to count every triangle") && passed;
+		passed = Expect(stripStats.uniqueVertices == vertsX * vertsZ && chunkStats.uniqueVertices == vertsX * vertsZ,
+			"the cache simulation to see every vertex") && passed;
+	}
+
+	//0 hits without moving, so a FIFO of 3 has pushed it out by the third triangle where LRU would still have it
+	const std::vector<uint32_t> fifo = { 0, 1, 2, 0, 3, 4, 0, 3, 4 };
+	VertexCacheStats fifoStats = SimulateFifoCache(fifo, false, 3);
+	passed = Expect(fifoStats.misses == 6 && fifoStats.triangles == 3 && fifoStats.uniqueVertices == 5, "FIFO misses to ignore hits") && passed;
+
+	const std::vector<uint32_t> strip = { 0, 1, 2, 3, kStripRestartIndex, 4, 5, 6 };
+	VertexCacheStats stripStats = SimulateFifoCache(strip, true, 16);
+	passed = Expect(stripStats.triangles == 3 && stripStats.misses == 7 && stripStats.acmr == 7.0 / 3 && stripStats.atvr == 1.0,
+		"strip triangles to restart at the restart index") && passed;
+
+	const ChunkedIndices16 tooWide = BuildChunkedIndices16(32769, 2, kDefaultStripeWidth);
+	const ChunkedIndices16 widest = BuildChunkedIndices16(65536, 2, kDefaultStripeWidth);
+	return Expect(tooWide.chunks.empty() && widest.chunks.empty(), "no 16-bit chunks for rows over 32768 vertices") && passed;
+}
+
+/*
+The LOD mesh a selection draws, vertex for vertex the way terrain_lod_vs.glsl builds it (each vertex morphed
+by its own distance, heights read back bilinearly), with the height of every point under one of its
+triangles written into drawn. Points are in grid coordinates
+*/
+static void
+RasteriseLodSelection(const TerrainGL& terrain, const TerrainLodTree& tree, const LodSelection& selection, const glm::vec3& camera,
+	const std::vector<glm::vec2>& points, std::vector<float>& drawn)
+{
+	const size_t vertsX = terrain.verts_x, vertsZ = (size_t)terrain.verts_z;
+	const glm::vec2 last((float)(vertsX - 1), (float)(vertsZ - 1));
+	const glm::vec2 spacing(kWorldSize / (float)vertsX, kWorldSize / terrain.verts_z);
+	auto height = [&](glm::vec2 grid)
+	{
+		const size_t x = std::min((size_t)grid.x, vertsX - 2), z = std::min((size_t)grid.y, vertsZ - 2);
+		const float fx = grid.x - x, fz = grid.y - z;
+		const Vertex* row = &terrain.terrain_data[z * vertsX + x];
+		return (row[0].p.y * (1 - fx) + row[1].p.y * fx) * (1 - fz) + (row[vertsX].p.y * (1 - fx) + row[vertsX + 1].p.y * fx) * fz;
+	};
+	auto vertex = [&](const LodNode& node, int localX, int localZ)
+	{
+		const float stride = (float)(1 << node.level);
+		glm::vec2 grid(std::min(node.x + localX * stride, last.x), std::min(node.z + localZ * stride, last.y));
+		const float distance = glm::length(glm::vec3(grid.x * spacing.x, height(grid), -grid.y * spacing.y) - camera);
+		const float start = selection.morphStart[node.level], end = selection.morphEnd[node.level];
+		const float morph = std::min(std::max((distance - start) / (end - start), 0.0f), 1.0f);
+		grid = glm::vec2(std::min(node.x + (localX - (localX & 1) * morph) * stride, last.x),
+			std::min(node.z + (localZ - (localZ & 1) * morph) * stride, last.y));
+		return glm::vec3(grid.x, height(grid), grid.y);
+	};
+	auto triangle = [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		const float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+		if (std::abs(area) < 1e-12f)
+			return;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			const glm::vec2& p = points[i];
+			const float wb = ((p.x - a.x) * (c.z - a.z) - (c.x - a.x) * (p.y - a.z)) / area;
+			const float wc = ((b.x - a.x) * (p.y - a.z) - (p.x - a.x) * (b.z - a.z)) / area;
+			if (wb >= 0 && wc >= 0 && wb + wc <= 1)
+				drawn[i] = a.y * (1 - wb - wc) + b.y * wb + c.y * wc;
+		}
+	};
+
+	const int half = tree.LeafQuads() / 2;
+	for (const LodNode& node : selection.nodes)
+	{
+		for (int q = 0; q < 4; ++q)
+		{
+			if (!(node.quadrants & (1 << q)))
+				continue;
+			for (int z = (q >> 1) * half; z < (q >> 1) * half + half; ++z)
+			{
+				for (int x = (q & 1) * half; x < (q & 1) * half + half; ++x)
+				{
+					const glm::vec3 v00 = vertex(node, x, z), v10 = vertex(node, x + 1, z);
+					const glm::vec3 v01 = vertex(node, x, z + 1), v11 = vertex(node, x + 1, z + 1);
+					triangle(v00, v10, v11);
+					triangle(v00, v11, v01);
+				}
+			}
+		}
+	}
+}
+
+/*
+Shapes are placed with DrawnHeightBatch while CDLOD is drawn, so it has to give the heights of the LOD mesh
+itself and not the full grid's. Against the mesh rebuilt the shader's way from a few cameras, with the pixel
+error turned up so the coarse levels and their morph bands cover most of the terrain. The two work the
+triangle out in a different order, hence the tolerance
+*/
+static bool
+CheckDrawnHeights()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(64, 64);
+	TerrainGL terrain(256, 256, kWorldSize, kWorldSize);
+	terrain.SeparableInterpolation(base.get());
+	terrain.ApplyNoise();
+
+	LodSettings settings;
+	settings.pixelError = 4.0f;
+	TerrainLodTree tree;
+	TerrainHeightQuery query;
+	if (!Expect(tree.Build(terrain.terrain_data.data(), terrain.verts_x, (size_t)terrain.verts_z, kWorldSize, kWorldSize, settings) &&
+		query.Build(terrain.terrain_data.data(), terrain.verts_x, (size_t)terrain.verts_z, kWorldSize, kWorldSize), "the LOD tree and query to build"))
+		return false;
+
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float last = (float)(terrain.verts_x - 1);
+	std::vector<glm::vec2> points(2000);
+	std::vector<float> xs(points.size()), zs(points.size()), heights(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		points[i] = glm::vec2(unit(random) * last, unit(random) * last);
+		xs[i] = points[i].x * kWorldSize / terrain.verts_x;
+		zs[i] = -points[i].y * kWorldSize / terrain.verts_z;
+	}
+
+	bool passed = true;
+	const float cameraHeights[] = { 150.0f, 400.0f, 1200.0f };
+	for (float cameraHeight : cameraHeights)
+	{
+		const LodCamera camera{ glm::vec3(300.0f, cameraHeight, -500.0f), 720.0f, 45.0f };
+		LodSelection selection;
+		tree.Select(camera, selection);
+
+		std::vector<float> drawn(points.size(), std::numeric_limits<float>::quiet_NaN());
+		RasteriseLodSelection(terrain, tree, selection, camera.position, points, drawn);
+		query.DrawnHeightBatch(tree, selection, camera.position, xs.data(), zs.data(), heights.data(), points.size());
+
+		float worstDrawn = 0, worstFull = 0;
+		size_t covered = 0;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			if (std::isnan(drawn[i]))
+				continue;
+			covered++;
+			worstDrawn = std::max(worstDrawn, std::abs(heights[i] - drawn[i]));
+			worstFull = std::max(worstFull, std::abs(query.Height(xs[i], zs[i]) - drawn[i]));
+		}
+
+		int coarsest = 0;
+		for (const LodNode& node : selection.nodes)
+			coarsest = std::max(coarsest, node.level);
+
+		std::cout << "  camera at height " << cameraHeight << ": " << selection.nodes.size() << " nodes up to level " << coarsest
+			<< ", " << covered << "/" << points.size() << " points under the mesh, worst height off it " << worstDrawn
+			<< " against " << worstFull << " for the full grid" << std::endl;
+		passed = Expect(covered == points.size(), "the LOD mesh to cover every point") && passed;
+		passed = Expect(coarsest > 0, "some of the terrain drawn at a coarser level") && passed;
+		passed = Expect(worstDrawn < 0.001f, "the batch to give the drawn mesh's heights") && passed;
+	}
+	return passed;
+}
+
+/*
+Rays and point queries over a finished terrain, the pyramid walk against testing every cell
+*/
+static bool
+CheckTerrainQueries()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(64, 64);
+	TerrainGL terrain(255, 255, kWorldSize, kWorldSize);
+	terrain.SeparableInterpolation(base.get());
+	terrain.ApplyNoise();
+
+	TerrainHeightQuery query;
+	if (!Expect(query.Build(terrain.terrain_data.data(), terrain.verts_x, (size_t)terrain.verts_z, kWorldSize, kWorldSize),
+		"the query to build"))
+		return false;
+	return Expect(ReportTerrainQueries(query, kWorldSize, kWorldSize, 20000, std::cout),
+		"every ray hit on the surface and the pyramid to hit what testing every cell does");
+}
+
+/*
+Tessellation levels over a base map's patches from cameras low over it to well above, with the pixels per
+segment turned down so the levels spread out and some hit the maximum. No edge can crack: both patches either
+side have to pick the same level, whichever corner they start from
+*/
+static bool
+CheckTessellationEdges()
+{
+	std::unique_ptr<TerrainGL> base = MakeBaseTerrain(63, 63);
+	TerrainTessellation tessellation;
+	if (!Expect(tessellation.Build(base->terrain_data.data(), base->verts_x, (size_t)base->verts_z, kWorldSize, kWorldSize),
+		"the patches to build"))
+		return false;
+
+	TessellationSettings settings;
+	settings.pixelsPerSegment = 2.0f;
+	std::vector<LodCamera> cameras;
+	const float heights[] = { 20.0f, 200.0f, 2000.0f };
+	for (float height : heights)
+	{
+		cameras.push_back(LodCamera{ glm::vec3(kWorldSize * 0.3f, height, -kWorldSize * 0.6f), 720.0f, 45.0f });
+	}
+	return Expect(ReportTessellation(tessellation, cameras, settings, 256, std::cout),
+		"every shared edge to get the same level from both patches, in either corner order");
+}
+
+/*
+A pager over an 8x8 chunk world of flat vertices with room for 8 chunks, and a camera on a chunk corner so it
+wants the 4 chunks around it. Parked at A, then B, then back at A and on to C, C's chunks have to take B's
+slots: B is the least recently used, A was touched again after it. Then a flight across the whole world on a
+budget it can't all fit in, through ReportTerrainPaging, has to recycle slots and stay inside the budget
+*/
+static bool
+CheckTerrainPaging()
+{
+	const size_t worldVerts = 129;
+	const int worldSize = 1290;
+	const float chunkWorld = 160.0f;
+	TerrainChunkSource source = [](const TerrainRegion& region, Vertex* out)
+	{
+		for (size_t z = region.firstZ; z < region.endZ; ++z)
+		{
+			for (size_t x = region.firstX; x < region.endX; ++x)
+			{
+				Vertex& v = *out++;
+				v = Vertex();
+				v.p = glm::vec3(x * 10.0f, 0.0f, -(z * 10.0f));
+			}
+		}
+	};
+
+	TerrainPagerSettings settings;
+	settings.chunkSegments = 16;
+	settings.loadRadius = 120.0f;
+	settings.budgetBytes = 8 * 17 * 17 * sizeof(Vertex);
+	TerrainPager pager(worldVerts, worldVerts, worldSize, worldSize, source, settings);
+
+	std::vector<TerrainChunkUpload> uploads;
+	bool withinBudget = true;
+	auto park = [&](const glm::vec3& camera)
+	{
+		for (int frame = 0; frame < 100; ++frame)
+		{
+			pager.Update(camera, uploads);
+			TerrainPagerStats stats = pager.Stats();
+			withinBudget = withinBudget && stats.residentBytes <= settings.budgetBytes;
+			if (stats.desiredChunks > 0 && stats.desiredResident == stats.desiredChunks)
+				return;
+			pager.WaitIdle();
+		}
+	};
+
+	const glm::vec3 a(chunkWorld, 100.0f, -chunkWorld), b(chunkWorld * 5, 100.0f, -chunkWorld), c(chunkWorld, 100.0f, -chunkWorld * 5);
+	park(a);
+	park(b);
+	park(a);
+	park(c);
+
+	std::vector<TerrainChunkDraw> draws;
+	pager.ResidentChunks(draws);
+	size_t fromA = 0, fromB = 0, fromC = 0;
+	for (const TerrainChunkDraw& draw : draws)
+	{
+		const int cx = (int)std::lround(draw.minCorner.x / chunkWorld), cz = (int)std::lround(-draw.maxCorner.z / chunkWorld);
+		fromA += cx < 2 && cz < 2;
+		fromB += cx >= 4 && cx < 6 && cz < 2;
+		fromC += cx < 2 && cz >= 4 && cz < 6;
+	}
+	const TerrainPagerStats stats = pager.Stats();
+	std::cout << "  " << pager.SlotCount() << " slots, " << draws.size() << " resident after A, B, A, C: " << fromA << " from A, "
+		<< fromB << " from B, " << fromC << " from C, " << stats.evicted << " evicted" << std::endl;
+
+	bool passed = Expect(pager.SlotCount() == 8, "the budget to make 8 slots");
+	passed = Expect(withinBudget, "residency never over the budget") && passed;
+	passed = Expect(fromA == 4 && fromC == 4 && fromB == 0 && stats.evicted == 4, "C to recycle the least recently used slots, B's") && passed;
+
+	//two seconds of frames in a diagonal line over the world, wanting up to 9 chunks at a time from 8 slots
+	TerrainPagerSettings flightSettings = settings;
+	flightSettings.loadRadius = 200.0f;
+	TerrainPager flight(worldVerts, worldVerts, worldSize, worldSize, source, flightSettings);
+	std::vector<glm::vec3> path;
+	for (int frame = 0; frame < 120; ++frame)
+	{
+		float t = frame / 120.0f;
+		path.push_back(glm::vec3(worldSize * (0.1f + 0.8f * t), 100.0f, -worldSize * (0.1f + 0.8f * t)));
+	}
+	passed = Expect(ReportTerrainPaging(flight, path, 5.0, std::cout), "the flight to stay inside the budget and upload cap") && passed;
+	return Expect(flight.Stats().evicted > 0, "the flight to recycle slots") && passed;
+}
+
+/*
+Every grid vertex against the adaptive mesh extracted from it: it has to be under one of the triangles, and no
+further from that triangle's plane than the limit. On grids that aren't 2^k + 1 square, where the RTIN square
+hangs off the far edges and gets clamped back
+*/
+static bool
+CheckAdaptiveErrorBound()
+{
+	bool passed = true;
+	const int sizes[][2] = { { 1023, 1023 }, { 200, 300 }, { 255, 255 } };
+	for (const int* size : sizes)
+	{
+		std::unique_ptr<TerrainGL> base = MakeBaseTerrain(64, 64);
+		TerrainGL terrain(size[0], size[1], kWorldSize, kWorldSize);
+		terrain.SeparableInterpolation(base.get());
+		terrain.ApplyNoise();
+
+		const size_t vertsX = terrain.verts_x, vertsZ = (size_t)terrain.verts_z;
+		AdaptiveTerrainMesher mesher;
+		mesher.Build(terrain.terrain_data.data(), vertsX, vertsZ);
+
+		const float limits[] = { 0.5f, 2.0f, 8.0f };
+		for (float limit : limits)
+		{
+			AdaptiveMesh mesh;
+			mesher.Extract(limit, mesh);
+
+			std::vector<bool> covered(vertsX * vertsZ, false);
+			float worst = 0;
+			for (size_t t = 0; t < mesh.indices.size(); t += 3)
+			{
+				long long x[3], z[3];
+				float h[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					x[k] = mesh.indices[t + k] % vertsX;
+					z[k] = mesh.indices[t + k] / vertsX;
+					h[k] = terrain.terrain_data[mesh.indices[t + k]].p.y;
+				}
+
+				const long long area = (x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0]);
+				for (long long vz = std::min(z[0], std::min(z[1], z[2])); vz <= std::max(z[0], std::max(z[1], z[2])); ++vz)
+				{
+					for (long long vx = std::min(x[0], std::min(x[1], x[2])); vx <= std::max(x[0], std::max(x[1], x[2])); ++vx)
+					{
+						//edge functions, signed like the area so inside is all the same sign as it
+						const long long w1 = (vx - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (vz - z[0]);
+						const long long w2 = (x[1] - x[0]) * (vz - z[0]) - (vx - x[0]) * (z[1] - z[0]);
+						const long long w0 = area - w1 - w2;
+						if ((area > 0 && (w0 < 0 || w1 < 0 || w2 < 0)) || (area < 0 && (w0 > 0 || w1 > 0 || w2 > 0)))
+							continue;
+
+						const float plane = (w0 * h[0] + w1 * h[1] + w2 * h[2]) / (float)area;
+						worst = std::max(worst, std::abs(plane - terrain.terrain_data[vz * vertsX + vx].p.y));
+						covered[vz * vertsX + vx] = true;
+					}
+				}
+			}
+
+			const size_t uncovered = std::count(covered.begin(), covered.end(), false);
+			std::cout << "  " << vertsX << "x" << vertsZ << " at limit " << limit << ": " << mesh.indices.size() / 3 << " triangles, worst error "
+				<< worst << ", " << uncovered << " vertices under no triangle" << std::endl;
+			passed = Expect(uncovered == 0, "every grid vertex under a triangle") && passed;
+			passed = Expect(worst <= limit * 1.0001f, "no grid vertex further off the mesh than the limit") && passed;
+		}
+	}
+	return passed;
+}
+
+struct TerrainCheck
+{
+	const char* name;
+	bool (*run)();
+};
+
+static const TerrainCheck kChecks[] =
+{
+	{ "thread_scaling", CheckThreadScaling },
+	{ "piecewise_allocations", CheckPieceWiseAllocations },
+	{ "bezier_degrees", CheckBezierDegrees },
+	{ "bezier_batch", CheckBezierBatch },
+	{ "noise_kernels", CheckNoiseKernels },
+	{ "patch_edges", CheckPatchEdges },
+	{ "piecewise_edges", CheckPieceWiseEdges },
+	{ "separable_matches_piecewise", CheckSeparableMatchesPieceWise },
+	{ "normal_deviation", CheckNormalDeviation },
+	{ "fused_build", CheckFusedBuild },
+	{ "editor_regenerate", CheckEditorRegenerate },
+	{ "packed_round_trip", CheckPackedRoundTrip },
+	{ "lazy_terrain", CheckLazyTerrain },
+	{ "raw_heightmap", CheckRawHeightmap },
+	{ "tiled_build", CheckTiledBuild },
+	{ "chunk_indices", CheckChunkIndices },
+	{ "index_orderings", CheckIndexOrderings },
+	{ "drawn_heights", CheckDrawnHeights },
+	{ "terrain_queries", CheckTerrainQueries },
+	{ "tessellation_edges", CheckTessellationEdges },
+	{ "terrain_paging", CheckTerrainPaging },
+	{ "adaptive_error_bound", CheckAdaptiveErrorBound },
+};
+
+int main(int argc, char *argv[])
+{
+	int failed = 0;
+	int ran = 0;
+	for (const TerrainCheck& check : kChecks)
+	{
+		bool wanted = argc < 2;
+		for (int i = 1; i < argc; ++i)
+		{
+			wanted = wanted || std::strcmp(argv[i], check.name) == 0;
+		}
+		if (!wanted)
+			continue;
+
+		std::cout << check.name << std::endl;
+		const bool passed = check.run();
+		std::cout << (passed ? "PASS " : "FAIL ") << check.name << std::endl;
+		failed += passed ? 0 : 1;
+		ran++;
+	}
+
+	if (ran == 0)
+	{
+		std::cerr << "no check called";
+		for (int i = 1; i < argc; ++i)
+			std::cerr << " " << argv[i];
+		std::cerr << std::endl;
+		return 1;
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "MyTerrainChunks.hpp"
+#include <algorithm>
+#include <iostream>
+#include "MyTerrainIndexing.hpp"
+
+static void
+ChunkBounds(const Vertex* vertices, size_t vertsX, size_t x0, size_t z0, size_t x1, size_t z1, TerrainChunk& chunk)
+{
+	chunk.boundsMin = vertices[z0 * vertsX + x0].p;
+	chunk.boundsMax = chunk.boundsMin;
+
+	for (size_t z = z0; z <= z1; ++z)
+	{
+		for (size_t x = x0; x <= x1; ++x)
+		{
+			chunk.boundsMin = glm::min(chunk.boundsMin, vertices[z * vertsX + x].p);
+			chunk.boundsMax = glm::max(chunk.boundsMax, vertices[z * vertsX + x].p);
+		}
+	}
+}
+
+TerrainChunks
+BuildTerrainChunks(const Vertex* vertices, size_t vertsX, size_t vertsZ, int chunkQuads)
+{
+	TerrainChunks terrain;
+	if (vertsX < 2 || vertsZ < 2 || chunkQuads < 1)
+		return terrain;
+
+	//a chunk one quad tall still needs two whole rows under 65536 from its base vertex
+	if (vertsX > 32768)
+	{
+		std::cerr << "Terrain rows of " << vertsX << " vertices are too wide for 16-bit chunk indices" << std::endl;
+		return terrain;
+	}
+
+	//the last row of a chunk row has to stay addressable from the row's base vertex
+	const size_t maxQuads = std::max<size_t>(65536 / vertsX - 1, 1);
+	if ((size_t)chunkQuads > maxQuads)
+	{
+		std::cerr << "Terrain chunks of " << chunkQuads << " quads don't fit 16-bit indices, using " << maxQuads << std::endl;
+		chunkQuads = (int)maxQuads;
+	}
+
+	terrain.chunkQuads = chunkQuads;
+	terrain.chunksX = (int)((vertsX - 2) / chunkQuads + 1);
+	terrain.chunksZ = (int)((vertsZ - 2) / chunkQuads + 1);
+	terrain.indices.reserve((vertsX - 1) * (vertsZ - 1) * 6);
+	terrain.chunks.reserve(terrain.chunksX * terrain.chunksZ);
+
+	for (int cz = 0; cz < terrain.chunksZ; ++cz)
+	{
+		const size_t z0 = (size_t)cz * chunkQuads, z1 = std::min(z0 + chunkQuads, vertsZ - 1);
+
+		for (int cx = 0; cx < terrain.chunksX; ++cx)
+		{
+			const size_t x0 = (size_t)cx * chunkQuads, x1 = std::min(x0 + chunkQuads, vertsX - 1);
+
+			TerrainChunk chunk;
+			chunk.firstIndex = terrain.indices.size();
+			chunk.baseVertex = (int)(z0 * vertsX);
+			ChunkBounds(vertices, vertsX, x0, z0, x1, z1, chunk);
+
+			//quads walked in narrow stripes, the same cache-friendly order as BuildChunkedIndices16
+			for (size_t sx = x0; sx < x1; sx += kDefaultStripeWidth)
+			{
+				const size_t sx1 = std::min(sx + kDefaultStripeWidth, x1);
+				for (size_t z = z0; z < z1; ++z)
+				{
+					const size_t row = (z - z0) * vertsX;
+					for (size_t x = sx; x < sx1; ++x)
+					{
+						uint16_t v00 = (uint16_t)(row + x);
+						uint16_t v10 = (uint16_t)(row + x + 1);
+						uint16_t v01 = (uint16_t)(row + vertsX + x);
+						uint16_t v11 = (uint16_t)(row + vertsX + x + 1);
+
+						terrain.indices.push_back(v00);
+						terrain.indices.push_back(v10);
+						terrain.indices.push_back(v11);
+						terrain.indices.push_back(v00);
+						terrain.indices.push_back(v11);
+						terrain.indices.push_back(v01);
+					}
+				}
+			}
+
+			chunk.indexCount = terrain.indices.size() - chunk.firstIndex;
+			terrain.chunks.push_back(chunk);
+		}
+	}
+	return terrain;
+}
+
+/*
+A chunk covers vertices x0 to x1 inclusive, so the vertex on a border between two chunks belongs to both
+*/
+void
+UpdateTerrainChunkBounds(TerrainChunks& terrain, const Vertex* vertices, size_t vertsX, size_t vertsZ, const TerrainRegion& region)
+{
+	if (region.Empty() || terrain.chunkQuads < 1)
+		return;
+
+	const size_t quads = (size_t)terrain.chunkQuads;
+	const int firstCX = (int)(region.firstX > 0 ? (region.firstX - 1) / quads : 0);
+	const int firstCZ = (int)(region.firstZ > 0 ? (region.firstZ - 1) / quads : 0);
+	const int lastCX = std::min((int)((region.endX - 1) / quads), terrain.chunksX - 1);
+	const int lastCZ = std::min((int)((region.endZ - 1) / quads), terrain.chunksZ - 1);
+
+	for (int cz = firstCZ; cz <= lastCZ; ++cz)
+	{
+		const size_t z0 = (size_t)cz * quads, z1 = std::min(z0 + quads, vertsZ - 1);
+		for (int cx = firstCX; cx <= lastCX; ++cx)
+		{
+			const size_t x0 = (size_t)cx * quads, x1 = std::min(x0 + quads, vertsX - 1);
+			ChunkBounds(vertices, vertsX, x0, z0, x1, z1, terrain.chunks[cz * terrain.chunksX + cx]);
+		}
+	}
+}
+
+void
+CullTerrainChunks(const TerrainChunks& terrain, MyFrustum& frustum, std::vector<ChunkDrawRange>& draws, ChunkCullStats& stats)
+{
+	draws.clear();
+	stats = ChunkCullStats();
+	stats.totalChunks = terrain.chunks.size();
+
+	for (const TerrainChunk& chunk : terrain.chunks)
+	{
+		if (!frustum.IsBoxOnScreen(chunk.boundsMin, chunk.boundsMax))
+			continue;
+
+		stats.visibleChunks++;
+		stats.visibleTriangles += chunk.indexCount / 3;
+
+		//carry on the previous draw if this chunk follows straight on from it in the same row
+		if (!draws.empty() && draws.back().baseVertex == chunk.baseVertex &&
+			draws.back().firstIndex + draws.back().indexCount == chunk.firstIndex)
+		{
+			draws.back().indexCount += chunk.indexCount;
+			continue;
+		}
+
+		ChunkDrawRange draw;
+		draw.firstIndex = chunk.firstIndex;
+		draw.indexCount = chunk.indexCount;
+		draw.baseVertex = chunk.baseVertex;
+		draws.push_back(draw);
+	}
+	stats.drawCalls = draws.size();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyFrustum.hpp"
+#include "MyTerrain.hpp"
+
+/*
+The full terrain grid cut into square chunks so whatever is outside the view frustum is never sent to the GPU.
+
+Each chunk keeps its box (including its height range) and its own range of a shared 16-bit index buffer.
+All the chunks in one row of chunks share a base vertex, the first vertex of that row, so every local index
+fits in 16 bits as long as a chunk is under 65536 / vertsX rows tall. Rows over 32768 vertices can't fit even
+one quad and get no chunks at all. Sharing the base vertex also means neighbouring visible chunks in a row are
+contiguous in the index buffer and cull down to a single draw
+*/
+const int kTerrainChunkQuads = 32;
+
+struct TerrainChunk
+{
+	size_t firstIndex;
+	size_t indexCount;
+	int baseVertex;
+	glm::vec3 boundsMin, boundsMax;
+};
+
+struct TerrainChunks
+{
+	std::vector<uint16_t> indices;
+	std::vector<TerrainChunk> chunks;
+	int chunksX{ 0 }, chunksZ{ 0 };
+	int chunkQuads{ 0 };
+};
+
+struct ChunkDrawRange
+{
+	size_t firstIndex;
+	size_t indexCount;
+	int baseVertex;
+};
+
+struct ChunkCullStats
+{
+	size_t visibleChunks{ 0 };
+	size_t totalChunks{ 0 };
+	size_t visibleTriangles{ 0 };
+	size_t drawCalls{ 0 };
+};
+
+TerrainChunks
+BuildTerrainChunks(const Vertex* vertices, size_t vertsX, size_t vertsZ, int chunkQuads);
+
+/*
+Refits the boxes of the chunks that overlap an edited region of the grid
+*/
+void
+UpdateTerrainChunkBounds(TerrainChunks& terrain, const Vertex* vertices, size_t vertsX, size_t vertsZ, const TerrainRegion& region);
+
+/*
+Tests every chunk's box against the frustum and fills draws with the index ranges to draw this frame
+*/
+void
+CullTerrainChunks(const TerrainChunks& terrain, MyFrustum& frustum, std::vector<ChunkDrawRange>& draws, ChunkCullStats& stats);
@@ -0,0 +1,172 @@
+#include "MyTerrainEditor.hpp"
+#include <algorithm>
+#include <chrono>
+
+TerrainEditor::TerrainEditor(TerrainGL& baseTerrain, TerrainGL& hiResTerrain)
+	: base(baseTerrain), hiRes(hiResTerrain)
+{
+	//the same tables SeparableInterpolation builds, only the offsets are needed to map control points to vertices
+	columnOffsets = utilAyre::BuildBernsteinTable(base.width, hiRes.verts_x).offsets;
+	rowOffsets = utilAyre::BuildBernsteinTable(base.height, (size_t)hiRes.verts_z).offsets;
+}
+
+/*
+Only the control points inside the brush's square get looked at. Columns keep the same x down every row and rows
+the same z along them, so the square comes from walking the first row and the first column
+*/
+void TerrainEditor::
+StampBrush(float worldX, float worldZ, float radius, float strength)
+{
+	if (radius <= 0)
+		return;
+
+	const size_t columns = base.verts_x;
+	const size_t rows = (size_t)base.verts_z;
+	const Vertex* grid = base.terrain_data.data();
+
+	//x goes up along a row and z goes down along a column
+	size_t squareX = 0, squareZ = 0;
+	while (squareX < columns && grid[squareX].p.x <= worldX - radius)
+		squareX++;
+	size_t squareEndX = squareX;
+	while (squareEndX < columns && grid[squareEndX].p.x < worldX + radius)
+		squareEndX++;
+	while (squareZ < rows && grid[squareZ * columns].p.z >= worldZ + radius)
+		squareZ++;
+	size_t squareEndZ = squareZ;
+	while (squareEndZ < rows && grid[squareEndZ * columns].p.z > worldZ - radius)
+		squareEndZ++;
+
+	size_t firstX = columns, firstZ = rows, endX = 0, endZ = 0;
+	for (size_t z = squareZ; z < squareEndZ; ++z)
+	{
+		for (size_t x = squareX; x < squareEndX; ++x)
+		{
+			Vertex& v = base.terrain_data[z * columns + x];
+			float dx = v.p.x - worldX;
+			float dz = v.p.z - worldZ;
+			float d2 = (dx * dx + dz * dz) / (radius * radius);
+			if (d2 >= 1)
+				continue;
+
+			float falloff = (1 - d2) * (1 - d2); //smooth at the centre and flat at the edge
+			v.p.y += strength * falloff;
+
+			firstX = std::min(firstX, x);
+			firstZ = std::min(firstZ, z);
+			endX = std::max(endX, x + 1);
+			endZ = std::max(endZ, z + 1);
+		}
+	}
+
+	if (endX > firstX)
+		MarkDirty(firstX, firstZ, endX, endZ);
+}
+
+void TerrainEditor::
+ReplaceRegion(size_t firstX, size_t firstZ, size_t width, size_t height, const float* heights)
+{
+	const size_t columns = base.verts_x;
+	const size_t rows = (size_t)base.verts_z;
+	if (firstX >= columns || firstZ >= rows)
+		return;
+
+	const size_t endX = std::min(firstX + width, columns);
+	const size_t endZ = std::min(firstZ + height, rows);
+	for (size_t z = firstZ; z < endZ; ++z)
+	{
+		for (size_t x = firstX; x < endX; ++x)
+		{
+			base.terrain_data[z * columns + x].p.y = heights[(z - firstZ) * width + x - firstX];
+		}
+	}
+	MarkDirty(firstX, firstZ, endX, endZ);
+}
+
+bool TerrainEditor::
+HasPendingEdits() const
+{
+	return !dirty.Empty();
+}
+
+TerrainRegion TerrainEditor::
+Regenerate()
+{
+	TerrainRegion changed;
+	if (dirty.Empty())
+		return changed;
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto start = Clock::now();
+
+	TerrainRegion heights;
+	AffectedSamples(columnOffsets, dirty.firstX, dirty.endX, heights.firstX, heights.endX);
+	AffectedSamples(rowOffsets, dirty.firstZ, dirty.endZ, heights.firstZ, heights.endZ);
+	dirty = TerrainRegion();
+
+	if (!heights.Empty())
+	{
+		hiRes.SeparableInterpolationRegion(&base, heights);
+		hiRes.ApplyNoiseRegion(heights);
+
+		//analytic normals came out with the heights, and only depend on their own vertex
+		if (hiRes.analyticNormals)
+		{
+			lastMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			return heights;
+		}
+
+		//a normal reads the heights either side of it, so the ring just outside the new heights changes too
+		changed.firstX = heights.firstX > 0 ? heights.firstX - 1 : 0;
+		changed.firstZ = heights.firstZ > 0 ? heights.firstZ - 1 : 0;
+		changed.endX = std::min(heights.endX + 1, hiRes.verts_x);
+		changed.endZ = std::min(heights.endZ + 1, (size_t)hiRes.verts_z);
+		hiRes.CalculateGridNormalsRegion(changed);
+	}
+
+	lastMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return changed;
+}
+
+double TerrainEditor::
+LastRegenerateMilliseconds() const
+{
+	return lastMilliseconds;
+}
+
+void TerrainEditor::
+MarkDirty(size_t firstX, size_t firstZ, size_t endX, size_t endZ)
+{
+	if (dirty.Empty())
+	{
+		dirty.firstX = firstX;
+		dirty.firstZ = firstZ;
+		dirty.endX = endX;
+		dirty.endZ = endZ;
+		return;
+	}
+	dirty.firstX = std::min(dirty.firstX, firstX);
+	dirty.firstZ = std::min(dirty.firstZ, firstZ);
+	dirty.endX = std::max(dirty.endX, endX);
+	dirty.endZ = std::max(dirty.endZ, endZ);
+}
+
+/*
+Sample i reads control points offsets[i] to offsets[i] + 3. The offsets only go up, so the samples that read
+any of [firstControl, endControl) are one unbroken run
+*/
+void TerrainEditor::
+AffectedSamples(const std::vector<int>& offsets, size_t firstControl, size_t endControl, size_t& first, size_t& end)
+{
+	first = offsets.size();
+	end = 0;
+	for (size_t i = 0; i < offsets.size(); ++i)
+	{
+		size_t offset = (size_t)offsets[i];
+		if (offset < endControl && offset + 4 > firstControl)
+		{
+			first = std::min(first, i);
+			end = i + 1;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+
+/*
+Edits to the heightmap without rebuilding the whole terrain.
+
+Brushes and region writes change the base mesh (the Bezier control points) and only mark which control points
+moved. Regenerate then works out which hi-res vertices have one of those points among their 4x4 patch taps,
+redoes the Bezier heights and noise for just them, and the normals for them plus a ring of one vertex (the
+normals either side read their heights). Every step is the region version of the full pipeline pass, so the
+result is bit-identical to building the whole terrain again from the edited base.
+
+Regenerate hands back the rectangle of hi-res vertices that changed, which is what has to be re-uploaded
+*/
+class TerrainEditor
+{
+public:
+	TerrainEditor(TerrainGL& baseTerrain, TerrainGL& hiResTerrain);
+
+	/*
+	Raises (or with a negative strength, lowers) the base heights within radius world units of (x, z), with a
+	smooth falloff to nothing at the edge
+	*/
+	void
+	StampBrush(float worldX, float worldZ, float radius, float strength);
+
+	/*
+	Overwrites a width x height block of base heights, row major, starting at control point (firstX, firstZ).
+	Anything off the edge of the base grid is ignored
+	*/
+	void
+	ReplaceRegion(size_t firstX, size_t firstZ, size_t width, size_t height, const float* heights);
+
+	bool
+	HasPendingEdits() const;
+
+	/*
+	Brings the hi-res terrain up to date with every edit since the last call
+	*/
+	TerrainRegion
+	Regenerate();
+
+	double
+	LastRegenerateMilliseconds() const;
+
+private:
+
+	void
+	MarkDirty(size_t firstX, size_t firstZ, size_t endX, size_t endZ);
+
+	static void
+	AffectedSamples(const std::vector<int>& offsets, size_t firstControl, size_t endControl, size_t& first, size_t& end);
+
+	TerrainGL& base;
+	TerrainGL& hiRes;
+
+	std::vector<int> columnOffsets, rowOffsets; //first control point of each hi-res column and row's patch
+	TerrainRegion dirty;                        //base control points edited since the last Regenerate
+	double lastMilliseconds{ 0 };
+};
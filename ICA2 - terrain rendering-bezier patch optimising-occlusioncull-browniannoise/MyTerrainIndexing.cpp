@@ -0,0 +1,188 @@
+#include "MyTerrainIndexing.hpp"
+#include <algorithm>
+#include <deque>
+#include <iostream>
+
+/*
+Strip order down each row is next-row vertex then this-row vertex, which gives the same counter-clockwise
+triangles as MakeMesh with every diagonal running the same way
+*/
+std::vector<uint32_t>
+BuildTriangleStrips(size_t vertsX, size_t vertsZ)
+{
+	std::vector<uint32_t> indices;
+	if (vertsX < 2 || vertsZ < 2)
+		return indices;
+
+	indices.reserve((vertsZ - 1) * (vertsX * 2 + 1));
+
+	for (size_t z = 0; z + 1 < vertsZ; ++z)
+	{
+		if (z > 0)
+			indices.push_back(kStripRestartIndex);
+
+		for (size_t x = 0; x < vertsX; ++x)
+		{
+			indices.push_back((uint32_t)((z + 1) * vertsX + x));
+			indices.push_back((uint32_t)(z * vertsX + x));
+		}
+	}
+	return indices;
+}
+
+ChunkedIndices16
+BuildChunkedIndices16(size_t vertsX, size_t vertsZ, size_t stripeWidth)
+{
+	ChunkedIndices16 chunked;
+	if (vertsX < 2 || vertsZ < 2)
+		return chunked;
+
+	//a band one quad tall still needs two whole rows under 65536 from its base vertex
+	if (vertsX > 32768)
+	{
+		std::cerr << "Terrain rows of " << vertsX << " vertices are too wide for 16-bit indices" << std::endl;
+		return chunked;
+	}
+
+	stripeWidth = std::max<size_t>(stripeWidth, 1);
+
+	//rows of vertices one band can hold while its last index still fits in 16 bits
+	const size_t bandVertexRows = std::min<size_t>(65536 / vertsX, vertsZ);
+	const size_t bandQuadRows = bandVertexRows - 1;
+
+	chunked.indices.reserve((vertsX - 1) * (vertsZ - 1) * 6);
+
+	for (size_t z0 = 0; z0 + 1 < vertsZ; z0 += bandQuadRows)
+	{
+		const size_t z1 = std::min(z0 + bandQuadRows, vertsZ - 1);
+
+		IndexChunk chunk;
+		chunk.firstIndex = chunked.indices.size();
+		chunk.baseVertex = (int)(z0 * vertsX);
+
+		for (size_t x0 = 0; x0 + 1 < vertsX; x0 += stripeWidth)
+		{
+			const size_t x1 = std::min(x0 + stripeWidth, vertsX - 1);
+
+			for (size_t z = z0; z < z1; ++z)
+			{
+				const size_t row = (z - z0) * vertsX;
+				for (size_t x = x0; x < x1; ++x)
+				{
+					uint16_t v00 = (uint16_t)(row + x);
+					uint16_t v10 = (uint16_t)(row + x + 1);
+					uint16_t v01 = (uint16_t)(row + vertsX + x);
+					uint16_t v11 = (uint16_t)(row + vertsX + x + 1);
+
+					chunked.indices.push_back(v00);
+					chunked.indices.push_back(v10);
+					chunked.indices.push_back(v11);
+					chunked.indices.push_back(v00);
+					chunked.indices.push_back(v11);
+					chunked.indices.push_back(v01);
+				}
+			}
+		}
+
+		chunk.indexCount = chunked.indices.size() - chunk.firstIndex;
+		chunked.chunks.push_back(chunk);
+	}
+	return chunked;
+}
+
+/*
+First-in first-out cache like the older fixed-size hardware caches: a hit doesn't refresh the entry.
+Strips are unrolled into triangles (skipping the degenerate pair after each restart) before being counted
+*/
+VertexCacheStats
+SimulateFifoCache(const std::vector<uint32_t>& indices, bool strip, size_t cacheSize)
+{
+	VertexCacheStats stats;
+	std::deque<uint32_t> cache;
+	std::vector<uint32_t> seen;
+
+	size_t stripLength = 0;
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		uint32_t index = indices[i];
+		if (strip && index == kStripRestartIndex)
+		{
+			stripLength = 0;
+			continue;
+		}
+
+		if (std::find(cache.begin(), cache.end(), index) == cache.end())
+		{
+			stats.misses++;
+			cache.push_back(index);
+			if (cache.size() > cacheSize)
+				cache.pop_front();
+		}
+		seen.push_back(index);
+
+		stripLength++;
+		if (strip && stripLength >= 3)
+			stats.triangles++;
+	}
+
+	if (!strip)
+		stats.triangles = indices.size() / 3;
+
+	std::sort(seen.begin(), seen.end());
+	stats.uniqueVertices = std::unique(seen.begin(), seen.end()) - seen.begin();
+	stats.acmr = stats.triangles ? (double)stats.misses / stats.triangles : 0;
+	stats.atvr = stats.uniqueVertices ? (double)stats.misses / stats.uniqueVertices : 0;
+	return stats;
+}
+
+/*
+What the GPU actually caches on is the index after the base vertex is added, so simulate on that
+*/
+std::vector<uint32_t>
+ExpandChunks(const ChunkedIndices16& chunked)
+{
+	std::vector<uint32_t> expanded;
+	expanded.reserve(chunked.indices.size());
+
+	for (const IndexChunk& chunk : chunked.chunks)
+	{
+		for (size_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; ++i)
+		{
+			expanded.push_back((uint32_t)(chunked.indices[i] + chunk.baseVertex));
+		}
+	}
+	return expanded;
+}
+
+/*
+Prints index buffer size, ACMR and ATVR for each ordering against a few common cache sizes, no GPU needed
+*/
+void
+ReportIndexOrderings(size_t vertsX, size_t vertsZ, const std::vector<int>& listIndices, std::ostream& out)
+{
+	const size_t cacheSizes[3] = { 16, 24, 32 };
+
+	std::vector<uint32_t> list(listIndices.begin(), listIndices.end());
+	std::vector<uint32_t> strips = BuildTriangleStrips(vertsX, vertsZ);
+	ChunkedIndices16 chunked = BuildChunkedIndices16(vertsX, vertsZ, kDefaultStripeWidth);
+	std::vector<uint32_t> chunkedExpanded = ExpandChunks(chunked);
+
+	struct Ordering { const char* name; const std::vector<uint32_t>* indices; bool strip; size_t bytes; };
+	const Ordering orderings[3] = {
+		{ "MakeMesh list (32-bit)", &list, false, list.size() * sizeof(uint32_t) },
+		{ "strips + restart (32-bit)", &strips, true, strips.size() * sizeof(uint32_t) },
+		{ "stripe chunks (16-bit)", &chunkedExpanded, false, chunked.indices.size() * sizeof(uint16_t) },
+	};
+
+	out << "Terrain index orderings for " << vertsX << "x" << vertsZ << " vertices" << std::endl;
+	for (const Ordering& ordering : orderings)
+	{
+		out << "  " << ordering.name << ": " << ordering.bytes / (1024.0 * 1024.0) << " MB";
+		for (size_t cacheSize : cacheSizes)
+		{
+			VertexCacheStats stats = SimulateFifoCache(*ordering.indices, ordering.strip, cacheSize);
+			out << ", fifo" << cacheSize << " ACMR " << stats.acmr << " ATVR " << stats.atvr;
+		}
+		out << std::endl;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/*
+Alternative index buffers for the regular terrain grid, all using the same winding as MakeMesh.
+
+	Strips   - one GL_TRIANGLE_STRIP per row of quads, joined with a primitive restart index
+	Chunks16 - GL_TRIANGLES in 16-bit indices. The grid is cut into bands of rows small enough that every
+	           index fits in 16 bits once the band's first vertex is used as the base vertex. Inside a band
+	           the quads are walked in narrow vertical stripes, so the row above is still in the
+	           post-transform cache when the row below needs it. Rows over 32768 vertices can't fit even a
+	           one quad band, so they get no chunks at all
+*/
+const uint32_t kStripRestartIndex = 0xFFFFFFFF;
+const size_t kDefaultStripeWidth = 6; //quads per stripe, keeps ACMR near 0.6 down to a 16 entry FIFO
+
+struct IndexChunk
+{
+	size_t firstIndex;
+	size_t indexCount;
+	int baseVertex;
+};
+
+struct ChunkedIndices16
+{
+	std::vector<uint16_t> indices;
+	std::vector<IndexChunk> chunks;
+};
+
+std::vector<uint32_t>
+BuildTriangleStrips(size_t vertsX, size_t vertsZ);
+
+ChunkedIndices16
+BuildChunkedIndices16(size_t vertsX, size_t vertsZ, size_t stripeWidth);
+
+/*
+Post-transform cache simulation. ACMR is cache misses per triangle (lower is better, 0.5 is the ideal for
+a big grid) and ATVR is misses per unique vertex (1.0 means every vertex was shaded exactly once)
+*/
+struct VertexCacheStats
+{
+	size_t triangles{ 0 };
+	size_t misses{ 0 };
+	size_t uniqueVertices{ 0 };
+	double acmr{ 0 };
+	double atvr{ 0 };
+};
+
+VertexCacheStats
+SimulateFifoCache(const std::vector<uint32_t>& indices, bool strip, size_t cacheSize);
+
+std::vector<uint32_t>
+ExpandChunks(const ChunkedIndices16& chunked);
+
+void
+ReportIndexOrderings(size_t vertsX, size_t vertsZ, const std::vector<int>& listIndices, std::ostream& out);
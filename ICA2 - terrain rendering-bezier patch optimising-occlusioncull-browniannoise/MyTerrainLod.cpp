@@ -0,0 +1,369 @@
+#include "MyTerrainLod.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+bool TerrainLodTree::
+Build(const Vertex* vertices, size_t vertsX, size_t vertsZ, int targetSizeX, int targetSizeZ, const LodSettings& settings)
+{
+	if (vertsX < 2 || vertsZ < 2 || settings.leafQuads < 2 || settings.leafQuads % 2)
+	{
+		std::cerr << "LOD tree needs at least a 2x2 grid and an even node size" << std::endl;
+		return false;
+	}
+
+	this->settings = settings;
+	this->vertsX = vertsX;
+	this->vertsZ = vertsZ;
+	spacingX = targetSizeX / (float)vertsX; //same spacing GridPosition gives out
+	spacingZ = targetSizeZ / (float)vertsZ;
+
+	const size_t quads = std::max(vertsX, vertsZ) - 1;
+	levelCount = 1;
+	while ((size_t)settings.leafQuads << (levelCount - 1) < quads)
+		levelCount++;
+
+	nodesX.resize(levelCount);
+	nodesZ.resize(levelCount);
+	bounds.assign(levelCount, std::vector<Bounds>());
+	for (int level = 0; level < levelCount; ++level)
+	{
+		size_t nodeQuads = (size_t)settings.leafQuads << level;
+		nodesX[level] = (int)((vertsX - 2) / nodeQuads + 1);
+		nodesZ[level] = (int)((vertsZ - 2) / nodeQuads + 1);
+		bounds[level].resize(nodesX[level] * nodesZ[level]);
+	}
+
+	//leaf bounds straight from the heights, then each parent from its children
+	for (int nz = 0; nz < nodesZ[0]; ++nz)
+	{
+		for (int nx = 0; nx < nodesX[0]; ++nx)
+		{
+			LeafBounds(vertices, nx, nz);
+		}
+	}
+
+	for (int level = 1; level < levelCount; ++level)
+	{
+		for (int nz = 0; nz < nodesZ[level]; ++nz)
+		{
+			for (int nx = 0; nx < nodesX[level]; ++nx)
+			{
+				ParentBounds(nx, nz, level);
+			}
+		}
+	}
+
+	/*
+	Level error: how far the full detail heights are from the level's coarser grid, taking the coarse surface
+	as bilinear between its vertices. Never allowed to shrink going up so the ranges keep growing
+	*/
+	levelErrors.assign(levelCount, 0);
+	for (int level = 1; level < levelCount; ++level)
+	{
+		const size_t stride = (size_t)1 << level;
+		float worst = levelErrors[level - 1];
+
+		for (size_t z = 0; z < vertsZ; ++z)
+		{
+			size_t z0 = z / stride * stride, z1 = std::min(z0 + stride, vertsZ - 1);
+			float tz = z1 > z0 ? (float)(z - z0) / (z1 - z0) : 0;
+
+			for (size_t x = 0; x < vertsX; ++x)
+			{
+				size_t x0 = x / stride * stride, x1 = std::min(x0 + stride, vertsX - 1);
+				float tx = x1 > x0 ? (float)(x - x0) / (x1 - x0) : 0;
+
+				float h00 = vertices[z0 * vertsX + x0].p.y, h10 = vertices[z0 * vertsX + x1].p.y;
+				float h01 = vertices[z1 * vertsX + x0].p.y, h11 = vertices[z1 * vertsX + x1].p.y;
+				float nearRow = h00 + (h10 - h00) * tx;
+				float farRow = h01 + (h11 - h01) * tx;
+
+				worst = std::max(worst, std::fabs(vertices[z * vertsX + x].p.y - (nearRow + (farRow - nearRow) * tz)));
+			}
+		}
+		levelErrors[level] = worst;
+	}
+	return true;
+}
+
+/*
+Leaf nodes share their border vertices, so a region touches the leaves either side of its edges too
+*/
+void TerrainLodTree::
+UpdateBounds(const Vertex* vertices, const TerrainRegion& region)
+{
+	if (region.Empty() || levelCount == 0)
+		return;
+
+	const size_t leaf = (size_t)settings.leafQuads;
+	int firstX = (int)(region.firstX > 0 ? (region.firstX - 1) / leaf : 0);
+	int firstZ = (int)(region.firstZ > 0 ? (region.firstZ - 1) / leaf : 0);
+	int lastX = std::min((int)((region.endX - 1) / leaf), nodesX[0] - 1);
+	int lastZ = std::min((int)((region.endZ - 1) / leaf), nodesZ[0] - 1);
+
+	for (int nz = firstZ; nz <= lastZ; ++nz)
+	{
+		for (int nx = firstX; nx <= lastX; ++nx)
+		{
+			LeafBounds(vertices, nx, nz);
+		}
+	}
+
+	for (int level = 1; level < levelCount; ++level)
+	{
+		firstX /= 2;
+		firstZ /= 2;
+		lastX /= 2;
+		lastZ /= 2;
+		for (int nz = firstZ; nz <= lastZ; ++nz)
+		{
+			for (int nx = firstX; nx <= lastX; ++nx)
+			{
+				ParentBounds(nx, nz, level);
+			}
+		}
+	}
+}
+
+void TerrainLodTree::
+LeafBounds(const Vertex* vertices, int nodeX, int nodeZ)
+{
+	size_t x0 = (size_t)nodeX * settings.leafQuads, x1 = std::min(x0 + settings.leafQuads, vertsX - 1);
+	size_t z0 = (size_t)nodeZ * settings.leafQuads, z1 = std::min(z0 + settings.leafQuads, vertsZ - 1);
+
+	Bounds& node = bounds[0][nodeZ * nodesX[0] + nodeX];
+	node.minY = FLT_MAX;
+	node.maxY = -FLT_MAX;
+	for (size_t z = z0; z <= z1; ++z)
+	{
+		for (size_t x = x0; x <= x1; ++x)
+		{
+			node.minY = std::min(node.minY, vertices[z * vertsX + x].p.y);
+			node.maxY = std::max(node.maxY, vertices[z * vertsX + x].p.y);
+		}
+	}
+}
+
+void TerrainLodTree::
+ParentBounds(int nodeX, int nodeZ, int level)
+{
+	Bounds& node = bounds[level][nodeZ * nodesX[level] + nodeX];
+	node.minY = FLT_MAX;
+	node.maxY = -FLT_MAX;
+	for (int q = 0; q < 4; ++q)
+	{
+		int cx = nodeX * 2 + (q & 1), cz = nodeZ * 2 + (q >> 1);
+		if (!NodeExists(cx, cz, level - 1))
+			continue;
+
+		const Bounds& child = bounds[level - 1][cz * nodesX[level - 1] + cx];
+		node.minY = std::min(node.minY, child.minY);
+		node.maxY = std::max(node.maxY, child.maxY);
+	}
+}
+
+/*
+Ranges: level l is good enough from the distance where the error of the level above it drops under the pixel
+budget. They're also kept at least double the one below, and the leaf range at least two leaf diagonals,
+so a split node's remaining quarters are always past the point where they start morphing
+*/
+void TerrainLodTree::
+Select(const LodCamera& camera, LodSelection& selection) const
+{
+	selection.nodes.clear();
+	selection.morphStart.assign(levelCount, 0);
+	selection.morphEnd.assign(levelCount, 0);
+	selection.triangleCount = 0;
+	if (levelCount == 0)
+		return;
+
+	const float pixelsPerUnit = camera.viewportHeight / (2.0f * std::tan(glm::radians(camera.verticalFovDegrees) * 0.5f)); //at a distance of 1
+	const float leafDiagonal = settings.leafQuads * std::sqrt(spacingX * spacingX + spacingZ * spacingZ);
+
+	std::vector<float> ranges(levelCount);
+	for (int level = 0; level < levelCount; ++level)
+	{
+		float range = level + 1 < levelCount ? levelErrors[level + 1] * pixelsPerUnit / settings.pixelError : FLT_MAX;
+		float minimum = level > 0 ? ranges[level - 1] * 2.0f : leafDiagonal * 2.0f;
+		ranges[level] = std::max(range, minimum);
+
+		if (level + 1 < levelCount)
+		{
+			float previous = level > 0 ? ranges[level - 1] : 0;
+			selection.morphEnd[level] = ranges[level];
+			selection.morphStart[level] = previous + (ranges[level] - previous) * settings.morphStartRatio;
+		}
+		else
+		{
+			selection.morphStart[level] = 1e30f; //the root covers everything and never morphs
+			selection.morphEnd[level] = 2e30f;
+		}
+	}
+
+	SelectNode(0, 0, levelCount - 1, camera, ranges, selection);
+}
+
+bool TerrainLodTree::
+SelectNode(int nodeX, int nodeZ, int level, const LodCamera& camera, const std::vector<float>& ranges, LodSelection& selection) const
+{
+	if (level + 1 < levelCount && !NodeInRange(nodeX, nodeZ, level, camera.position, ranges[level]))
+		return false; //too far for this level, the parent covers it
+
+	if (level == 0 || !NodeInRange(nodeX, nodeZ, level, camera.position, ranges[level - 1]))
+	{
+		AddNode(nodeX, nodeZ, level, 0xF, selection);
+		return true;
+	}
+
+	uint8_t quadrants = 0;
+	for (int q = 0; q < 4; ++q)
+	{
+		int cx = nodeX * 2 + (q & 1), cz = nodeZ * 2 + (q >> 1);
+		if (NodeExists(cx, cz, level - 1) && !SelectNode(cx, cz, level - 1, camera, ranges, selection))
+			quadrants |= 1 << q;
+	}
+	if (quadrants)
+		AddNode(nodeX, nodeZ, level, quadrants, selection);
+	return true;
+}
+
+bool TerrainLodTree::
+NodeExists(int nodeX, int nodeZ, int level) const
+{
+	return nodeX < nodesX[level] && nodeZ < nodesZ[level];
+}
+
+/*
+Grid z runs down world -z, the same as GridPosition
+*/
+void TerrainLodTree::
+NodeBox(int nodeX, int nodeZ, int level, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	const size_t nodeQuads = (size_t)settings.leafQuads << level;
+	const Bounds& node = bounds[level][nodeZ * nodesX[level] + nodeX];
+
+	boundsMin = glm::vec3(nodeX * nodeQuads * spacingX, node.minY, -(float)(std::min((nodeZ + 1) * nodeQuads, vertsZ - 1)) * spacingZ);
+	boundsMax = glm::vec3(std::min((nodeX + 1) * nodeQuads, vertsX - 1) * spacingX, node.maxY, -(float)(nodeZ * nodeQuads) * spacingZ);
+}
+
+bool TerrainLodTree::
+NodeInRange(int nodeX, int nodeZ, int level, const glm::vec3& position, float range) const
+{
+	glm::vec3 boundsMin, boundsMax;
+	NodeBox(nodeX, nodeZ, level, boundsMin, boundsMax);
+
+	glm::vec3 nearest = glm::clamp(position, boundsMin, boundsMax);
+	glm::vec3 offset = position - nearest;
+	return glm::dot(offset, offset) <= range * range;
+}
+
+void TerrainLodTree::
+AddNode(int nodeX, int nodeZ, int level, uint8_t quadrants, LodSelection& selection) const
+{
+	LodNode node;
+	node.x = nodeX * (settings.leafQuads << level);
+	node.z = nodeZ * (settings.leafQuads << level);
+	node.level = level;
+	node.quadrants = quadrants;
+	NodeBox(nodeX, nodeZ, level, node.boundsMin, node.boundsMax);
+	selection.nodes.push_back(node);
+
+	for (int q = 0; q < 4; ++q)
+	{
+		if (quadrants & (1 << q))
+			selection.triangleCount += QuadrantIndexCount(settings.leafQuads) / 3;
+	}
+}
+
+int TerrainLodTree::
+LevelCount() const
+{
+	return levelCount;
+}
+
+int TerrainLodTree::
+LeafQuads() const
+{
+	return settings.leafQuads;
+}
+
+float TerrainLodTree::
+LevelError(int level) const
+{
+	return levelErrors[level];
+}
+
+size_t TerrainLodTree::
+FullTriangleCount() const
+{
+	return vertsX > 1 && vertsZ > 1 ? (vertsX - 1) * (vertsZ - 1) * 2 : 0;
+}
+
+/*
+Same winding as the chunked index buffers, counter-clockwise seen from above
+*/
+std::vector<uint16_t> TerrainLodTree::
+BuildNodeIndices(int leafQuads)
+{
+	const int half = leafQuads / 2;
+	const int rowVerts = leafQuads + 1;
+
+	std::vector<uint16_t> indices;
+	indices.reserve(QuadrantIndexCount(leafQuads) * 4);
+
+	for (int q = 0; q < 4; ++q)
+	{
+		int firstX = (q & 1) * half, firstZ = (q >> 1) * half;
+		for (int z = firstZ; z < firstZ + half; ++z)
+		{
+			for (int x = firstX; x < firstX + half; ++x)
+			{
+				uint16_t v00 = (uint16_t)(z * rowVerts + x);
+				uint16_t v10 = (uint16_t)(v00 + 1);
+				uint16_t v01 = (uint16_t)(v00 + rowVerts);
+				uint16_t v11 = (uint16_t)(v01 + 1);
+
+				indices.push_back(v00);
+				indices.push_back(v10);
+				indices.push_back(v11);
+				indices.push_back(v00);
+				indices.push_back(v11);
+				indices.push_back(v01);
+			}
+		}
+	}
+	return indices;
+}
+
+size_t TerrainLodTree::
+QuadrantIndexCount(int leafQuads)
+{
+	return (size_t)(leafQuads / 2) * (leafQuads / 2) * 6;
+}
+
+void
+ReportLodSelection(const TerrainLodTree& tree, const std::vector<LodCamera>& cameras, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const int kRepeats = 100;
+
+	out << "Terrain LOD, " << tree.LevelCount() << " levels of " << tree.LeafQuads() << "x" << tree.LeafQuads() << " quad nodes" << std::endl;
+
+	LodSelection selection;
+	for (const LodCamera& camera : cameras)
+	{
+		auto start = Clock::now();
+		for (int i = 0; i < kRepeats; ++i)
+		{
+			tree.Select(camera, selection);
+		}
+		double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / kRepeats;
+
+		out << "  camera at height " << camera.position.y << ": " << selection.nodes.size() << " nodes, "
+			<< selection.triangleCount << " triangles (" << (double)tree.FullTriangleCount() / selection.triangleCount
+			<< "x fewer), select " << us << " us" << std::endl;
+	}
+}
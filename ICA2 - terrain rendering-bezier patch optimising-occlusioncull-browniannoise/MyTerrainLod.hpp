@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+
+/*
+Continuous distance-based LOD (CDLOD) over the terrain grid.
+
+Every node of the quadtree is drawn with the same small grid of leafQuads x leafQuads quads, just spread out
+with a stride of 1 << level vertices, so one index buffer serves every node. Level 0 nodes are full detail.
+
+Each level has a range worked out from the screen-space error budget: the worst height error of dropping to
+the next level, projected at that distance, must stay under pixelError. A node is split when the camera is
+inside its children's range, and any child that isn't in range is drawn as a quarter of the parent. Inside
+the last part of its range a node's odd vertices slide onto their even neighbours (the morph), so when the
+switch to the coarser level happens the geometry is already identical and nothing pops.
+
+Select is pure CPU with no GL in it, so it can be tested and timed headless
+*/
+struct LodSettings
+{
+	int leafQuads{ 32 };           //quads along one side of the shared node mesh, even
+	float pixelError{ 1.0f };      //largest height error allowed on screen, in pixels
+	float morphStartRatio{ 0.7f }; //how far through a level's range its vertices start to morph
+};
+
+struct LodCamera
+{
+	glm::vec3 position;
+	float viewportHeight;
+	float verticalFovDegrees;
+};
+
+/*
+A node to draw. Quadrant bit i (x half = i & 1, z half = i >> 1) set means that quarter gets drawn at this
+level; a node drawn whole has all four
+*/
+struct LodNode
+{
+	int x, z;  //first vertex of the node on the full grid
+	int level; //vertex stride is 1 << level
+	uint8_t quadrants;
+	glm::vec3 boundsMin, boundsMax; //whole node, for frustum culling
+};
+
+struct LodSelection
+{
+	std::vector<LodNode> nodes;
+	std::vector<float> morphStart; //per level, distances the shader blends over
+	std::vector<float> morphEnd;
+	size_t triangleCount{ 0 };
+};
+
+class TerrainLodTree
+{
+public:
+
+	bool
+	Build(const Vertex* vertices, size_t vertsX, size_t vertsZ, int targetSizeX, int targetSizeZ, const LodSettings& settings);
+
+	/*
+	Refits the height bounds of every node over an edited region. The level errors (and so the ranges) are
+	left as they were built: they are a worst case over the whole grid and a brush rarely moves them much,
+	but a big enough edit wants a full Build to get the ranges right again
+	*/
+	void
+	UpdateBounds(const Vertex* vertices, const TerrainRegion& region);
+
+	void
+	Select(const LodCamera& camera, LodSelection& selection) const;
+
+	int
+	LevelCount() const;
+
+	int
+	LeafQuads() const;
+
+	/*
+	World height error of drawing a level instead of full detail
+	*/
+	float
+	LevelError(int level) const;
+
+	size_t
+	FullTriangleCount() const;
+
+	/*
+	The shared node mesh. Vertices are implied by gl_VertexID on a (leafQuads + 1) square grid; the indices
+	are stored a quadrant at a time so any quarter, or the whole node, is one contiguous range
+	*/
+	static std::vector<uint16_t>
+	BuildNodeIndices(int leafQuads);
+
+	static size_t
+	QuadrantIndexCount(int leafQuads);
+
+private:
+
+	struct Bounds
+	{
+		float minY, maxY;
+	};
+
+	bool
+	SelectNode(int nodeX, int nodeZ, int level, const LodCamera& camera, const std::vector<float>& ranges, LodSelection& selection) const;
+
+	void
+	LeafBounds(const Vertex* vertices, int nodeX, int nodeZ);
+
+	void
+	ParentBounds(int nodeX, int nodeZ, int level);
+
+	bool
+	NodeExists(int nodeX, int nodeZ, int level) const;
+
+	void
+	NodeBox(int nodeX, int nodeZ, int level, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+	bool
+	NodeInRange(int nodeX, int nodeZ, int level, const glm::vec3& position, float range) const;
+
+	void
+	AddNode(int nodeX, int nodeZ, int level, uint8_t quadrants, LodSelection& selection) const;
+
+	LodSettings settings;
+	size_t vertsX{ 0 }, vertsZ{ 0 };
+	float spacingX{ 1 }, spacingZ{ 1 };
+	int levelCount{ 0 };
+
+	std::vector<int> nodesX, nodesZ;          //node count along each side, per level
+	std::vector<std::vector<Bounds>> bounds;  //per level, row major
+	std::vector<float> levelErrors;
+};
+
+/*
+Prints nodes, triangles against the full grid and the time Select takes for each camera
+*/
+void
+ReportLodSelection(const TerrainLodTree& tree, const std::vector<LodCamera>& cameras, std::ostream& out);
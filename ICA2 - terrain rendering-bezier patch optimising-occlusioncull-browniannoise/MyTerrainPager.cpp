@@ -0,0 +1,413 @@
+#include "MyTerrainPager.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+TerrainPager::TerrainPager(size_t worldVertsX, size_t worldVertsZ, int worldSizeX, int worldSizeZ, TerrainChunkSource source,
+	const TerrainPagerSettings& settings)
+	: source(source), settings(settings), worldVertsX(worldVertsX), worldVertsZ(worldVertsZ), worldSizeX(worldSizeX), worldSizeZ(worldSizeZ)
+{
+	const size_t segments = std::max<size_t>(this->settings.chunkSegments, 1);
+	this->settings.chunkSegments = segments;
+	chunkVerts = segments + 1;
+	chunksX = std::max<size_t>((worldVertsX + segments - 2) / segments, 1);
+	chunksZ = std::max<size_t>((worldVertsZ + segments - 2) / segments, 1);
+
+	slotCount = std::max<size_t>(settings.budgetBytes / ChunkBytes(), 1);
+	for (size_t slot = slotCount; slot > 0; --slot)
+	{
+		freeSlots.push_back(slot - 1);
+	}
+
+	//MakeMesh's alternating diagonals. Chunks start on even vertices, so they line up with the full grid's
+	indices.reserve(segments * segments * 6);
+	for (uint32_t z = 0; z < segments; ++z)
+	{
+		for (uint32_t x = 0; x < segments; ++x)
+		{
+			uint32_t corner = z * (uint32_t)chunkVerts + x;
+			uint32_t below = corner + (uint32_t)chunkVerts;
+			if ((z % 2) != (x % 2))
+			{
+				indices.insert(indices.end(), { corner, corner + 1, below, corner + 1, below + 1, below });
+			}
+			else
+			{
+				indices.insert(indices.end(), { corner, corner + 1, below + 1, corner, below + 1, below });
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < std::max(settings.workerThreads, 1u); ++i)
+	{
+		workers.emplace_back(&TerrainPager::WorkerLoop, this);
+	}
+}
+
+TerrainPager::~TerrainPager()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		shuttingDown = true;
+		queue.clear();
+	}
+	queueReady.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+/*
+Chunk keys are chunkZ * chunksX + chunkX
+*/
+glm::vec2 TerrainPager::
+ChunkCentre(size_t chunkX, size_t chunkZ) const
+{
+	const float half = settings.chunkSegments * 0.5f;
+	return glm::vec2((chunkX * settings.chunkSegments + half) * worldSizeX / worldVertsX,
+		-(chunkZ * settings.chunkSegments + half) * worldSizeZ / worldVertsZ);
+}
+
+/*
+Everything here is bounded by the chunks in range plus maxUploadsPerFrame and maxQueued, and the lock is only
+held for queue and map shuffling, so a frame never waits on chunk generation
+*/
+void TerrainPager::
+Update(const glm::vec3& camera, std::vector<TerrainChunkUpload>& uploads)
+{
+	uploads.clear();
+
+	//the chunks in range, nearest first
+	const float radius = settings.loadRadius;
+	const float chunkWorldX = settings.chunkSegments * (float)worldSizeX / worldVertsX;
+	const float chunkWorldZ = settings.chunkSegments * (float)worldSizeZ / worldVertsZ;
+	auto chunkRange = [](float low, float high, float chunkWorld, size_t chunks, size_t& first, size_t& end)
+	{
+		float firstChunk = std::floor(low / chunkWorld);
+		float endChunk = std::floor(high / chunkWorld) + 1;
+		first = firstChunk < 0 ? 0 : std::min((size_t)firstChunk, chunks);
+		end = endChunk < 0 ? 0 : std::min((size_t)endChunk, chunks);
+	};
+
+	size_t firstX, endX, firstZ, endZ;
+	chunkRange(camera.x - radius, camera.x + radius, chunkWorldX, chunksX, firstX, endX);
+	chunkRange(-camera.z - radius, -camera.z + radius, chunkWorldZ, chunksZ, firstZ, endZ);
+
+	wanted.clear();
+	desired.clear();
+	for (size_t cz = firstZ; cz < endZ; ++cz)
+	{
+		for (size_t cx = firstX; cx < endX; ++cx)
+		{
+			glm::vec2 centre = ChunkCentre(cx, cz);
+			float distance = std::sqrt((centre.x - camera.x) * (centre.x - camera.x) + (centre.y - camera.z) * (centre.y - camera.z));
+			if (distance <= radius)
+			{
+				wanted.push_back(std::make_pair(distance, cz * chunksX + cx));
+				desired.insert(cz * chunksX + cx);
+			}
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+
+	//furthest first, so the nearest chunk ends up the most recently used
+	stats.desiredResident = 0;
+	for (auto it = wanted.rbegin(); it != wanted.rend(); ++it)
+	{
+		auto found = resident.find(it->second);
+		if (found != resident.end())
+		{
+			usage.splice(usage.begin(), usage, found->second.usage);
+			stats.desiredResident++;
+		}
+	}
+	stats.desiredChunks = wanted.size();
+
+	std::unique_lock<std::mutex> lock(queueMutex);
+
+	//requests still waiting get dropped and asked for again below in the new order, finished chunks the camera
+	//has left behind are thrown away
+	for (size_t key : queue)
+	{
+		inFlight.erase(key);
+		if (!desired.count(key))
+			stats.cancelled++;
+	}
+	queue.clear();
+
+	for (auto it = finished.begin(); it != finished.end();)
+	{
+		if (!desired.count(it->first))
+		{
+			inFlight.erase(it->first);
+			stats.cancelled++;
+			it = finished.erase(it);
+		}
+		else
+			++it;
+	}
+
+	for (const auto& want : wanted)
+	{
+		if (uploads.size() >= settings.maxUploadsPerFrame)
+			break;
+
+		auto ready = finished.find(want.second);
+		if (ready == finished.end())
+			continue;
+
+		size_t slot;
+		if (!TakeSlot(slot))
+			break; //everything resident is in range, the rest waits for the camera to move
+
+		usage.push_front(want.second);
+		resident[want.second] = ResidentChunk{ slot, ready->second.minCorner, ready->second.maxCorner, usage.begin() };
+		uploads.push_back(TerrainChunkUpload{ slot, want.second % chunksX, want.second / chunksX, ready->second.vertices });
+		stats.desiredResident++;
+		stats.uploaded++;
+
+		inFlight.erase(want.second);
+		finished.erase(ready);
+	}
+
+	for (const auto& want : wanted)
+	{
+		if (inFlight.size() >= settings.maxQueued)
+			break;
+
+		if (resident.count(want.second) || inFlight.count(want.second))
+			continue;
+
+		queue.push_back(want.second);
+		inFlight.insert(want.second);
+		stats.requested++;
+	}
+
+	const bool work = !queue.empty();
+	lock.unlock();
+
+	if (work)
+		queueReady.notify_all();
+}
+
+/*
+A free slot if there is one, otherwise the least recently used chunk's as long as it's out of range
+*/
+bool TerrainPager::
+TakeSlot(size_t& slot)
+{
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		return true;
+	}
+
+	if (usage.empty() || desired.count(usage.back()))
+		return false;
+
+	auto oldest = resident.find(usage.back());
+	slot = oldest->second.slot;
+	resident.erase(oldest);
+	usage.pop_back();
+	stats.evicted++;
+	return true;
+}
+
+void TerrainPager::
+ResidentChunks(std::vector<TerrainChunkDraw>& draws) const
+{
+	draws.clear();
+	for (const auto& chunk : resident)
+	{
+		draws.push_back(TerrainChunkDraw{ chunk.second.slot, chunk.second.minCorner, chunk.second.maxCorner });
+	}
+}
+
+void TerrainPager::
+WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(queueMutex);
+	queueIdle.wait(lock, [this] { return queue.empty() && running == 0; });
+}
+
+TerrainPagerStats TerrainPager::
+Stats() const
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	TerrainPagerStats result = stats;
+	result.residentChunks = resident.size();
+	result.residentBytes = resident.size() * ChunkBytes();
+	result.pendingChunks = inFlight.size();
+	result.pendingBytes = finished.size() * ChunkBytes();
+	return result;
+}
+
+void TerrainPager::
+WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(queueMutex);
+	for (;;)
+	{
+		queueReady.wait(lock, [this] { return shuttingDown || !queue.empty(); });
+		if (shuttingDown)
+			return;
+
+		size_t key = queue.front();
+		queue.pop_front();
+		running++;
+
+		lock.unlock();
+		FinishedChunk chunk = GenerateChunk(key);
+		lock.lock();
+
+		running--;
+		stats.generated++;
+
+		//the render thread stops tracking a chunk once it's out of range, so only keep what it's still waiting on
+		if (inFlight.count(key))
+			finished[key] = chunk;
+
+		if (queue.empty() && running == 0)
+			queueIdle.notify_all();
+	}
+}
+
+/*
+The source fills the part of the chunk inside the world, then the spare rows and columns past the far edges
+repeat the last real ones
+*/
+TerrainPager::FinishedChunk TerrainPager::
+GenerateChunk(size_t key) const
+{
+	TerrainRegion region;
+	region.firstX = (key % chunksX) * settings.chunkSegments;
+	region.firstZ = (key / chunksX) * settings.chunkSegments;
+	region.endX = std::min(region.firstX + chunkVerts, worldVertsX);
+	region.endZ = std::min(region.firstZ + chunkVerts, worldVertsZ);
+
+	const size_t width = region.endX - region.firstX;
+	const size_t rows = region.endZ - region.firstZ;
+
+	std::shared_ptr<std::vector<Vertex>> vertices = std::make_shared<std::vector<Vertex>>(chunkVerts * chunkVerts);
+	source(region, vertices->data());
+
+	//spread the source's rows (width long) out to chunkVerts long, from the last so nothing gets overwritten early
+	if (width < chunkVerts || rows < chunkVerts)
+	{
+		Vertex* data = vertices->data();
+		for (size_t z = chunkVerts; z > 0; --z)
+		{
+			const Vertex* sourceRow = data + (std::min(z, rows) - 1) * width;
+			for (size_t x = chunkVerts; x > 0; --x)
+			{
+				data[(z - 1) * chunkVerts + x - 1] = sourceRow[std::min(x, width) - 1];
+			}
+		}
+	}
+
+	FinishedChunk chunk;
+	chunk.minCorner = glm::vec3(std::numeric_limits<float>::max());
+	chunk.maxCorner = glm::vec3(-std::numeric_limits<float>::max());
+	for (const Vertex& vertex : *vertices)
+	{
+		chunk.minCorner = glm::min(chunk.minCorner, vertex.p);
+		chunk.maxCorner = glm::max(chunk.maxCorner, vertex.p);
+	}
+	chunk.vertices = vertices;
+	return chunk;
+}
+
+/*
+Paced like a 60Hz render loop, so the workers get real time to keep up with the camera. The slot owners stand in
+for the GPU: every upload has to land in a slot that exists, and no two resident chunks may share one
+*/
+bool
+ReportTerrainPaging(TerrainPager& pager, const std::vector<glm::vec3>& path, double frameBudgetMs, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const auto frameTime = std::chrono::microseconds(16667);
+	const size_t budget = pager.SlotCount() * pager.ChunkBytes();
+
+	std::vector<TerrainChunkUpload> uploads;
+	std::vector<TerrainChunkDraw> draws;
+	std::vector<char> slotUsed(pager.SlotCount());
+
+	std::vector<double> times;
+	size_t slowFrames = 0, maxUploads = 0, maxResident = 0, maxPending = 0, badSlots = 0, overBudget = 0;
+
+	auto frame = [&](const glm::vec3& camera)
+	{
+		auto start = Clock::now();
+		pager.Update(camera, uploads);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		times.push_back(ms);
+		if (ms > frameBudgetMs)
+			slowFrames++;
+		maxUploads = std::max(maxUploads, uploads.size());
+
+		for (const auto& upload : uploads)
+		{
+			if (upload.slot >= pager.SlotCount() || upload.vertices->size() != pager.ChunkVertexCount())
+				badSlots++;
+		}
+
+		pager.ResidentChunks(draws);
+		std::fill(slotUsed.begin(), slotUsed.end(), 0);
+		for (const auto& draw : draws)
+		{
+			if (draw.slot >= slotUsed.size() || slotUsed[draw.slot]++)
+				badSlots++;
+		}
+
+		TerrainPagerStats stats = pager.Stats();
+		if (stats.residentBytes > budget || stats.residentBytes > pager.Settings().budgetBytes)
+			overBudget++;
+		maxResident = std::max(maxResident, stats.residentBytes);
+		maxPending = std::max(maxPending, stats.pendingBytes);
+
+		std::this_thread::sleep_until(start + frameTime);
+	};
+
+	for (const glm::vec3& camera : path)
+	{
+		frame(camera);
+	}
+
+	//hold the last position until nothing more arrives, then everything in range should be there
+	const glm::vec3 last = path.empty() ? glm::vec3(0) : path.back();
+	TerrainPagerStats stats = pager.Stats();
+	for (int settle = 0; settle < 10000 && stats.desiredResident < std::min(stats.desiredChunks, pager.SlotCount()); ++settle)
+	{
+		frame(last);
+		stats = pager.Stats();
+	}
+	pager.WaitIdle();
+	frame(last);
+	stats = pager.Stats();
+
+	//a busy machine can preempt the render thread mid-update, so the pass goes on the 95th percentile, not the worst
+	std::sort(times.begin(), times.end());
+	const double worstMs = times.back();
+	const double typicalMs = times[times.size() * 95 / 100];
+
+	out << "Terrain paging, " << path.size() << " frame path, " << pager.SlotCount() << " slots of " << pager.ChunkBytes() / 1024 << " KB ("
+		<< budget / (1024 * 1024) << " MB budget), radius " << pager.Settings().loadRadius << std::endl;
+	out << "  update: worst " << worstMs << " ms, 95th percentile " << typicalMs << " ms, " << slowFrames
+		<< " frames over " << frameBudgetMs << " ms" << std::endl;
+	out << "  uploads: at most " << maxUploads << " a frame (cap " << pager.Settings().maxUploadsPerFrame << "), "
+		<< stats.uploaded << " total, " << stats.evicted << " slots recycled" << std::endl;
+	out << "  resident: peak " << maxResident / 1024 << " KB, " << overBudget << " frames over budget, " << badSlots << " slot errors, "
+		<< "peak pending " << maxPending / 1024 << " KB" << std::endl;
+	out << "  requests: " << stats.requested << " made, " << stats.generated << " generated, " << stats.cancelled << " cancelled" << std::endl;
+
+	bool passed = typicalMs <= frameBudgetMs && overBudget == 0 && badSlots == 0 && maxUploads <= pager.Settings().maxUploadsPerFrame &&
+		stats.desiredResident == std::min(stats.desiredChunks, pager.SlotCount());
+	out << "  " << stats.desiredResident << "/" << stats.desiredChunks << " chunks in range resident at the end (" << pager.SlotCount() << " fit), "
+		<< (passed ? "PASS" : "FAIL") << std::endl;
+	return passed;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+
+/*
+Fills out with the vertices of region, row major. Called from the pager's worker threads, so it has to be
+safe to call from several at once (LazyTerrain::EvaluateRegion is)
+*/
+typedef std::function<void(const TerrainRegion& region, Vertex* out)> TerrainChunkSource;
+
+struct TerrainPagerSettings
+{
+	size_t chunkSegments{ 64 };                 //quads along a chunk edge, neighbours share their edge vertices
+	float loadRadius{ 2048.0f };                //world units from the camera to a chunk's centre, in x and z
+	size_t budgetBytes{ 48 * 1024 * 1024 };     //resident chunk vertices, which is also what the GPU slots add up to
+	unsigned int workerThreads{ 2 };
+	size_t maxQueued{ 16 };                     //chunks asked for but not uploaded yet, nearest first
+	size_t maxUploadsPerFrame{ 4 };             //caps the upload cost of a frame however fast the camera goes
+};
+
+/*
+A finished chunk for the caller to copy into GPU slot. Slots are recycled from evicted chunks, so every one is
+the same size and there is never a buffer created or freed while paging
+*/
+struct TerrainChunkUpload
+{
+	size_t slot;
+	size_t chunkX, chunkZ;
+	std::shared_ptr<const std::vector<Vertex>> vertices;
+};
+
+/*
+A resident chunk, for drawing: which slot holds it and its bounding box for culling
+*/
+struct TerrainChunkDraw
+{
+	size_t slot;
+	glm::vec3 minCorner, maxCorner;
+};
+
+struct TerrainPagerStats
+{
+	size_t requested{ 0 };  //chunks handed to the workers
+	size_t generated{ 0 };  //chunks the workers finished
+	size_t uploaded{ 0 };
+	size_t evicted{ 0 };    //resident chunks whose slot was recycled for another chunk
+	size_t cancelled{ 0 };  //asked for, then out of range before they were uploaded
+
+	size_t desiredChunks{ 0 };   //in range of the camera on the last update
+	size_t desiredResident{ 0 }; //of those, already on the GPU
+	size_t residentChunks{ 0 };
+	size_t residentBytes{ 0 };
+	size_t pendingChunks{ 0 };   //queued, being generated or waiting for upload
+	size_t pendingBytes{ 0 };    //finished chunk vertices still held on the CPU
+};
+
+/*
+Keeps the chunks of a big terrain that are near the camera on the GPU and nothing else. Update works out which
+chunks are in range, asks the workers for the missing ones nearest first, hands back a frame's worth of
+finished ones to upload and drops requests the camera has moved away from.
+
+Resident chunks sit in an LRU list, the ones in range get touched every update. A chunk needing a slot takes a
+free one, or the least recently used chunk's if that one is out of range. The slots add up to the byte budget,
+so residency can never go over it; when everything in range won't fit, the furthest chunks just wait.
+
+Every chunk has (chunkSegments + 1)^2 vertices. Chunks along the far edges of the world repeat their last
+row/column into the spare ones, which only makes zero-area triangles, so one index buffer fits every chunk.
+
+Update and the getters are for one thread (the render thread); the workers only ever see the request queue
+*/
+class TerrainPager
+{
+public:
+	TerrainPager(size_t worldVertsX, size_t worldVertsZ, int worldSizeX, int worldSizeZ, TerrainChunkSource source,
+		const TerrainPagerSettings& settings);
+
+	~TerrainPager();
+
+	void
+	Update(const glm::vec3& camera, std::vector<TerrainChunkUpload>& uploads);
+
+	void
+	ResidentChunks(std::vector<TerrainChunkDraw>& draws) const;
+
+	/*
+	Blocks until the workers have nothing queued or running, for the report
+	*/
+	void
+	WaitIdle();
+
+	size_t
+	SlotCount() const { return slotCount; }
+
+	size_t
+	ChunkVertexCount() const { return chunkVerts * chunkVerts; }
+
+	size_t
+	ChunkBytes() const { return ChunkVertexCount() * sizeof(Vertex); }
+
+	const std::vector<uint32_t>&
+	ChunkIndices() const { return indices; }
+
+	const TerrainPagerSettings&
+	Settings() const { return settings; }
+
+	TerrainPagerStats
+	Stats() const;
+
+private:
+
+	typedef std::list<size_t> UsageList; //chunk keys, most recently used at the front
+
+	struct ResidentChunk
+	{
+		size_t slot;
+		glm::vec3 minCorner, maxCorner;
+		UsageList::iterator usage;
+	};
+
+	struct FinishedChunk
+	{
+		std::shared_ptr<const std::vector<Vertex>> vertices;
+		glm::vec3 minCorner, maxCorner;
+	};
+
+	void
+	WorkerLoop();
+
+	FinishedChunk
+	GenerateChunk(size_t key) const;
+
+	glm::vec2
+	ChunkCentre(size_t chunkX, size_t chunkZ) const;
+
+	bool
+	TakeSlot(size_t& slot);
+
+	TerrainChunkSource source;
+	TerrainPagerSettings settings;
+	size_t worldVertsX, worldVertsZ;
+	int worldSizeX, worldSizeZ;
+	size_t chunkVerts, chunksX, chunksZ;
+	size_t slotCount;
+	std::vector<uint32_t> indices;
+
+	//render thread only
+	std::unordered_map<size_t, ResidentChunk> resident;
+	UsageList usage;
+	std::vector<size_t> freeSlots;
+	std::unordered_set<size_t> desired;
+	std::vector<std::pair<float, size_t>> wanted; //distance and key of the chunks in range, nearest first
+	std::unordered_set<size_t> inFlight;          //queued or being generated or finished, not uploaded
+	TerrainPagerStats stats;
+
+	//shared with the workers
+	mutable std::mutex queueMutex;
+	std::condition_variable queueReady;
+	std::condition_variable queueIdle;
+	std::deque<size_t> queue;
+	std::unordered_map<size_t, FinishedChunk> finished;
+	size_t running{ 0 };
+	bool shuttingDown{ false };
+	std::vector<std::thread> workers;
+};
+
+/*
+Flies a scripted camera path over a pager with no GPU behind it and checks every frame that residency stays
+inside the budget, no frame uploads more than maxUploadsPerFrame and Update stays under frameBudgetMs (95th percentile), and
+that once the camera stops everything in range becomes resident. Returns whether all of that held
+*/
+bool
+ReportTerrainPaging(TerrainPager& pager, const std::vector<glm::vec3>& path, double frameBudgetMs, std::ostream& out);
@@ -0,0 +1,578 @@
+#include "MyTerrainQuery.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+bool TerrainHeightQuery::
+Build(const Vertex* vertices, size_t vertsX, size_t vertsZ, int targetSizeX, int targetSizeZ)
+{
+	if (vertsX < 2 || vertsZ < 2)
+	{
+		std::cerr << "Terrain queries need at least a 2x2 grid" << std::endl;
+		return false;
+	}
+
+	this->vertsX = vertsX;
+	this->vertsZ = vertsZ;
+	spacingX = targetSizeX / (float)vertsX; //same spacing GridPosition gives out
+	spacingZ = targetSizeZ / (float)vertsZ;
+
+	heights.resize(vertsX * vertsZ);
+	normals.resize(vertsX * vertsZ);
+	for (size_t i = 0; i < heights.size(); ++i)
+	{
+		heights[i] = vertices[i].p.y;
+		normals[i] = vertices[i].n;
+	}
+
+	levelCellsX.assign(1, vertsX - 1);
+	levelCellsZ.assign(1, vertsZ - 1);
+	while (levelCellsX.back() > 1 || levelCellsZ.back() > 1)
+	{
+		levelCellsX.push_back((levelCellsX.back() + 1) / 2);
+		levelCellsZ.push_back((levelCellsZ.back() + 1) / 2);
+	}
+
+	pyramid.assign(levelCellsX.size(), std::vector<Range>());
+	for (size_t level = 0; level < pyramid.size(); ++level)
+	{
+		pyramid[level].resize(levelCellsX[level] * levelCellsZ[level]);
+	}
+
+	TerrainRegion all;
+	all.endX = vertsX;
+	all.endZ = vertsZ;
+	UpdateRegion(vertices, all);
+	return true;
+}
+
+void TerrainHeightQuery::
+UpdateRegion(const Vertex* vertices, const TerrainRegion& region)
+{
+	if (region.Empty() || pyramid.empty())
+		return;
+
+	for (size_t z = region.firstZ; z < region.endZ; ++z)
+	{
+		for (size_t x = region.firstX; x < region.endX; ++x)
+		{
+			heights[z * vertsX + x] = vertices[z * vertsX + x].p.y;
+			normals[z * vertsX + x] = vertices[z * vertsX + x].n;
+		}
+	}
+
+	//cells share their corner vertices, so the cells just before the region see it too
+	size_t firstX = region.firstX > 0 ? region.firstX - 1 : 0;
+	size_t firstZ = region.firstZ > 0 ? region.firstZ - 1 : 0;
+	size_t lastX = std::min(region.endX - 1, levelCellsX[0] - 1);
+	size_t lastZ = std::min(region.endZ - 1, levelCellsZ[0] - 1);
+
+	for (size_t z = firstZ; z <= lastZ; ++z)
+	{
+		for (size_t x = firstX; x <= lastX; ++x)
+		{
+			CellRange(x, z);
+		}
+	}
+
+	for (size_t level = 1; level < pyramid.size(); ++level)
+	{
+		firstX /= 2;
+		firstZ /= 2;
+		lastX /= 2;
+		lastZ /= 2;
+		for (size_t z = firstZ; z <= lastZ; ++z)
+		{
+			for (size_t x = firstX; x <= lastX; ++x)
+			{
+				ParentRange(x, z, level);
+			}
+		}
+	}
+}
+
+void TerrainHeightQuery::
+CellRange(size_t cellX, size_t cellZ)
+{
+	const float* row = &heights[cellZ * vertsX + cellX];
+	const float* next = row + vertsX;
+
+	Range& range = pyramid[0][cellZ * levelCellsX[0] + cellX];
+	range.minY = std::min(std::min(row[0], row[1]), std::min(next[0], next[1]));
+	range.maxY = std::max(std::max(row[0], row[1]), std::max(next[0], next[1]));
+}
+
+void TerrainHeightQuery::
+ParentRange(size_t nodeX, size_t nodeZ, size_t level)
+{
+	Range& range = pyramid[level][nodeZ * levelCellsX[level] + nodeX];
+	range.minY = FLT_MAX;
+	range.maxY = -FLT_MAX;
+
+	for (int q = 0; q < 4; ++q)
+	{
+		size_t cx = nodeX * 2 + (q & 1), cz = nodeZ * 2 + (q >> 1);
+		if (cx >= levelCellsX[level - 1] || cz >= levelCellsZ[level - 1])
+			continue;
+
+		const Range& child = pyramid[level - 1][cz * levelCellsX[level - 1] + cx];
+		range.minY = std::min(range.minY, child.minY);
+		range.maxY = std::max(range.maxY, child.maxY);
+	}
+}
+
+/*
+Grid coordinates to a cell and the position inside it. Anything off the grid is clamped onto the edge
+*/
+void TerrainHeightQuery::
+Cell(float gridX, float gridZ, size_t& cellX, size_t& cellZ, float& fx, float& fz) const
+{
+	gridX = std::min(std::max(gridX, 0.0f), (float)(vertsX - 1));
+	gridZ = std::min(std::max(gridZ, 0.0f), (float)(vertsZ - 1));
+
+	cellX = std::min((size_t)gridX, vertsX - 2);
+	cellZ = std::min((size_t)gridZ, vertsZ - 2);
+	fx = gridX - cellX;
+	fz = gridZ - cellZ;
+}
+
+/*
+Barycentric weights of the triangle (x, z) is in. The fx >= fz half is v00 v10 v11, the rest v00 v11 v01
+*/
+static inline void
+TriangleWeights(float fx, float fz, float& w00, float& w10, float& w01, float& w11)
+{
+	if (fx >= fz)
+	{
+		w00 = 1 - fx;
+		w10 = fx - fz;
+		w01 = 0;
+		w11 = fz;
+	}
+	else
+	{
+		w00 = 1 - fz;
+		w10 = 0;
+		w01 = fz - fx;
+		w11 = fx;
+	}
+}
+
+glm::vec3 TerrainHeightQuery::
+BlendNormal(size_t cellX, size_t cellZ, float fx, float fz) const
+{
+	float w00, w10, w01, w11;
+	TriangleWeights(fx, fz, w00, w10, w01, w11);
+
+	const glm::vec3* row = &normals[cellZ * vertsX + cellX];
+	const glm::vec3* next = row + vertsX;
+	return glm::normalize(row[0] * w00 + row[1] * w10 + next[0] * w01 + next[1] * w11);
+}
+
+TerrainSample TerrainHeightQuery::
+Sample(float worldX, float worldZ) const
+{
+	const float gridX = worldX / spacingX, gridZ = -worldZ / spacingZ;
+
+	size_t cellX, cellZ;
+	float fx, fz;
+	Cell(gridX, gridZ, cellX, cellZ, fx, fz);
+
+	TerrainSample sample;
+	sample.height = Height(worldX, worldZ);
+	sample.normal = BlendNormal(cellX, cellZ, fx, fz);
+	sample.inside = gridX >= 0 && gridZ >= 0 && gridX <= vertsX - 1 && gridZ <= vertsZ - 1;
+	return sample;
+}
+
+float TerrainHeightQuery::
+Height(float worldX, float worldZ) const
+{
+	size_t cellX, cellZ;
+	float fx, fz;
+	Cell(worldX / spacingX, -worldZ / spacingZ, cellX, cellZ, fx, fz);
+
+	float w00, w10, w01, w11;
+	TriangleWeights(fx, fz, w00, w10, w01, w11);
+
+	const float* row = &heights[cellZ * vertsX + cellX];
+	const float* next = row + vertsX;
+	return row[0] * w00 + row[1] * w10 + next[0] * w01 + next[1] * w11;
+}
+
+/*
+Bilinear between the grid vertices, what the LOD shader's linear fetch from the heightfield gives at a vertex
+the morph has moved off the grid
+*/
+float TerrainHeightQuery::
+GridHeight(float gridX, float gridZ) const
+{
+	size_t cellX, cellZ;
+	float fx, fz;
+	Cell(gridX, gridZ, cellX, cellZ, fx, fz);
+
+	const float* row = &heights[cellZ * vertsX + cellX];
+	const float* next = row + vertsX;
+	return (row[0] * (1 - fx) + row[1] * fx) * (1 - fz) + (next[0] * (1 - fx) + next[1] * fx) * fz;
+}
+
+/*
+Vertex (i, j) of a level's node mesh, as grid x, height and grid z: placed at its stride, morphed by its own
+distance from the camera and clamped to the last vertex, the same steps terrain_lod_vs.glsl takes. Node and
+quadrant indices are multiples of leafQuads / 2, which is even, so odd within a node is odd on the grid too
+*/
+glm::vec3 TerrainHeightQuery::
+MorphedVertex(size_t i, size_t j, int level, const LodSelection& selection, const glm::vec3& cameraPosition) const
+{
+	const float stride = (float)(1 << level);
+	const float lastX = (float)(vertsX - 1), lastZ = (float)(vertsZ - 1);
+	const float gridX = std::min(i * stride, lastX), gridZ = std::min(j * stride, lastZ);
+
+	const glm::vec3 world(gridX * spacingX, heights[(size_t)gridZ * vertsX + (size_t)gridX], -gridZ * spacingZ);
+	const float start = selection.morphStart[level], end = selection.morphEnd[level];
+	const float morph = std::min(std::max((glm::length(world - cameraPosition) - start) / (end - start), 0.0f), 1.0f);
+
+	const float morphedX = std::min((i - (i & 1) * morph) * stride, lastX);
+	const float morphedZ = std::min((j - (j & 1) * morph) * stride, lastZ);
+	return glm::vec3(morphedX, GridHeight(morphedX, morphedZ), morphedZ);
+}
+
+/*
+Barycentric on the xz plane, with the same sort of slack RayTriangle has for the crack between two triangles
+*/
+static inline bool
+TriangleHeight(float x, float z, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& height)
+{
+	const float kEdgeSlack = 1e-5f;
+
+	const float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+	if (std::fabs(area) < 1e-12f)
+		return false;
+
+	const float wb = ((x - a.x) * (c.z - a.z) - (c.x - a.x) * (z - a.z)) / area;
+	const float wc = ((b.x - a.x) * (z - a.z) - (x - a.x) * (b.z - a.z)) / area;
+	if (wb < -kEdgeSlack || wc < -kEdgeSlack || wb + wc > 1 + kEdgeSlack)
+		return false;
+
+	height = a.y * (1 - wb - wc) + b.y * wb + c.y * wc;
+	return true;
+}
+
+/*
+The morph only ever slides a vertex back by less than its stride, and never the ones on a node or quadrant
+edge, so the point is in the cell it would be in unmorphed or one either side of it, at its own level
+*/
+float TerrainHeightQuery::
+DrawnHeight(float worldX, float worldZ, int level, const LodSelection& selection, const glm::vec3& cameraPosition) const
+{
+	const float gridX = std::min(std::max(worldX / spacingX, 0.0f), (float)(vertsX - 1));
+	const float gridZ = std::min(std::max(-worldZ / spacingZ, 0.0f), (float)(vertsZ - 1));
+	const size_t stride = (size_t)1 << level;
+	const size_t cellsX = (vertsX - 2) / stride + 1, cellsZ = (vertsZ - 2) / stride + 1;
+	const size_t cellX = std::min((size_t)gridX / stride, cellsX - 1), cellZ = std::min((size_t)gridZ / stride, cellsZ - 1);
+
+	const int kSearch[3] = { 0, -1, 1 };
+	for (int dz : kSearch)
+	{
+		for (int dx : kSearch)
+		{
+			if ((dx < 0 && cellX == 0) || (dz < 0 && cellZ == 0) || cellX + dx >= cellsX || cellZ + dz >= cellsZ)
+				continue;
+
+			const size_t i = cellX + dx, j = cellZ + dz;
+			const glm::vec3 v00 = MorphedVertex(i, j, level, selection, cameraPosition);
+			const glm::vec3 v10 = MorphedVertex(i + 1, j, level, selection, cameraPosition);
+			const glm::vec3 v01 = MorphedVertex(i, j + 1, level, selection, cameraPosition);
+			const glm::vec3 v11 = MorphedVertex(i + 1, j + 1, level, selection, cameraPosition);
+
+			float height;
+			if (TriangleHeight(gridX, gridZ, v00, v10, v11, height) || TriangleHeight(gridX, gridZ, v00, v11, v01, height))
+				return height;
+		}
+	}
+	return Height(worldX, worldZ);
+}
+
+/*
+The map has a cell per half leaf node, the smallest piece Select ever draws, and holds the level drawn there
+*/
+void TerrainHeightQuery::
+DrawnHeightBatch(const TerrainLodTree& tree, const LodSelection& selection, const glm::vec3& cameraPosition,
+	const float* x, const float* z, float* out, size_t count) const
+{
+	const size_t half = (size_t)tree.LeafQuads() / 2;
+	const size_t mapX = (vertsX - 2) / half + 1, mapZ = (vertsZ - 2) / half + 1;
+	const uint8_t kNotDrawn = 0xFF;
+
+	std::vector<uint8_t> levels(mapX * mapZ, kNotDrawn);
+	for (const LodNode& node : selection.nodes)
+	{
+		const size_t cells = (size_t)1 << node.level;
+		for (int q = 0; q < 4; ++q)
+		{
+			if (!(node.quadrants & (1 << q)))
+				continue;
+
+			const size_t firstX = node.x / half + (q & 1) * cells, firstZ = node.z / half + (q >> 1) * cells;
+			for (size_t cz = firstZ; cz < std::min(firstZ + cells, mapZ); ++cz)
+			{
+				for (size_t cx = firstX; cx < std::min(firstX + cells, mapX); ++cx)
+				{
+					levels[cz * mapX + cx] = (uint8_t)node.level;
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float gridX = std::min(std::max(x[i] / spacingX, 0.0f), (float)(vertsX - 1));
+		const float gridZ = std::min(std::max(-z[i] / spacingZ, 0.0f), (float)(vertsZ - 1));
+		const size_t cx = std::min((size_t)gridX / half, mapX - 1), cz = std::min((size_t)gridZ / half, mapZ - 1);
+
+		const uint8_t level = levels[cz * mapX + cx];
+		out[i] = level == kNotDrawn ? Height(x[i], z[i]) : DrawnHeight(x[i], z[i], level, selection, cameraPosition);
+	}
+}
+
+size_t TerrainHeightQuery::
+LevelCount() const
+{
+	return pyramid.size();
+}
+
+/*
+The ray is moved into grid space (x and z in cells, z flipped to run down the rows, y untouched). It's a
+scale per axis so the distance along the ray comes out the same in either space
+*/
+bool TerrainHeightQuery::
+Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainHit& hit) const
+{
+	if (pyramid.empty())
+		return false;
+
+	const glm::vec3 gridOrigin(origin.x / spacingX, origin.y, -origin.z / spacingZ);
+	const glm::vec3 gridDirection(direction.x / spacingX, direction.y, -direction.z / spacingZ);
+
+	float tMax = maxDistance;
+	if (!RaycastNode(0, 0, pyramid.size() - 1, gridOrigin, gridDirection, tMax, hit))
+		return false;
+
+	hit.position = origin + direction * hit.distance;
+	return true;
+}
+
+bool TerrainHeightQuery::
+RaycastReference(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainHit& hit) const
+{
+	if (pyramid.empty())
+		return false;
+
+	const glm::vec3 gridOrigin(origin.x / spacingX, origin.y, -origin.z / spacingZ);
+	const glm::vec3 gridDirection(direction.x / spacingX, direction.y, -direction.z / spacingZ);
+
+	float tMax = maxDistance;
+	bool found = false;
+	for (size_t z = 0; z + 1 < vertsZ; ++z)
+	{
+		for (size_t x = 0; x + 1 < vertsX; ++x)
+		{
+			found |= RaycastCell(x, z, gridOrigin, gridDirection, tMax, hit);
+		}
+	}
+
+	if (found)
+		hit.position = origin + direction * hit.distance;
+	return found;
+}
+
+/*
+Slab test against the node's box, then the children nearest the ray origin first. A line only ever crosses
+one of the two diagonal quarters, so near-near, the two mixed ones and far-far is always front to back
+*/
+bool TerrainHeightQuery::
+RaycastNode(size_t nodeX, size_t nodeZ, size_t level, const glm::vec3& origin, const glm::vec3& direction, float& tMax, TerrainHit& hit) const
+{
+	const Range& range = pyramid[level][nodeZ * levelCellsX[level] + nodeX];
+	const glm::vec3 boxMin((float)(nodeX << level), range.minY, (float)(nodeZ << level));
+	const glm::vec3 boxMax((float)std::min((nodeX + 1) << level, vertsX - 1), range.maxY, (float)std::min((nodeZ + 1) << level, vertsZ - 1));
+
+	float tEnter = 0, tExit = tMax;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (direction[axis] == 0)
+		{
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+				return false;
+			continue;
+		}
+
+		float inverse = 1.0f / direction[axis];
+		float t0 = (boxMin[axis] - origin[axis]) * inverse;
+		float t1 = (boxMax[axis] - origin[axis]) * inverse;
+		if (t0 > t1)
+			std::swap(t0, t1);
+
+		tEnter = std::max(tEnter, t0);
+		tExit = std::min(tExit, t1);
+		if (tEnter > tExit)
+			return false;
+	}
+
+	if (level == 0)
+		return RaycastCell(nodeX, nodeZ, origin, direction, tMax, hit);
+
+	const size_t nearX = direction.x >= 0 ? 0 : 1;
+	const size_t nearZ = direction.z >= 0 ? 0 : 1;
+	const size_t order[4][2] = { { nearX, nearZ }, { 1 - nearX, nearZ }, { nearX, 1 - nearZ }, { 1 - nearX, 1 - nearZ } };
+
+	bool found = false;
+	for (int i = 0; i < 4; ++i)
+	{
+		size_t cx = nodeX * 2 + order[i][0], cz = nodeZ * 2 + order[i][1];
+		if (cx >= levelCellsX[level - 1] || cz >= levelCellsZ[level - 1])
+			continue;
+
+		found |= RaycastNode(cx, cz, level - 1, origin, direction, tMax, hit);
+	}
+	return found;
+}
+
+/*
+Moller-Trumbore against both triangles of the cell. The tiny slack on the edges stops rays slipping through
+the crack between two triangles to a hit further away
+*/
+static inline bool
+RayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t)
+{
+	const float kEdgeSlack = 1e-5f;
+
+	glm::vec3 edge1 = b - a, edge2 = c - a;
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (std::fabs(determinant) < 1e-12f)
+		return false;
+
+	float inverse = 1.0f / determinant;
+	glm::vec3 s = origin - a;
+	float u = glm::dot(s, p) * inverse;
+	if (u < -kEdgeSlack || u > 1 + kEdgeSlack)
+		return false;
+
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) * inverse;
+	if (v < -kEdgeSlack || u + v > 1 + kEdgeSlack)
+		return false;
+
+	t = glm::dot(edge2, q) * inverse;
+	return true;
+}
+
+bool TerrainHeightQuery::
+RaycastCell(size_t cellX, size_t cellZ, const glm::vec3& origin, const glm::vec3& direction, float& tMax, TerrainHit& hit) const
+{
+	const float* row = &heights[cellZ * vertsX + cellX];
+	const float* next = row + vertsX;
+	const float x0 = (float)cellX, z0 = (float)cellZ;
+
+	const glm::vec3 v00(x0, row[0], z0), v10(x0 + 1, row[1], z0);
+	const glm::vec3 v01(x0, next[0], z0 + 1), v11(x0 + 1, next[1], z0 + 1);
+
+	float best = tMax;
+	bool found = false;
+	float t;
+	if (RayTriangle(origin, direction, v00, v10, v11, t) && t >= 0 && t <= best)
+	{
+		best = t;
+		found = true;
+	}
+	if (RayTriangle(origin, direction, v00, v11, v01, t) && t >= 0 && t <= best)
+	{
+		best = t;
+		found = true;
+	}
+	if (!found)
+		return false;
+
+	tMax = best;
+	hit.distance = best;
+
+	glm::vec3 local = origin + direction * best;
+	float fx = std::min(std::max(local.x - x0, 0.0f), 1.0f);
+	float fz = std::min(std::max(local.z - z0, 0.0f), 1.0f);
+	hit.normal = BlendNormal(cellX, cellZ, fx, fz);
+	return true;
+}
+
+bool
+ReportTerrainQueries(const TerrainHeightQuery& query, int targetSizeX, int targetSizeZ, size_t queryCount, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const size_t kReferenceRays = 16;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<float> xs(queryCount), zs(queryCount);
+	for (size_t i = 0; i < queryCount; ++i)
+	{
+		xs[i] = unit(random) * targetSizeX;
+		zs[i] = -unit(random) * targetSizeZ;
+	}
+
+	auto start = Clock::now();
+	float checksum = 0;
+	for (size_t i = 0; i < queryCount; ++i)
+	{
+		checksum += query.Sample(xs[i], zs[i]).height;
+	}
+	double sampleNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queryCount;
+
+	start = Clock::now();
+	for (size_t i = 0; i < queryCount; ++i)
+	{
+		checksum += query.Height(xs[i], zs[i]);
+	}
+	double heightNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / queryCount;
+
+	//rays from well above the terrain, slanting down at up to 45 degrees
+	std::vector<glm::vec3> origins(queryCount), directions(queryCount);
+	for (size_t i = 0; i < queryCount; ++i)
+	{
+		origins[i] = glm::vec3(xs[i], 1000.0f, zs[i]);
+		directions[i] = glm::normalize(glm::vec3(unit(random) * 2 - 1, -1.0f, unit(random) * 2 - 1));
+	}
+
+	size_t hits = 0;
+	float worstError = 0;
+	TerrainHit hit;
+	start = Clock::now();
+	for (size_t i = 0; i < queryCount; ++i)
+	{
+		if (query.Raycast(origins[i], directions[i], 1e6f, hit))
+		{
+			hits++;
+			worstError = std::max(worstError, std::fabs(hit.position.y - query.Height(hit.position.x, hit.position.z)));
+		}
+	}
+	double rayUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queryCount;
+
+	size_t referenceMatches = 0;
+	for (size_t i = 0; i < kReferenceRays && i < queryCount; ++i)
+	{
+		TerrainHit reference;
+		bool fast = query.Raycast(origins[i], directions[i], 1e6f, hit);
+		bool slow = query.RaycastReference(origins[i], directions[i], 1e6f, reference);
+		if (fast == slow && (!fast || std::fabs(hit.distance - reference.distance) < 1e-3f))
+			referenceMatches++;
+	}
+
+	out << "Terrain queries (" << queryCount << ", pyramid of " << query.LevelCount() << " levels)" << std::endl;
+	out << "  sample: " << sampleNs << " ns, height: " << heightNs << " ns per point (checksum " << checksum << ")" << std::endl;
+	out << "  raycast: " << rayUs << " us per ray, " << hits << " hits, worst distance off the surface " << worstError << std::endl;
+	out << "  " << referenceMatches << "/" << std::min(kReferenceRays, queryCount) << " rays match testing every cell" << std::endl;
+	return worstError < 1e-3f && referenceMatches == std::min(kReferenceRays, queryCount);
+}
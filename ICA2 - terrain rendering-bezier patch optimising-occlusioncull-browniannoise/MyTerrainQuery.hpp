@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+#include "MyTerrainLod.hpp"
+
+/*
+Height, normal and ray queries against the finished terrain, for snapping shapes to the ground, keeping a
+camera above it and picking.
+
+The answers come from the same triangles that get drawn (both split along the v00-v11 diagonal, the same as
+the chunk and LOD index buffers), so something placed with Sample sits exactly on the ground you see. On the
+grid vertices that is the Bezier surface plus noise the build produced. A point lookup is a divide, a floor
+and one triangle, so it's O(1) whatever the grid size.
+
+That's only the ground you see while the full grid is drawn. Under CDLOD most of the terrain is a coarser
+level, up to LevelError off the full grid and sliding between levels with the morph, so a shape placed with
+Height floats or sinks by that much. DrawnHeightBatch follows the LOD mesh instead: the level each point is
+drawn at comes from the frame's selection, and the triangle it's under from that level's mesh, each corner
+morphed the way terrain_lod_vs.glsl does it. The heights between vertices are bilinear like the shader's
+texture fetch, so it's the drawn triangle up to the GPU's filtering precision.
+
+Rays walk a min/max height pyramid: level 0 holds the height range of each grid cell, every level above the
+range of a 2x2 block of the one below. A ray is tested against a node's box, and only nodes it actually
+passes through low enough to touch get opened, nearest child first, so the first triangle hit is the closest
+*/
+struct TerrainSample
+{
+	float height;
+	glm::vec3 normal;
+	bool inside; //false if (x, z) was off the grid and got clamped to the edge
+};
+
+struct TerrainHit
+{
+	float distance; //along the ray direction, in units of its length
+	glm::vec3 position;
+	glm::vec3 normal;
+};
+
+class TerrainHeightQuery
+{
+public:
+
+	bool
+	Build(const Vertex* vertices, size_t vertsX, size_t vertsZ, int targetSizeX, int targetSizeZ);
+
+	/*
+	Copies the new heights and normals in a region and refits the pyramid over it, for after an edit
+	*/
+	void
+	UpdateRegion(const Vertex* vertices, const TerrainRegion& region);
+
+	TerrainSample
+	Sample(float worldX, float worldZ) const;
+
+	float
+	Height(float worldX, float worldZ) const;
+
+	/*
+	Heights of the CDLOD surface drawn for selection, which the tree selected from cameraPosition. The
+	selection is turned into a map of drawn levels once for the whole batch, after that each point is O(1)
+	*/
+	void
+	DrawnHeightBatch(const TerrainLodTree& tree, const LodSelection& selection, const glm::vec3& cameraPosition,
+		const float* x, const float* z, float* out, size_t count) const;
+
+	/*
+	One point of DrawnHeightBatch, on the part of the selection drawn at level
+	*/
+	float
+	DrawnHeight(float worldX, float worldZ, int level, const LodSelection& selection, const glm::vec3& cameraPosition) const;
+
+	bool
+	Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainHit& hit) const;
+
+	/*
+	Same answer as Raycast by testing every cell, only here to check the pyramid against
+	*/
+	bool
+	RaycastReference(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TerrainHit& hit) const;
+
+	size_t
+	LevelCount() const;
+
+private:
+
+	struct Range
+	{
+		float minY, maxY;
+	};
+
+	void
+	CellRange(size_t cellX, size_t cellZ);
+
+	void
+	ParentRange(size_t nodeX, size_t nodeZ, size_t level);
+
+	bool
+	RaycastNode(size_t nodeX, size_t nodeZ, size_t level, const glm::vec3& origin, const glm::vec3& direction, float& tMax, TerrainHit& hit) const;
+
+	bool
+	RaycastCell(size_t cellX, size_t cellZ, const glm::vec3& origin, const glm::vec3& direction, float& tMax, TerrainHit& hit) const;
+
+	void
+	Cell(float gridX, float gridZ, size_t& cellX, size_t& cellZ, float& fx, float& fz) const;
+
+	glm::vec3
+	BlendNormal(size_t cellX, size_t cellZ, float fx, float fz) const;
+
+	float
+	GridHeight(float gridX, float gridZ) const;
+
+	glm::vec3
+	MorphedVertex(size_t i, size_t j, int level, const LodSelection& selection, const glm::vec3& cameraPosition) const;
+
+	size_t vertsX{ 0 }, vertsZ{ 0 };
+	float spacingX{ 1 }, spacingZ{ 1 };
+
+	std::vector<float> heights;
+	std::vector<glm::vec3> normals;
+
+	std::vector<size_t> levelCellsX, levelCellsZ; //nodes along each side, per level
+	std::vector<std::vector<Range>> pyramid;      //per level, row major
+};
+
+/*
+Times point queries and random downward rays. Returns whether every ray hit sits on the surface Height
+returns and the first few rays hit what testing every cell hits
+*/
+bool
+ReportTerrainQueries(const TerrainHeightQuery& query, int targetSizeX, int targetSizeZ, size_t queryCount, std::ostream& out);
@@ -0,0 +1,195 @@
+#include "MyTerrainTessellation.hpp"
+#include "MyPackedTerrain.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+bool TerrainTessellation::
+Build(const Vertex* controlPoints, size_t vertsX, size_t vertsZ, int targetSizeX, int targetSizeZ)
+{
+	if (vertsX < 4 || vertsZ < 4)
+	{
+		std::cerr << "Terrain tessellation needs at least one whole patch, the grid is " << vertsX << "x" << vertsZ << std::endl;
+		return false;
+	}
+
+	this->vertsX = vertsX;
+	this->vertsZ = vertsZ;
+	spacingX = (float)targetSizeX / (vertsX - 1);
+	spacingZ = (float)targetSizeZ / (vertsZ - 1);
+	patchesX = (int)(vertsX - 1) / 3;
+	patchesZ = (int)(vertsZ - 1) / 3;
+
+	heights.resize(vertsX * vertsZ);
+	UpdateHeights(controlPoints);
+
+	indices.clear();
+	indices.reserve((size_t)patchesX * patchesZ * kPatchPoints);
+	for (int pz = 0; pz < patchesZ; ++pz)
+	{
+		for (int px = 0; px < patchesX; ++px)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int column = 0; column < 4; ++column)
+				{
+					indices.push_back((uint32_t)((pz * 3 + row) * vertsX + px * 3 + column));
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void TerrainTessellation::
+UpdateHeights(const Vertex* controlPoints)
+{
+	for (size_t i = 0; i < heights.size(); ++i)
+	{
+		heights[i] = controlPoints[i].p.y;
+	}
+}
+
+glm::vec3 TerrainTessellation::
+ControlPosition(size_t x, size_t z) const
+{
+	return glm::vec3((float)x * spacingX, heights[z * vertsX + x], -((float)z * spacingZ));
+}
+
+/*
+Written out step by step in the same order terrain_tess_tcs.glsl does it
+*/
+float TerrainTessellation::
+EdgeLevel(const glm::vec3& a, const glm::vec3& b, const LodCamera& camera, const TessellationSettings& settings)
+{
+	const float pixelsPerUnit = camera.viewportHeight / (2.0f * std::tan(glm::radians(camera.verticalFovDegrees) * 0.5f)); //at a distance of 1
+
+	glm::vec3 centre = (a + b) * 0.5f;
+	float diameter = glm::length(b - a);
+	float distance = std::max(glm::length(centre - camera.position), 0.001f);
+	float pixels = diameter * pixelsPerUnit / distance;
+	return std::min(std::max(pixels / settings.pixelsPerSegment, 1.0f), settings.maxLevel);
+}
+
+PatchTessLevels TerrainTessellation::
+PatchLevels(int patchX, int patchZ, const LodCamera& camera, const TessellationSettings& settings) const
+{
+	const size_t x = (size_t)patchX * 3;
+	const size_t z = (size_t)patchZ * 3;
+	const glm::vec3 c00 = ControlPosition(x, z);
+	const glm::vec3 c30 = ControlPosition(x + 3, z);
+	const glm::vec3 c03 = ControlPosition(x, z + 3);
+	const glm::vec3 c33 = ControlPosition(x + 3, z + 3);
+
+	PatchTessLevels levels;
+	levels.outer[0] = EdgeLevel(c00, c03, camera, settings);
+	levels.outer[1] = EdgeLevel(c00, c30, camera, settings);
+	levels.outer[2] = EdgeLevel(c30, c33, camera, settings);
+	levels.outer[3] = EdgeLevel(c03, c33, camera, settings);
+	levels.inner[0] = std::max(levels.outer[1], levels.outer[3]);
+	levels.inner[1] = std::max(levels.outer[0], levels.outer[2]);
+	return levels;
+}
+
+size_t TerrainTessellation::
+GpuBytes() const
+{
+	return heights.size() * sizeof(float) + indices.size() * sizeof(uint32_t);
+}
+
+bool
+ReportTessellation(const TerrainTessellation& tessellation, const std::vector<LodCamera>& cameras, const TessellationSettings& settings,
+	size_t hiResVerts, std::ostream& out)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const int patchesX = tessellation.PatchesX();
+	const int patchesZ = tessellation.PatchesZ();
+
+	out << "Terrain tessellation, " << patchesX << "x" << patchesZ << " bicubic patches, " << settings.pixelsPerSegment
+		<< " pixels a segment, levels up to " << settings.maxLevel << std::endl;
+
+	bool crackFree = true;
+	std::vector<PatchTessLevels> levels((size_t)patchesX * patchesZ);
+	for (const LodCamera& camera : cameras)
+	{
+		auto start = Clock::now();
+		for (int pz = 0; pz < patchesZ; ++pz)
+		{
+			for (int px = 0; px < patchesX; ++px)
+			{
+				levels[pz * patchesX + px] = tessellation.PatchLevels(px, pz, camera, settings);
+			}
+		}
+		double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+		//a shared edge is the u = 1 / u = 0 pair across x, and v = 1 / v = 0 across z
+		size_t edges = 0, mismatched = 0, maxedOut = 0;
+		for (int pz = 0; pz < patchesZ; ++pz)
+		{
+			for (int px = 0; px < patchesX; ++px)
+			{
+				const PatchTessLevels& patch = levels[pz * patchesX + px];
+				if (px + 1 < patchesX)
+				{
+					edges++;
+					if (patch.outer[2] != levels[pz * patchesX + px + 1].outer[0])
+						mismatched++;
+				}
+				if (pz + 1 < patchesZ)
+				{
+					edges++;
+					if (patch.outer[3] != levels[(pz + 1) * patchesX + px].outer[1])
+						mismatched++;
+				}
+				for (float outer : patch.outer)
+				{
+					if (outer >= settings.maxLevel)
+						maxedOut++;
+				}
+			}
+		}
+
+		//the corners either way round have to give the same bits too, the shader doesn't sort them
+		size_t unordered = 0;
+		for (int pz = 0; pz < patchesZ; ++pz)
+		{
+			for (int px = 0; px < patchesX; ++px)
+			{
+				glm::vec3 a = tessellation.ControlPosition(px * 3, pz * 3);
+				glm::vec3 b = tessellation.ControlPosition(px * 3 + 3, pz * 3);
+				glm::vec3 c = tessellation.ControlPosition(px * 3, pz * 3 + 3);
+				if (TerrainTessellation::EdgeLevel(a, b, camera, settings) != TerrainTessellation::EdgeLevel(b, a, camera, settings) ||
+					TerrainTessellation::EdgeLevel(a, c, camera, settings) != TerrainTessellation::EdgeLevel(c, a, camera, settings))
+					unordered++;
+			}
+		}
+
+		//fractional odd spacing rounds each level up to the next odd number of segments
+		double triangles = 0;
+		for (const PatchTessLevels& patch : levels)
+		{
+			double u = 2 * std::ceil((patch.inner[0] - 1) * 0.5) + 1;
+			double v = 2 * std::ceil((patch.inner[1] - 1) * 0.5) + 1;
+			triangles += 2 * u * v;
+		}
+
+		crackFree = crackFree && mismatched == 0 && unordered == 0;
+		out << "  camera at height " << camera.position.y << ": about " << (size_t)triangles << " triangles, " << maxedOut
+			<< " edges at the max level, " << mismatched << "/" << edges << " shared edges mismatched, " << unordered
+			<< " order dependent, levels " << us << " us on the CPU" << std::endl;
+	}
+
+	const size_t hiResQuads = (hiResVerts - 1) * (hiResVerts - 1);
+	const size_t hiResIndices = hiResQuads * 6 * sizeof(uint32_t);
+	const size_t gridBytes = hiResVerts * hiResVerts * sizeof(Vertex) + hiResIndices;
+	const size_t packedBytes = hiResVerts * hiResVerts * sizeof(PackedVertex) + hiResIndices;
+	const size_t lodBytes = hiResVerts * hiResVerts * sizeof(glm::vec4) + TerrainLodTree::BuildNodeIndices(LodSettings().leafQuads).size() * sizeof(uint16_t);
+	const size_t tessellatedBytes = tessellation.GpuBytes();
+
+	auto megabytes = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+	out << "  GPU memory: " << hiResVerts << "^2 Vertex grid " << megabytes(gridBytes) << " MB, packed " << megabytes(packedBytes)
+		<< " MB, LOD heightfield " << megabytes(lodBytes) << " MB, tessellated patches " << megabytes(tessellatedBytes) << " MB ("
+		<< (double)gridBytes / tessellatedBytes << "x less than the Vertex grid)" << std::endl;
+	return crackFree;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MyTerrain.hpp"
+#include "MyTerrainLod.hpp"
+
+/*
+Hardware tessellation of the base heightmap's bicubic patches, as an alternative to building and uploading the
+dense hi-res grid. All the GPU gets is one height per control point and 16 indices per patch; the tessellation
+evaluation shader works out the Bezier surface and its normal from the derivatives, the same maths
+SeparableInterpolation does on the CPU. The noise detail isn't in it, this is the bare patch surface.
+
+Patches are 3 segments wide and share their edge control points, like DefinePatches. Control point x is spread
+over the world as x * worldSize / segments, so the surface lines up with the hi-res grid (whose last vertex
+stops a sample short of the far edge). Any segments past the last whole patch aren't drawn.
+
+Levels come from how long an edge looks on screen: the edge's span between its two corners, as a sphere at its
+midpoint, projected at that distance and divided into pixelsPerSegment pieces. That only depends on the two
+corners, and the order they come in doesn't change a bit of it, so the patches either side of an edge always
+pick the same level and the tessellated edges meet vertex for vertex. The control shader runs the same
+expressions (marked precise, so they can't get fused differently in each copy); EdgeLevel and PatchLevels are
+here so it can be checked without a GPU
+*/
+struct TessellationSettings
+{
+	float pixelsPerSegment{ 8.0f }; //screen length each tessellated edge piece aims for
+	float maxLevel{ 64.0f };        //GL_MAX_TESS_GEN_LEVEL is at least 64
+};
+
+/*
+GL's order for quads: outer 0 is the u = 0 edge, 1 is v = 0, 2 is u = 1, 3 is v = 1. inner 0 runs along u
+*/
+struct PatchTessLevels
+{
+	float outer[4];
+	float inner[2];
+};
+
+class TerrainTessellation
+{
+public:
+
+	static const int kPatchPoints = 16;
+
+	bool
+	Build(const Vertex* controlPoints, size_t vertsX, size_t vertsZ, int targetSizeX, int targetSizeZ);
+
+	/*
+	New heights from the same grid, after an edit of the base terrain. The indices don't change
+	*/
+	void
+	UpdateHeights(const Vertex* controlPoints);
+
+	static float
+	EdgeLevel(const glm::vec3& a, const glm::vec3& b, const LodCamera& camera, const TessellationSettings& settings);
+
+	PatchTessLevels
+	PatchLevels(int patchX, int patchZ, const LodCamera& camera, const TessellationSettings& settings) const;
+
+	/*
+	World position of a control point, as the vertex shader works it out from gl_VertexID
+	*/
+	glm::vec3
+	ControlPosition(size_t x, size_t z) const;
+
+	const std::vector<float>&
+	Heights() const { return heights; }
+
+	const std::vector<uint32_t>&
+	PatchIndices() const { return indices; }
+
+	int
+	PatchesX() const { return patchesX; }
+
+	int
+	PatchesZ() const { return patchesZ; }
+
+	size_t
+	VertsX() const { return vertsX; }
+
+	glm::vec2
+	Spacing() const { return glm::vec2(spacingX, spacingZ); }
+
+	/*
+	Vertex and index buffer bytes
+	*/
+	size_t
+	GpuBytes() const;
+
+private:
+
+	size_t vertsX{ 0 }, vertsZ{ 0 };
+	float spacingX{ 1 }, spacingZ{ 1 };
+	int patchesX{ 0 }, patchesZ{ 0 };
+	std::vector<float> heights;    //one per control point, row major
+	std::vector<uint32_t> indices; //kPatchPoints per patch, rows of v then points along u
+};
+
+/*
+The levels picked for each camera and the triangles they make, and the GPU memory against the hi-res paths
+for a hiResVerts square grid. Returns whether every shared edge got the same level from both of its patches
+and every edge the same level with its corners either way round
+*/
+bool
+ReportTessellation(const TerrainTessellation& tessellation, const std::vector<LodCamera>& cameras, const TessellationSettings& settings,
+	size_t hiResVerts, std::ostream& out);
@@ -0,0 +1,110 @@
+#include "MyThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if (threadCount == 0) //hardware_concurrency is allowed to return 0 when it cannot tell
+		threadCount = 1;
+
+	for (unsigned int i = 1; i < threadCount; ++i) //the calling thread is the first worker
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		shuttingDown = true;
+	}
+	jobReady.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned int ThreadPool::
+ThreadCount() const
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+/*
+Splits [0, count) into chunks of roughly a quarter of each thread's share so that uneven rows
+still balance out, then blocks until every chunk is finished
+*/
+void ThreadPool::
+ParallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& task)
+{
+	if (count == 0)
+		return;
+
+	if (workers.empty())
+	{
+		task(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobTask = &task;
+		jobCount = count;
+		jobChunkSize = count / (ThreadCount() * 4);
+		if (jobChunkSize == 0)
+			jobChunkSize = 1;
+		nextChunk = 0;
+		busyWorkers = (unsigned int)workers.size();
+		jobGeneration++;
+	}
+	jobReady.notify_all();
+
+	RunChunks();
+
+	std::unique_lock<std::mutex> lock(jobMutex);
+	jobDone.wait(lock, [this] { return busyWorkers == 0; });
+	jobTask = nullptr;
+}
+
+void ThreadPool::
+RunChunks()
+{
+	for (;;)
+	{
+		size_t begin = nextChunk.fetch_add(1) * jobChunkSize;
+		if (begin >= jobCount)
+			return;
+
+		size_t end = begin + jobChunkSize;
+		if (end > jobCount)
+			end = jobCount;
+
+		(*jobTask)(begin, end);
+	}
+}
+
+void ThreadPool::
+WorkerLoop()
+{
+	unsigned int seenGeneration = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobReady.wait(lock, [&] { return shuttingDown || jobGeneration != seenGeneration; });
+			if (shuttingDown)
+				return;
+			seenGeneration = jobGeneration;
+		}
+
+		RunChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			busyWorkers--;
+		}
+		jobDone.notify_one();
+	}
+}
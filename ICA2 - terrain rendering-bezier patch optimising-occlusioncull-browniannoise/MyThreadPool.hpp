@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/*
+Fixed-size worker pool used by the terrain build. A job is a range of rows which gets cut into
+contiguous chunks, so every worker walks its own band of the grid and never writes into another band.
+The calling thread joins in on the work, so a pool of one thread is just the serial loop
+*/
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	unsigned int
+	ThreadCount() const;
+
+	void
+	ParallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& task);
+
+private:
+
+	void
+	WorkerLoop();
+
+	void
+	RunChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+
+	const std::function<void(size_t, size_t)>* jobTask{ nullptr };
+	size_t jobCount{ 0 };
+	size_t jobChunkSize{ 1 };
+	std::atomic<size_t> nextChunk{ 0 };
+	unsigned int jobGeneration{ 0 };
+	unsigned int busyWorkers{ 0 };
+	bool shuttingDown{ false };
+};
@@ -0,0 +1,216 @@
+#include "MyTiledTerrain.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+TiledTerrainBuilder::TiledTerrainBuilder(HeightmapSource& source, const TiledBuildSettings& settings)
+	: source(source), settings(settings), vertsX(0), vertsZ(0), tileSize(0)
+{
+}
+
+/*
+Rough upper bound of what one tile needs: the band of source rows, the band stretched across the tile,
+the tile's heights with apron, a row of noise, and the finished vertices
+*/
+size_t TiledTerrainBuilder::
+EstimatePeakBytes(size_t tileSize, size_t sourceWidth, size_t sourceSegmentsZ, size_t targetSizeZ)
+{
+	size_t apron = tileSize + 3;
+	size_t bandRows = apron * sourceSegmentsZ / (targetSizeZ + 1) + 7; //+7 covers the patch snapping and the last patch's control points
+
+	return bandRows * sourceWidth * sizeof(float) +
+		bandRows * apron * sizeof(float) +
+		apron * apron * sizeof(float) +
+		apron * 2 * sizeof(float) +
+		(tileSize + 1) * (tileSize + 1) * sizeof(Vertex);
+}
+
+std::string TiledTerrainBuilder::
+TilePath(const std::string& directory, size_t tileX, size_t tileZ)
+{
+	std::ostringstream path;
+	path << directory << "/tile_" << tileX << "_" << tileZ << ".bin";
+	return path.str();
+}
+
+bool TiledTerrainBuilder::
+Build(TiledBuildResult& result)
+{
+	const size_t sourceWidth = source.Width();
+	const size_t sourceHeight = source.Height();
+
+	if (sourceWidth < 4 || sourceHeight < 4)
+	{
+		std::cerr << "Tiled build needs at least one 4x4 patch of source heights" << std::endl;
+		return false;
+	}
+
+	vertsX = settings.targetSizeX + 1;
+	vertsZ = settings.targetSizeZ + 1;
+	columns = utilAyre::BuildBernsteinTable(sourceWidth - 1, vertsX);
+	rows = utilAyre::BuildBernsteinTable(sourceHeight - 1, vertsZ);
+
+	tileSize = std::max<size_t>(settings.tileSize, 1);
+	while (tileSize > 16 && EstimatePeakBytes(tileSize, sourceWidth, sourceHeight - 1, settings.targetSizeZ) > settings.memoryBudget)
+	{
+		tileSize /= 2;
+	}
+	if (EstimatePeakBytes(tileSize, sourceWidth, sourceHeight - 1, settings.targetSizeZ) > settings.memoryBudget)
+		std::cerr << "Memory budget is below what a " << tileSize << " tile needs, going over it" << std::endl;
+
+	result = TiledBuildResult();
+	result.tileSize = tileSize;
+
+	const size_t tilesX = (settings.targetSizeX + tileSize - 1) / tileSize;
+	const size_t tilesZ = (settings.targetSizeZ + tileSize - 1) / tileSize;
+
+	for (size_t tz = 0; tz < tilesZ; ++tz)
+	{
+		tileFirstZ = tz * tileSize;
+		tileVertsZ = std::min(tileSize + 1, vertsZ - tileFirstZ);
+		apronFirstZ = tileFirstZ > 0 ? tileFirstZ - 1 : 0;
+		size_t apronLastZ = std::min(tileFirstZ + tileVertsZ, vertsZ - 1);
+		apronVertsZ = apronLastZ - apronFirstZ + 1;
+
+		//every tile in this row reads the same source rows, so read them once
+		size_t bandFirst = rows.offsets[apronFirstZ];
+		size_t bandRows = rows.offsets[apronLastZ] + 4 - bandFirst;
+		band.resize(bandRows * sourceWidth);
+		if (!source.ReadRows(bandFirst, bandRows, band.data()))
+		{
+			std::cerr << "Failed to read heightmap rows " << bandFirst << "-" << bandFirst + bandRows << std::endl;
+			return false;
+		}
+
+		for (size_t tx = 0; tx < tilesX; ++tx)
+		{
+			tileFirstX = tx * tileSize;
+			tileVertsX = std::min(tileSize + 1, vertsX - tileFirstX);
+			apronFirstX = tileFirstX > 0 ? tileFirstX - 1 : 0;
+			size_t apronLastX = std::min(tileFirstX + tileVertsX, vertsX - 1);
+			apronVertsX = apronLastX - apronFirstX + 1;
+
+			BuildTile(bandFirst);
+			if (!WriteTile(tx, tz))
+				return false;
+
+			result.tilesWritten++;
+			result.peakBytes = std::max(result.peakBytes, CurrentBytes());
+		}
+	}
+	return true;
+}
+
+void TiledTerrainBuilder::
+BuildTile(size_t bandFirstRow)
+{
+	const size_t sourceWidth = source.Width();
+	const size_t bandRows = band.size() / sourceWidth;
+
+	horizontal.resize(bandRows * apronVertsX);
+	for (size_t r = 0; r < bandRows; ++r)
+	{
+		for (size_t i = 0; i < apronVertsX; ++i)
+		{
+			size_t x = apronFirstX + i;
+			horizontal[r * apronVertsX + i] = utilAyre::BernsteinFilter(&band[r * sourceWidth + columns.offsets[x]], 1, columns.weights[x]);
+		}
+	}
+
+	//noise runs a row at a time through the batch kernel, the columns' world x is the same for every row
+	noiseColumns.resize(apronVertsX);
+	noiseRow.resize(apronVertsX);
+	for (size_t i = 0; i < apronVertsX; ++i)
+	{
+		noiseColumns[i] = TerrainGL::GridPosition(apronFirstX + i, 0, vertsX, (float)vertsZ, settings.worldSizeX, settings.worldSizeZ).x;
+	}
+
+	heights.resize(apronVertsZ * apronVertsX);
+	for (size_t j = 0; j < apronVertsZ; ++j)
+	{
+		size_t z = apronFirstZ + j;
+		const float* taps = &horizontal[(rows.offsets[z] - bandFirstRow) * apronVertsX];
+
+		if (settings.applyNoise)
+		{
+			float worldZ = TerrainGL::GridPosition(0, z, vertsX, (float)vertsZ, settings.worldSizeX, settings.worldSizeZ).z;
+			utilAyre::GradientFbmGrid(noiseColumns.data(), apronVertsX, &worldZ, 1, noiseRow.data(), settings.noise);
+		}
+
+		for (size_t i = 0; i < apronVertsX; ++i)
+		{
+			float height = utilAyre::BernsteinFilter(taps + i, apronVertsX, rows.weights[z]);
+
+			if (settings.applyNoise)
+				height += noiseRow[i];
+
+			heights[j * apronVertsX + i] = height;
+		}
+	}
+
+	//the same central differences as CalculateGridNormals but across the apron, one-sided at the edges of the world
+	tile.resize(tileVertsX * tileVertsZ);
+	for (size_t j = 0; j < tileVertsZ; ++j)
+	{
+		size_t z = tileFirstZ + j;
+		size_t zUp = z > 0 ? z - 1 : z;
+		size_t zDown = z + 1 < vertsZ ? z + 1 : z;
+
+		for (size_t i = 0; i < tileVertsX; ++i)
+		{
+			size_t x = tileFirstX + i;
+			size_t xLeft = x > 0 ? x - 1 : x;
+			size_t xRight = x + 1 < vertsX ? x + 1 : x;
+
+			auto position = [&](size_t px, size_t pz)
+			{
+				glm::vec3 p = TerrainGL::GridPosition(px, pz, vertsX, (float)vertsZ, settings.worldSizeX, settings.worldSizeZ);
+				p.y = heights[(pz - apronFirstZ) * apronVertsX + (px - apronFirstX)];
+				return p;
+			};
+
+			Vertex& vertex = tile[j * tileVertsX + i];
+			vertex.p = position(x, z);
+			vertex.n = TerrainGL::GridNormal(position(xLeft, z), position(xRight, z), position(x, zUp), position(x, zDown));
+			vertex.globalUV = glm::vec2((float)x / vertsX, (float)z / vertsZ);
+			vertex.localUV = glm::vec2((float)i / (tileVertsX - 1), (float)j / (tileVertsZ - 1));
+		}
+	}
+}
+
+bool TiledTerrainBuilder::
+WriteTile(size_t tileX, size_t tileZ)
+{
+	std::string path = TilePath(settings.outputDirectory, tileX, tileZ);
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Could not write terrain tile " << path << std::endl;
+		return false;
+	}
+
+	TerrainTileHeader header;
+	header.magic[0] = 'T'; header.magic[1] = 'T'; header.magic[2] = 'I'; header.magic[3] = 'L';
+	header.version = 1;
+	header.tileX = (uint32_t)tileX;
+	header.tileZ = (uint32_t)tileZ;
+	header.firstVertexX = (uint32_t)tileFirstX;
+	header.firstVertexZ = (uint32_t)tileFirstZ;
+	header.vertsX = (uint32_t)tileVertsX;
+	header.vertsZ = (uint32_t)tileVertsZ;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)tile.data(), (std::streamsize)(tile.size() * sizeof(Vertex)));
+	return (bool)file;
+}
+
+size_t TiledTerrainBuilder::
+CurrentBytes() const
+{
+	return band.capacity() * sizeof(float) +
+		horizontal.capacity() * sizeof(float) +
+		heights.capacity() * sizeof(float) +
+		(noiseColumns.capacity() + noiseRow.capacity()) * sizeof(float) +
+		tile.capacity() * sizeof(Vertex);
+}
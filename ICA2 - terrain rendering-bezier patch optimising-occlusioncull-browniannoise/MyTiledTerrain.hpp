@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MyTerrain.hpp"
+#include "MyHeightmapSource.hpp"
+
+/*
+Settings for building a terrain too big to hold in memory. Sizes are in segments like TerrainGL's meshSize,
+so a 16383 target gives a 16384 vertex wide world
+*/
+struct TiledBuildSettings
+{
+	size_t targetSizeX{ 16383 };
+	size_t targetSizeZ{ 16383 };
+	int worldSizeX{ 8192 };
+	int worldSizeZ{ 8192 };
+	size_t tileSize{ 256 }; //segments per tile edge, shrunk automatically if it won't fit the budget
+	size_t memoryBudget{ 64 * 1024 * 1024 };
+	bool applyNoise{ true };
+	utilAyre::NoiseSettings noise;
+	std::string outputDirectory{ "." };
+};
+
+struct TiledBuildResult
+{
+	size_t tilesWritten{ 0 };
+	size_t tileSize{ 0 };
+	size_t peakBytes{ 0 };
+};
+
+/*
+Every tile file starts with this, followed by vertsX * vertsZ Vertex records in row order.
+Neighbouring tiles share their edge row/column of vertices so each can be meshed on its own
+*/
+struct TerrainTileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t tileX, tileZ;
+	uint32_t firstVertexX, firstVertexZ;
+	uint32_t vertsX, vertsZ;
+};
+
+/*
+Out-of-core version of the hi-res build. The source is pulled in one band of rows per row of tiles, and each
+tile is interpolated with a one-patch apron of control points around it (plus a one-vertex apron of heights
+for the normals) so the seams come out exactly as a single big build would have them. Finished tiles go
+straight to disk, so peak memory depends on the tile size, not the world size
+*/
+class TiledTerrainBuilder
+{
+public:
+	TiledTerrainBuilder(HeightmapSource& source, const TiledBuildSettings& settings);
+
+	bool
+	Build(TiledBuildResult& result);
+
+	static size_t
+	EstimatePeakBytes(size_t tileSize, size_t sourceWidth, size_t sourceSegmentsZ, size_t targetSizeZ);
+
+	static std::string
+	TilePath(const std::string& directory, size_t tileX, size_t tileZ);
+
+private:
+
+	void
+	BuildTile(size_t bandFirstRow);
+
+	bool
+	WriteTile(size_t tileX, size_t tileZ);
+
+	size_t
+	CurrentBytes() const;
+
+	HeightmapSource& source;
+	TiledBuildSettings settings;
+
+	size_t vertsX, vertsZ;
+	size_t tileSize;
+	utilAyre::BernsteinTable columns, rows;
+
+	std::vector<float> band;         //source rows feeding the current row of tiles
+	std::vector<float> horizontal;   //band rows stretched to the tile's width
+	std::vector<float> heights;      //final heights of the tile plus its apron
+	std::vector<float> noiseColumns; //world x of each apron column
+	std::vector<float> noiseRow;     //noise heights for the row being built
+	std::vector<Vertex> tile;        //what gets written out
+
+	size_t tileFirstX, tileFirstZ, tileVertsX, tileVertsZ;
+	size_t apronFirstX, apronFirstZ, apronVertsX, apronVertsZ;
+};
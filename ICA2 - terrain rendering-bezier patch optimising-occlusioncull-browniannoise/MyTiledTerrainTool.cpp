@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "MyTiledTerrain.hpp"
+
+#ifdef TERRAIN_TILES_MAIN
+/*
+Standalone entry point for the out-of-core build, the terrain_tiles target in CMakeLists.txt. Writes the tiles
+TiledTerrainBuilder makes from a heightmap into a directory that has to exist already:
+	terrain_tiles heightmap output_directory [--size n] [--world n] [--tile n] [--budget mb] [--no-noise]
+--size is the target in segments along each side, --world the world size along each side
+*/
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: terrain_tiles heightmap output_directory [--size n] [--world n] [--tile n] [--budget mb] [--no-noise]" << std::endl;
+		return 1;
+	}
+
+	TiledBuildSettings settings;
+	settings.outputDirectory = argv[2];
+
+	for (int i = 3; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+			settings.targetSizeX = settings.targetSizeZ = (size_t)std::atoll(argv[++i]);
+		else if (std::strcmp(argv[i], "--world") == 0 && hasValue)
+			settings.worldSizeX = settings.worldSizeZ = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--tile") == 0 && hasValue)
+			settings.tileSize = (size_t)std::atoll(argv[++i]);
+		else if (std::strcmp(argv[i], "--budget") == 0 && hasValue)
+			settings.memoryBudget = (size_t)std::atoll(argv[++i]) * 1024 * 1024;
+		else if (std::strcmp(argv[i], "--no-noise") == 0)
+			settings.applyNoise = false;
+		else
+		{
+			std::cerr << "unknown argument " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	std::unique_ptr<HeightmapSource> source = OpenHeightmapSource(argv[1]);
+	if (!source)
+		return 1;
+
+	TiledBuildResult result;
+	TiledTerrainBuilder builder(*source, settings);
+	if (!builder.Build(result))
+		return 1;
+
+	std::cout << result.tilesWritten << " tiles of " << result.tileSize << " segments written to " << settings.outputDirectory
+		<< ", peak " << result.peakBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+	return 0;
+}
+#endif
@@ -4,6 +4,63 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <memory>
+#include "MyTerrainCache.hpp"
+#include "MyPackedTerrain.hpp"
+#include "MyLazyTerrain.hpp"
+
+static const char* kTerrainCacheFile = "terrain.cache";
+static const int kHiResTerrainSize = 1023; //segments in the interpolated terrain that actually gets drawn
+static const float kTerrainBrushRadius = 200.0f;
+static const float kAdaptiveMaxError = 1.0f; //world units, an eighth of the hi-res vertex spacing
+static const bool kFusedTerrainBuild = true; //one tiled pass instead of make mesh, interpolation and noise, same bits either way
+static const int kPagedTerrainSize = 4095;
+
+/*
+Compiles and links any set of stages from file (type and file name), printing any log the same way the
+programs above do
+*/
+static GLuint
+CompileProgram(const std::vector<std::pair<GLenum, const char*>>& stages)
+{
+    GLint compile_status = 0;
+    GLint link_status = 0;
+    const int string_length = 1024;
+    GLchar log[string_length] = "";
+
+    GLuint program = glCreateProgram();
+
+    for (const auto& stage : stages)
+    {
+        GLuint shader = glCreateShader(stage.first);
+        std::string shader_string = tygra::stringFromFile(stage.second);
+        const char *shader_code = shader_string.c_str();
+        glShaderSource(shader, 1, (const GLchar **)&shader_code, NULL);
+        glCompileShader(shader);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+        if (compile_status != GL_TRUE) {
+            glGetShaderInfoLog(shader, string_length, NULL, log);
+            std::cerr << stage.second << ": " << log << std::endl;
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+    if (link_status != GL_TRUE) {
+        glGetProgramInfoLog(program, string_length, NULL, log);
+        std::cerr << log << std::endl;
+    }
+    return program;
+}
+
+static GLuint
+CompileProgram(const char* vertexFile, const char* fragmentFile)
+{
+    return CompileProgram({ { GL_VERTEX_SHADER, vertexFile }, { GL_FRAGMENT_SHADER, fragmentFile } });
+}
 
 MyView::
 MyView()
@@ -21,12 +78,45 @@ setScene(std::shared_ptr<const SceneModel::Context> scene)
     scene_ = scene;
 }
 
+void MyView::
+setTerrainPaging(bool enabled)
+{
+    terrain_paging_ = enabled;
+}
+
 void MyView::
 toggleShading()
 {
     shade_normals_ = !shade_normals_;
 }
 
+void MyView::
+toggleTessellation()
+{
+    tessellation_enabled_ = !tessellation_enabled_;
+}
+
+void MyView::
+toggleLod()
+{
+    lod_enabled_ = !lod_enabled_;
+}
+
+void MyView::
+cycleIndexMode()
+{
+    static const char* const names[] = { "MakeMesh list", "strips", "16-bit stripe chunks", "culled chunks", "adaptive" };
+    index_mode_ = index_mode_ == IndexMode::Adaptive ? IndexMode::Triangles : (IndexMode)((int)index_mode_ + 1);
+    index_mode_changed_ = true;
+    std::cout << "Terrain index buffer: " << names[(int)index_mode_] << std::endl;
+}
+
+void MyView::
+stampTerrainBrush(float strength)
+{
+    pending_brush_strength_ += strength;
+}
+
 void MyView::
 windowViewWillStart(std::shared_ptr<tygra::Window> window)
 {
@@ -122,6 +212,11 @@ windowViewWillStart(std::shared_ptr<tygra::Window> window)
         std::cerr << log << std::endl;
     }
 
+    terrain_packed_sp_ = CompileProgram("terrain_packed_vs.glsl", "terrain_fs.glsl");
+    terrain_lod_sp_ = CompileProgram("terrain_lod_vs.glsl", "terrain_fs.glsl");
+    terrain_tess_sp_ = CompileProgram({ { GL_VERTEX_SHADER, "terrain_tess_vs.glsl" }, { GL_TESS_CONTROL_SHADER, "terrain_tess_tcs.glsl" },
+        { GL_TESS_EVALUATION_SHADER, "terrain_tess_tes.glsl" }, { GL_FRAGMENT_SHADER, "terrain_fs.glsl" } });
+
     glGenVertexArrays(1, &cube_vao_);
     glBindVertexArray(cube_vao_);
     glGenBuffers(1, &cube_vbo_);
@@ -152,31 +247,383 @@ windowViewWillStart(std::shared_ptr<tygra::Window> window)
     const float sizeY = scene_->getTerrainSizeY();
 	const float sizeZ = scene_->getTerrainSizeZ();
 
-    tygra::Image height_image = tygra::imageFromPNG(scene_->getTerrainHeightMapName());
-	TerrainGL baseTerrain(255, 255, sizeX, sizeZ);
-	baseTerrain.ApplyHeightMap(height_image); //apply the height map using the function which assumes a vertex-per-pixel size
+	/*
+	The finished terrain is cached on disk keyed by everything that goes into it. On a warm start the cache is
+	mapped and handed straight to GL, skipping the PNG decode and the whole build
+	*/
+	typedef std::chrono::high_resolution_clock Clock;
+	auto terrain_start = Clock::now();
+	startup_time_ = terrain_start;
+
+	const std::string height_map_name = scene_->getTerrainHeightMapName();
+	utilAyre::NoiseSettings terrain_noise;
+
+	if (terrain_paging_)
+	{
+		StartTerrainPaging(terrain_noise);
+		return;
+	}
+
+	uint64_t height_map_hash = 0;
+	HashFile(height_map_name, height_map_hash);
+	const uint64_t cache_key = TerrainCacheKey(height_map_hash, kHiResTerrainSize, kHiResTerrainSize, (int)sizeX, (int)sizeZ, terrain_noise);
+	terrain_cache_key_ = cache_key;
+
+	MappedTerrainCache terrain_cache;
+	if (terrain_cache.Open(kTerrainCacheFile, cache_key))
+	{
+		const size_t vertex_count = (size_t)terrain_cache.Header().vertexCount;
+		const size_t element_count = (size_t)terrain_cache.Header().elementCount;
+		UploadHiResTerrain(terrain_cache.Vertices(), terrain_cache.Elements(), vertex_count, element_count);
+
+		double startup_ms = std::chrono::duration<double, std::milli>(Clock::now() - terrain_start).count();
+		std::cout << "Terrain startup: warm " << startup_ms << " ms (cached), cold " << terrain_cache.Header().buildMilliseconds << " ms (full build)" << std::endl;
+		build_profiler_.Report(std::cout);
+		return;
+	}
+
+	/*
+	Cold start: the base heightmap mesh goes up straight away so there's something to draw on the first frame,
+	and the hi-res build runs on a worker. Nothing on this thread waits for it, so the first frame costs the same
+	whatever the hi-res size is; windowViewRender swaps the full terrain in once it's done
+	*/
+	LoadBaseTerrain(); //one vertex per heightmap pixel, a flat base if the map couldn't be read
+	UploadPreviewTerrain();
+
+	terrain_build_ = std::async(std::launch::async, [this, cache_key, terrain_noise, terrain_start]()
+	{
+		return BuildHiResTerrain(cache_key, terrain_noise, terrain_start);
+	});
+}
+
+/*
+The cold build, run on the worker thread windowViewWillStart starts. It only touches base_terrain_ (read only
+until the build is collected), hires_terrain_ and the profiler, none of which the render thread goes near
+while terrain_build_ is still running. Returns whether the cache got written
+*/
+bool MyView::
+BuildHiResTerrain(uint64_t cache_key, utilAyre::NoiseSettings terrain_noise, std::chrono::high_resolution_clock::time_point terrain_start)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const float sizeX = scene_->getTerrainSizeX();
+	const float sizeZ = scene_->getTerrainSizeZ();
+
+	ThreadPool buildPool; //one worker per hardware thread, the output matches the serial build bit for bit
+
+	//called from the workers, at most a few times a stage, so one write per line keeps them from interleaving
+	BuildProgress build_progress([](BuildStage stage, float fraction)
+	{
+		std::cout << "Terrain build: " + std::string(BuildStageName(stage)) + " " + std::to_string((int)(fraction * 100)) + "%\n";
+	}, 4);
+
+	if (kFusedTerrainBuild)
+	{
+		const size_t hires_vertices = (size_t)(kHiResTerrainSize + 1) * (kHiResTerrainSize + 1);
+		hires_terrain_.reset(new TerrainGL());
+		hires_terrain_->noiseSettings = terrain_noise;
+		hires_terrain_->progress = &build_progress;
+
+		build_progress.BeginStage(BuildStage::Fused, hires_vertices);
+		BuildProfiler::Scope stage(build_profiler_, BuildStage::Fused, hires_vertices);
+		hires_terrain_->FusedBuild(base_terrain_.get(), kHiResTerrainSize, kHiResTerrainSize, sizeX, sizeZ, buildPool);
+	}
+	else
+	{
+		build_profiler_.Begin(BuildStage::MakeMesh);
+		hires_terrain_.reset(new TerrainGL(kHiResTerrainSize, kHiResTerrainSize, sizeX, sizeZ));
+		build_profiler_.End(BuildStage::MakeMesh, hires_terrain_->terrain_data.size());
+
+		const size_t hires_vertices = hires_terrain_->terrain_data.size();
+		hires_terrain_->noiseSettings = terrain_noise;
+		hires_terrain_->analyticNormals = true; //the normals come out of the interpolation and noise passes
+		hires_terrain_->progress = &build_progress;
+		{
+			build_progress.BeginStage(BuildStage::Interpolation, hires_vertices);
+			BuildProfiler::Scope stage(build_profiler_, BuildStage::Interpolation, hires_vertices);
+			hires_terrain_->SeparableInterpolation(base_terrain_.get(), buildPool); //interpolate the height map control points across a new, higher resolution mesh
+		}
+		{
+			build_progress.BeginStage(BuildStage::Noise, hires_vertices);
+			BuildProfiler::Scope stage(build_profiler_, BuildStage::Noise, hires_vertices);
+			hires_terrain_->ApplyNoise(buildPool);
+		}
+	}
+	hires_terrain_->progress = nullptr;
+
+	#ifdef TERRAIN_SCALING_REPORT
+		TerrainGL::ReportThreadScaling(base_terrain_.get(), kHiResTerrainSize, kHiResTerrainSize, sizeX, sizeZ, std::cout);
+	#endif
+	#ifdef TERRAIN_FUSED_REPORT
+		TerrainGL::ReportFusedBuild(base_terrain_.get(), kHiResTerrainSize, kHiResTerrainSize, sizeX, sizeZ, terrain_noise, std::cout);
+	#endif
+	#ifdef TERRAIN_NOISE_REPORT
+		utilAyre::ReportNoiseBenchmark(hires_terrain_->terrain_data.size(), terrain_noise, std::cout);
+	#endif
+	#ifdef TERRAIN_BEZIER_REPORT
+		utilAyre::ReportBezierDegrees(1000000, std::cout);
+	#endif
+	#ifdef TERRAIN_LAZY_REPORT
+	{
+		LazyTerrainSettings lazy_settings;
+		lazy_settings.targetSizeX = kHiResTerrainSize;
+		lazy_settings.targetSizeZ = kHiResTerrainSize;
+		lazy_settings.worldSizeX = (int)sizeX;
+		lazy_settings.worldSizeZ = (int)sizeZ;
+		lazy_settings.noise = terrain_noise;
+		LazyTerrain lazy(*base_terrain_, lazy_settings);
+		ReportLazyTerrain(lazy, *hires_terrain_, std::cout);
+	}
+	#endif
+
+	double cold_build_ms = std::chrono::duration<double, std::milli>(Clock::now() - terrain_start).count();
+	return WriteTerrainCache(kTerrainCacheFile, cache_key, *hires_terrain_, cold_build_ms);
+}
+
+/*
+The base heightmap mesh as it is, as a stand-in until the hi-res build is done. Only the normals are worked
+out on top of the heights, and it's drawn with the plain Vertex layout and MakeMesh's indices
+*/
+void MyView::
+UploadPreviewTerrain()
+{
+	base_terrain_->CalculateGridNormals();
+
+	const std::vector<Vertex>& vertices = base_terrain_->terrain_data;
+	const std::vector<int>& elements = base_terrain_->terrain_elements;
+
+	glGenVertexArrays(1, &preview_mesh_.vao);
+	glBindVertexArray(preview_mesh_.vao);
+
+	glGenBuffers(1, &preview_mesh_.element_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, preview_mesh_.element_vbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(int), elements.data(), GL_STATIC_DRAW);
+	preview_mesh_.element_count = (int)elements.size();
+
+	glGenBuffers(1, &preview_mesh_.position_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, preview_mesh_.position_vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(kVertexPosition);
+	glVertexAttribPointer(kVertexPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(0));
+	glEnableVertexAttribArray(kVertexNormal);
+	glVertexAttribPointer(kVertexNormal, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(12));
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	//shapes sit on the preview ground until the real one arrives
+	terrain_query_.Build(vertices.data(), base_terrain_->verts_x, (size_t)base_terrain_->verts_z, (int)scene_->getTerrainSizeX(), (int)scene_->getTerrainSizeZ());
+}
+
+/*
+Paging skips the cache and the hi-res build altogether. The base heightmap still gets loaded for the shape
+queries, and the slots are all made here at the full budget so paging never creates or frees a buffer
+*/
+void MyView::
+StartTerrainPaging(const utilAyre::NoiseSettings& terrain_noise)
+{
+	const int sizeX = (int)scene_->getTerrainSizeX();
+	const int sizeZ = (int)scene_->getTerrainSizeZ();
+
+	LoadBaseTerrain();
+	UploadPreviewTerrain();
+
+	LazyTerrainSettings lazy_settings;
+	lazy_settings.targetSizeX = kPagedTerrainSize;
+	lazy_settings.targetSizeZ = kPagedTerrainSize;
+	lazy_settings.worldSizeX = sizeX;
+	lazy_settings.worldSizeZ = sizeZ;
+	lazy_settings.noise = terrain_noise;
+	paged_terrain_.reset(new LazyTerrain(*base_terrain_, lazy_settings));
+
+	LazyTerrain* source = paged_terrain_.get();
+	TerrainPagerSettings pager_settings;
+	terrain_pager_.reset(new TerrainPager(source->VertsX(), source->VertsZ(), sizeX, sizeZ,
+		[source](const TerrainRegion& region, Vertex* out) { source->EvaluateRegion(region, out); }, pager_settings));
+
+	#ifdef TERRAIN_PAGING_REPORT
+	{
+		//twenty seconds at 60Hz across the world, swinging north and south, on a pager of its own
+		std::vector<glm::vec3> path;
+		for (int frame = 0; frame < 1200; ++frame)
+		{
+			float t = frame / 1200.0f;
+			path.push_back(glm::vec3(sizeX * (0.1f + 0.8f * t), 300.0f, -sizeZ * (0.5f + 0.4f * std::sin(t * 6.2832f))));
+		}
+		TerrainPager flight(source->VertsX(), source->VertsZ(), sizeX, sizeZ,
+			[source](const TerrainRegion& region, Vertex* out) { source->EvaluateRegion(region, out); }, pager_settings);
+		ReportTerrainPaging(flight, path, 2.0, std::cout);
+	}
+	#endif
+
+	const std::vector<uint32_t>& indices = terrain_pager_->ChunkIndices();
+	glGenBuffers(1, &page_element_vbo_);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page_element_vbo_);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	page_slots_.resize(terrain_pager_->SlotCount());
+	for (auto& slot : page_slots_)
+	{
+		glGenVertexArrays(1, &slot.vao);
+		glBindVertexArray(slot.vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page_element_vbo_); //shared, DeleteMesh only sees the 0 in the slot
+		slot.element_count = (int)indices.size();
+
+		glGenBuffers(1, &slot.position_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, slot.position_vbo);
+		glBufferData(GL_ARRAY_BUFFER, terrain_pager_->ChunkBytes(), nullptr, GL_DYNAMIC_DRAW);
+		glEnableVertexAttribArray(kVertexPosition);
+		glVertexAttribPointer(kVertexPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(0));
+		glEnableVertexAttribArray(kVertexNormal);
+		glVertexAttribPointer(kVertexNormal, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(12));
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	std::cout << "Terrain paging: " << source->VertsX() << "x" << source->VertsZ() << " vertices, " << page_slots_.size()
+		<< " chunk slots of " << terrain_pager_->ChunkBytes() / 1024 << " KB" << std::endl;
+}
+
+/*
+Called at the start of every frame. Once the worker has finished, the hi-res terrain goes up in one go and the
+preview is thrown away
+*/
+void MyView::
+CollectHiResTerrain()
+{
+	if (!terrain_build_.valid() || terrain_build_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	if (!terrain_build_.get())
+		std::cerr << "Could not write the terrain cache to " << kTerrainCacheFile << std::endl;
+
+	UploadHiResTerrain(hires_terrain_->terrain_data.data(), hires_terrain_->terrain_elements.data(),
+		hires_terrain_->terrain_data.size(), hires_terrain_->terrain_elements.size());
+	DeleteMesh(preview_mesh_);
+
+	double full_quality_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startup_time_).count();
+	std::cout << "Terrain startup: cold, first frame " << first_frame_ms_ << " ms, full quality " << full_quality_ms
+		<< " ms (built in the background, cache written to " << kTerrainCacheFile << ")" << std::endl;
+	build_profiler_.Report(std::cout);
+}
+
+void MyView::
+DeleteMesh(MeshGL& mesh)
+{
+	glDeleteBuffers(1, &mesh.position_vbo);
+	glDeleteBuffers(1, &mesh.element_vbo);
+	glDeleteVertexArrays(1, &mesh.vao);
+	mesh = MeshGL();
+}
+
+/*
+Everything the hi-res terrain needs on the GPU and for the queries, from the cache on a warm start or from the
+finished build on a cold one
+*/
+void MyView::
+UploadHiResTerrain(const Vertex* vertices, const int* elements, size_t vertex_count, size_t element_count)
+{
+	const float sizeX = scene_->getTerrainSizeX();
+	const float sizeZ = scene_->getTerrainSizeZ();
+
+	terrain_query_.Build(vertices, kHiResTerrainSize + 1, kHiResTerrainSize + 1, (int)sizeX, (int)sizeZ);
+	#ifdef TERRAIN_QUERY_REPORT
+		ReportTerrainQueries(terrain_query_, (int)sizeX, (int)sizeZ, 100000, std::cout);
+	#endif
+
+	#ifdef TERRAIN_ADAPTIVE_REPORT
+		ReportAdaptiveMesh(vertices, kHiResTerrainSize + 1, kHiResTerrainSize + 1, { 0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f }, std::cout);
+	#endif
+
+	#ifdef TERRAIN_INDEX_REPORT
+		ReportIndexOrderings(kHiResTerrainSize + 1, kHiResTerrainSize + 1, std::vector<int>(elements, elements + element_count), std::cout);
+	#endif
 
-	TerrainGL hiResTerrain(1023, 1023, sizeX, sizeZ);
-	hiResTerrain.PieceWiseInterpolation(&baseTerrain); //interpolate the height map control points across a new, higher resolution mesh
-	hiResTerrain.CalculateNormals();
-	hiResTerrain.ApplyNoise();
-	hiResTerrain.CalculateNormals();
+	//only the mode being drawn goes up now, the other one waits until it's toggled to
+	if (lod_enabled_)
+		UploadTerrainLod(vertices, vertex_count);
+	else
+		UploadTerrainGrid(vertices, elements, vertex_count, element_count);
+
+	hires_ready_ = true;
+}
 
-	const auto& elements = hiResTerrain.terrain_elements;
-	const auto& vertices = hiResTerrain.terrain_data;
+/*
+The full detail grid: the index buffer for index_mode_ and the vertex buffer, packed or not
+*/
+void MyView::
+UploadTerrainGrid(const Vertex* vertices, const int* elements, size_t vertex_count, size_t element_count)
+{
+	const float sizeX = scene_->getTerrainSizeX();
+	const float sizeZ = scene_->getTerrainSizeZ();
 
+	//GL copies the data on the driver side and may not have sent it yet, so upload is the cost of handing it over
+	build_profiler_.Begin(BuildStage::Upload);
     glGenBuffers(1, &terrain_mesh_.element_vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain_mesh_.element_vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		elements.size() * sizeof(unsigned int),
-		elements.data(), GL_STATIC_DRAW);
+	if (index_mode_ == IndexMode::Strips)
+	{
+		std::vector<uint32_t> strips = BuildTriangleStrips(kHiResTerrainSize + 1, kHiResTerrainSize + 1);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, strips.size() * sizeof(uint32_t), strips.data(), GL_STATIC_DRAW);
+		terrain_mesh_.element_count = (int)strips.size();
+	}
+	else if (index_mode_ == IndexMode::Culled)
+	{
+		terrain_chunks_ = BuildTerrainChunks(vertices, kHiResTerrainSize + 1, kHiResTerrainSize + 1, kTerrainChunkQuads);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrain_chunks_.indices.size() * sizeof(uint16_t), terrain_chunks_.indices.data(), GL_STATIC_DRAW);
+		terrain_mesh_.element_count = (int)terrain_chunks_.indices.size();
+		std::vector<uint16_t>().swap(terrain_chunks_.indices); //on the GPU now, only the boxes and ranges are needed
+	}
+	else if (index_mode_ == IndexMode::Adaptive)
+	{
+		AdaptiveMesh adaptive;
+		adaptive_mesher_.Build(vertices, kHiResTerrainSize + 1, kHiResTerrainSize + 1);
+		adaptive_mesher_.Extract(kAdaptiveMaxError, adaptive);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, adaptive.indices.size() * sizeof(uint32_t), adaptive.indices.data(), GL_STATIC_DRAW);
+		terrain_mesh_.element_count = (int)adaptive.indices.size();
+	}
+	else if (index_mode_ == IndexMode::Chunks16)
+	{
+		ChunkedIndices16 chunked = BuildChunkedIndices16(kHiResTerrainSize + 1, kHiResTerrainSize + 1, kDefaultStripeWidth);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, chunked.indices.size() * sizeof(uint16_t), chunked.indices.data(), GL_STATIC_DRAW);
+		terrain_mesh_.element_count = (int)chunked.indices.size();
+		terrain_index_chunks_ = chunked.chunks;
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+			element_count * sizeof(unsigned int),
+			elements, GL_STATIC_DRAW);
+		terrain_mesh_.element_count = (int)element_count;
+	}
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	terrain_mesh_.element_count = elements.size();
+
+	/*
+	The packed stream drops the UVs and rebuilds x/z from the vertex index, taking the vertex buffer from
+	40 bytes a vertex down to 8 (41.9 MB down to 8.4 MB for the 1024x1024 grid)
+	*/
+	PackedTerrain packed_terrain;
+	if (packed_vertices_)
+	{
+		packed_terrain = PackTerrain(vertices, vertex_count, kHiResTerrainSize + 1);
+		terrain_mesh_.verts_x = kHiResTerrainSize + 1;
+		terrain_mesh_.verts_z = (float)kHiResTerrainSize + 1;
+		terrain_mesh_.target_size_x = (int)sizeX;
+		terrain_mesh_.target_size_z = (int)sizeZ;
+		terrain_mesh_.height_scale = packed_terrain.heightScale;
+		terrain_mesh_.height_bias = packed_terrain.heightBias;
+
+		std::cout << "Terrain vertex buffer: " << PackedVertexBytes(vertex_count) / (1024.0 * 1024.0) << " MB packed, "
+			<< FullVertexBytes(vertex_count) / (1024.0 * 1024.0) << " MB unpacked" << std::endl;
+	}
 
 	glGenBuffers(1, &terrain_mesh_.position_vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, terrain_mesh_.position_vbo);
-	glBufferData(GL_ARRAY_BUFFER, hiResTerrain.terrain_data.size() * sizeof(Vertex), hiResTerrain.terrain_data.data(), GL_STATIC_DRAW);
+	if (packed_vertices_)
+		glBufferData(GL_ARRAY_BUFFER, PackedVertexBytes(vertex_count), packed_terrain.vertices.data(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(Vertex), vertices, GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	build_profiler_.End(BuildStage::Upload, vertex_count);
 
 	glGenVertexArrays(1, &terrain_mesh_.vao);
 	glBindVertexArray(terrain_mesh_.vao);
@@ -184,21 +631,120 @@ windowViewWillStart(std::shared_ptr<tygra::Window> window)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain_mesh_.element_vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, terrain_mesh_.position_vbo);
 
-	/*
-	Rather than using a method similar to the first ICA, I developed on my understanding and have a Vertex structure that 
-	holds all the info for drawing.
+	if (packed_vertices_)
+	{
+		glEnableVertexAttribArray(kVertexPosition);
+		glVertexAttribPointer(kVertexPosition, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), TGL_BUFFER_OFFSET(0));
+		glEnableVertexAttribArray(kVertexNormal);
+		glVertexAttribPointer(kVertexNormal, 2, GL_SHORT, GL_FALSE, sizeof(PackedVertex), TGL_BUFFER_OFFSET(4));
+	}
+	else
+	{
+		/*
+		Rather than using a method similar to the first ICA, I developed on my understanding and have a Vertex structure that 
+		holds all the info for drawing.
 
-	Here I've used TGL_BUFFER_OFFSET when pointing to the data, which has greatly reduced the 
-	length and complexity of this particular section of code
-	*/
-	glEnableVertexAttribArray(kVertexPosition);
-	glVertexAttribPointer(kVertexPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(0));
-	glEnableVertexAttribArray(kVertexNormal);
-	glVertexAttribPointer(kVertexNormal, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(12));
+		Here I've used TGL_BUFFER_OFFSET when pointing to the data, which has greatly reduced the 
+		length and complexity of this particular section of code
+		*/
+		glEnableVertexAttribArray(kVertexPosition);
+		glVertexAttribPointer(kVertexPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(0));
+		glEnableVertexAttribArray(kVertexNormal);
+		glVertexAttribPointer(kVertexNormal, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), TGL_BUFFER_OFFSET(12));
+	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+}
+
+/*
+CDLOD's selection tree, the heightfield texture its vertex shader reads, and the one node mesh
+*/
+void MyView::
+UploadTerrainLod(const Vertex* vertices, size_t vertex_count)
+{
+	const float sizeX = scene_->getTerrainSizeX();
+	const float sizeZ = scene_->getTerrainSizeZ();
+
+	const size_t verts = kHiResTerrainSize + 1;
+	terrain_lod_.Build(vertices, verts, verts, (int)sizeX, (int)sizeZ, LodSettings());
+
+	#ifdef TERRAIN_LOD_REPORT
+		std::vector<LodCamera> report_cameras;
+		for (float height : { 50.0f, 300.0f, 1000.0f, 3000.0f })
+		{
+			report_cameras.push_back(LodCamera{ glm::vec3(sizeX * 0.5f, height, -sizeZ * 0.5f), 720.0f, 45.0f });
+		}
+		ReportLodSelection(terrain_lod_, report_cameras, std::cout);
+	#endif
+
+	build_profiler_.Begin(BuildStage::Upload);
+	std::vector<glm::vec4> heightfield(vertex_count);
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		heightfield[i] = glm::vec4(vertices[i].n, vertices[i].p.y);
+	}
+
+	glGenTextures(1, &lod_heightfield_tex_);
+	glBindTexture(GL_TEXTURE_2D, lod_heightfield_tex_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei)verts, (GLsizei)verts, 0, GL_RGBA, GL_FLOAT, heightfield.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	build_profiler_.End(BuildStage::Upload, 0);
+
+	std::vector<uint16_t> node_indices = TerrainLodTree::BuildNodeIndices(terrain_lod_.LeafQuads());
+	glGenVertexArrays(1, &lod_vao_);
+	glBindVertexArray(lod_vao_);
+	glGenBuffers(1, &lod_element_vbo_);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod_element_vbo_);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, node_indices.size() * sizeof(uint16_t), node_indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*
+Whichever of the grid and the LOD terrain wasn't uploaded at startup goes up the first time it's toggled to.
+The CPU terrain is the one to upload from if there is one, since it has every edit in it; a warm start without
+edits maps the cache again instead
+*/
+bool MyView::
+EnsureTerrainMode(bool lod)
+{
+    if (lod ? lod_vao_ != 0 : terrain_mesh_.vao != 0)
+        return true;
+
+    MappedTerrainCache terrain_cache;
+    const Vertex* vertices = nullptr;
+    const int* elements = nullptr;
+    size_t vertex_count = 0, element_count = 0;
+    if (hires_terrain_)
+    {
+        vertices = hires_terrain_->terrain_data.data();
+        elements = hires_terrain_->terrain_elements.data();
+        vertex_count = hires_terrain_->terrain_data.size();
+        element_count = hires_terrain_->terrain_elements.size();
+    }
+    else if (terrain_cache.Open(kTerrainCacheFile, terrain_cache_key_))
+    {
+        vertices = terrain_cache.Vertices();
+        elements = terrain_cache.Elements();
+        vertex_count = (size_t)terrain_cache.Header().vertexCount;
+        element_count = (size_t)terrain_cache.Header().elementCount;
+    }
+    else
+    {
+        std::cerr << "No terrain to upload the " << (lod ? "LOD" : "full grid") << " terrain from" << std::endl;
+        return false;
+    }
 
+    if (lod)
+        UploadTerrainLod(vertices, vertex_count);
+    else
+        UploadTerrainGrid(vertices, elements, vertex_count, element_count);
+    return true;
 }
 
 void MyView::
@@ -212,12 +758,29 @@ windowViewDidReset(std::shared_ptr<tygra::Window> window,
 void MyView::
 windowViewDidStop(std::shared_ptr<tygra::Window> window)
 {
+    //the worker still reads base_terrain_ and writes hires_terrain_, so let it finish before anything goes away
+    if (terrain_build_.valid())
+        terrain_build_.wait();
+    terrain_pager_.reset(); //same for the paging workers and paged_terrain_
+
+    for (auto& slot : page_slots_)
+        DeleteMesh(slot);
+    page_slots_.clear();
+    glDeleteBuffers(1, &page_element_vbo_);
+
     glDeleteProgram(terrain_sp_);
+    glDeleteProgram(terrain_packed_sp_);
+    glDeleteProgram(terrain_lod_sp_);
+    glDeleteProgram(terrain_tess_sp_);
     glDeleteProgram(shapes_sp_);
 
-    glDeleteBuffers(1, &terrain_mesh_.position_vbo);
-    glDeleteBuffers(1, &terrain_mesh_.element_vbo);
-    glDeleteVertexArrays(1, &terrain_mesh_.vao);
+    DeleteMesh(terrain_mesh_);
+    DeleteMesh(preview_mesh_);
+    DeleteMesh(tess_mesh_);
+
+    glDeleteTextures(1, &lod_heightfield_tex_);
+    glDeleteBuffers(1, &lod_element_vbo_);
+    glDeleteVertexArrays(1, &lod_vao_);
 }
 
 void MyView::
@@ -239,6 +802,15 @@ windowViewRender(std::shared_ptr<tygra::Window> window)
     glm::vec3 world_up{ 0, 1, 0 };
     glm::mat4 view_xform = glm::lookAt(camera_pos, camera_at, world_up);
 
+    CollectHiResTerrain();
+
+    //edits wait for the hi-res terrain, the brush keeps adding up until then
+    if (pending_brush_strength_ != 0 && hires_ready_)
+    {
+        EditTerrain(camera_pos.x, camera_pos.z, pending_brush_strength_);
+        pending_brush_strength_ = 0;
+    }
+
 
     /* TODO: you are free to modify any of the drawing code below */
 
@@ -250,26 +822,64 @@ windowViewRender(std::shared_ptr<tygra::Window> window)
     glEnable(GL_CULL_FACE);
     glPolygonMode(GL_FRONT_AND_BACK, shade_normals_ ? GL_FILL : GL_LINE);
 
-    glUseProgram(terrain_sp_);
+    //tessellation only needs the base control points, so it can draw before the hi-res terrain is ready
+    if (tessellation_enabled_ && !EnsureTessellatedTerrain())
+        tessellation_enabled_ = false;
+
+    //a new index ordering means the grid goes up again, EnsureTerrainMode puts it back if it's the one drawn
+    if (index_mode_changed_ && terrain_mesh_.vao != 0)
+        DeleteMesh(terrain_mesh_);
+    index_mode_changed_ = false;
 
-    GLuint shading_id = glGetUniformLocation(terrain_sp_, "use_normal");
+    //the paged world has neither
+    if (hires_ready_ && !terrain_pager_ && !EnsureTerrainMode(lod_enabled_))
+        lod_enabled_ = !lod_enabled_;
+
+    const GLuint terrain_program = tessellation_enabled_ ? terrain_tess_sp_ : !hires_ready_ ? terrain_sp_ : lod_enabled_ ? terrain_lod_sp_ : packed_vertices_ ? terrain_packed_sp_ : terrain_sp_;
+    glUseProgram(terrain_program);
+
+    GLuint shading_id = glGetUniformLocation(terrain_program, "use_normal");
     glUniform1i(shading_id, shade_normals_);
 
+    if (hires_ready_ && packed_vertices_ && !lod_enabled_ && !tessellation_enabled_)
+    {
+        glUniform1i(glGetUniformLocation(terrain_program, "verts_x"), terrain_mesh_.verts_x);
+        glUniform1f(glGetUniformLocation(terrain_program, "verts_z"), terrain_mesh_.verts_z);
+        glUniform1i(glGetUniformLocation(terrain_program, "target_size_x"), terrain_mesh_.target_size_x);
+        glUniform1i(glGetUniformLocation(terrain_program, "target_size_z"), terrain_mesh_.target_size_z);
+        glUniform1f(glGetUniformLocation(terrain_program, "height_scale"), terrain_mesh_.height_scale);
+        glUniform1f(glGetUniformLocation(terrain_program, "height_bias"), terrain_mesh_.height_bias);
+    }
+
     glm::mat4 world_xform = glm::mat4(1);
     glm::mat4 view_world_xform = view_xform * world_xform;
 
-    GLuint projection_xform_id = glGetUniformLocation(terrain_sp_,
+    GLuint projection_xform_id = glGetUniformLocation(terrain_program,
                                                       "projection_xform");
     glUniformMatrix4fv(projection_xform_id, 1, GL_FALSE,
                        glm::value_ptr(projection_xform));
 
-    GLuint view_world_xform_id = glGetUniformLocation(terrain_sp_,
+    GLuint view_world_xform_id = glGetUniformLocation(terrain_program,
                                                       "view_world_xform");
     glUniformMatrix4fv(view_world_xform_id, 1, GL_FALSE,
                        glm::value_ptr(view_world_xform));
 
-    glBindVertexArray(terrain_mesh_.vao);
-    glDrawElements(GL_TRIANGLES, terrain_mesh_.element_count, GL_UNSIGNED_INT, 0);
+	//construct the view frustum before drawing anything, the terrain chunks and the cubes are both checked against it
+	screen_frustum.ConstructFrustum(camera.getFarPlaneDistance(), projection_xform, view_xform);
+
+    if (tessellation_enabled_)
+        DrawTessellatedTerrain(terrain_program, camera_pos, (float)viewport[3], camera.getVerticalFieldOfViewInDegrees());
+    else if (terrain_pager_)
+        DrawPagedTerrain(camera_pos);
+    else if (!hires_ready_)
+    {
+        glBindVertexArray(preview_mesh_.vao);
+        glDrawElements(GL_TRIANGLES, preview_mesh_.element_count, GL_UNSIGNED_INT, 0);
+    }
+    else if (lod_enabled_)
+        DrawTerrainLod(terrain_program, camera_pos, (float)viewport[3], camera.getVerticalFieldOfViewInDegrees());
+    else
+        DrawTerrainGrid();
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
@@ -284,16 +894,36 @@ windowViewRender(std::shared_ptr<tygra::Window> window)
 
     glBindVertexArray(cube_vao_);
 
-	//construct the view frustum before drawing in order to check the presence of cubes, to reduce redundant draw calls
-	screen_frustum.ConstructFrustum(camera.getFarPlaneDistance(), projection_xform, view_xform); 
-
 	//create a reference for additional debug info, in this instance check how many cubes are out-of-frustum
 	int culledObjects = 0;
 
-    for (const auto& pos : scene_->getAllShapePositions())
+	//every shape sits on the ground drawn under it, the LOD mesh when that's what got drawn this frame
+	const auto& shape_positions = scene_->getAllShapePositions();
+	shape_xs_.resize(shape_positions.size());
+	shape_zs_.resize(shape_positions.size());
+	shape_heights_.resize(shape_positions.size());
+	for (size_t i = 0; i < shape_positions.size(); ++i)
+	{
+		shape_xs_[i] = shape_positions[i].x;
+		shape_zs_[i] = -shape_positions[i].y;
+	}
+	if (!tessellation_enabled_ && !terrain_pager_ && hires_ready_ && lod_enabled_)
+	{
+		terrain_query_.DrawnHeightBatch(terrain_lod_, lod_selection_, camera_pos, shape_xs_.data(), shape_zs_.data(),
+			shape_heights_.data(), shape_positions.size());
+	}
+	else
+	{
+		for (size_t i = 0; i < shape_positions.size(); ++i)
+		{
+			shape_heights_[i] = terrain_query_.Height(shape_xs_[i], shape_zs_[i]);
+		}
+	}
+
+    for (size_t i = 0; i < shape_positions.size(); ++i)
     {
-		
-        world_xform = glm::translate(glm::mat4(1), glm::vec3(pos.x, 64, -pos.y));
+        const glm::vec3 shape_pos(shape_xs_[i], shape_heights_[i], shape_zs_[i]);
+        world_xform = glm::translate(glm::mat4(1), shape_pos);
         view_world_xform = view_xform * world_xform;
 
         view_world_xform_id = glGetUniformLocation(shapes_sp_,
@@ -303,13 +933,414 @@ windowViewRender(std::shared_ptr<tygra::Window> window)
 
 		/*now that the frustum has been constructed, 
 		check each cube to see if it is in the view frustum and only draw if it is*/
-		if (screen_frustum.IsPointOnScreen(glm::vec3(pos.x, 64, -pos.y))) 
+		if (screen_frustum.IsPointOnScreen(shape_pos)) 
 			glDrawArrays(GL_TRIANGLES, 0, 36);
 		else
 			culledObjects++;
     }
 
+	if (first_frame_ms_ < 0)
+	{
+		glFinish(); //so the time covers the frame actually being drawn, not just queued
+		first_frame_ms_ = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startup_time_).count();
+		std::cout << "Terrain first frame: " << first_frame_ms_ << " ms" << (hires_ready_ ? "" : " (base heightmap, hi-res still building)") << std::endl;
+	}
+
 	#ifdef _DEBUG
 		std::cout << std::to_string(culledObjects) + " cubes were culled this frame" << std::endl;
+		std::cout << chunk_stats_.visibleChunks << "/" << chunk_stats_.totalChunks << " terrain chunks visible, "
+			<< chunk_stats_.visibleTriangles << " triangles in " << chunk_stats_.drawCalls << " draws" << std::endl;
 	#endif
 }
+
+/*
+The full detail 1024x1024 grid with whichever index buffer index_mode_ (F9) is on. Only the culled chunks
+skip anything, the other orderings always draw the lot
+*/
+void MyView::
+DrawTerrainGrid()
+{
+    chunk_stats_ = ChunkCullStats();
+
+    glBindVertexArray(terrain_mesh_.vao);
+    if (index_mode_ == IndexMode::Culled)
+    {
+        CullTerrainChunks(terrain_chunks_, screen_frustum, chunk_draws_, chunk_stats_);
+        for (const auto& draw : chunk_draws_)
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)draw.indexCount, GL_UNSIGNED_SHORT,
+                TGL_BUFFER_OFFSET(draw.firstIndex * sizeof(uint16_t)), draw.baseVertex);
+        }
+    }
+    else if (index_mode_ == IndexMode::Strips)
+    {
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(kStripRestartIndex);
+        glDrawElements(GL_TRIANGLE_STRIP, terrain_mesh_.element_count, GL_UNSIGNED_INT, 0);
+        glDisable(GL_PRIMITIVE_RESTART);
+    }
+    else if (index_mode_ == IndexMode::Chunks16)
+    {
+        for (const auto& chunk : terrain_index_chunks_)
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)chunk.indexCount, GL_UNSIGNED_SHORT,
+                TGL_BUFFER_OFFSET(chunk.firstIndex * sizeof(uint16_t)), chunk.baseVertex);
+        }
+    }
+    else
+    {
+        glDrawElements(GL_TRIANGLES, terrain_mesh_.element_count, GL_UNSIGNED_INT, 0);
+    }
+}
+
+/*
+The tessellated terrain needs nothing but the base control points, so it's made the first time it's switched
+on. A warm start never loads the base, so that happens here too
+*/
+bool MyView::
+EnsureTessellatedTerrain()
+{
+    if (tess_mesh_.vao != 0)
+        return true;
+
+    if (!base_terrain_ && !LoadBaseTerrain())
+    {
+        std::cerr << "Terrain tessellation needs " << scene_->getTerrainHeightMapName() << " for its control points" << std::endl;
+        return false;
+    }
+
+    const int sizeX = (int)scene_->getTerrainSizeX();
+    const int sizeZ = (int)scene_->getTerrainSizeZ();
+    if (!terrain_tessellation_.Build(base_terrain_->terrain_data.data(), base_terrain_->verts_x, (size_t)base_terrain_->verts_z, sizeX, sizeZ))
+        return false;
+
+    #ifdef TERRAIN_TESSELLATION_REPORT
+        std::vector<LodCamera> report_cameras;
+        for (float height : { 50.0f, 300.0f, 1000.0f, 3000.0f })
+        {
+            report_cameras.push_back(LodCamera{ glm::vec3(sizeX * 0.5f, height, -sizeZ * 0.5f), 720.0f, 45.0f });
+        }
+        ReportTessellation(terrain_tessellation_, report_cameras, tess_settings_, kHiResTerrainSize + 1, std::cout);
+    #endif
+
+    const std::vector<uint32_t>& indices = terrain_tessellation_.PatchIndices();
+    const std::vector<float>& heights = terrain_tessellation_.Heights();
+
+    glGenVertexArrays(1, &tess_mesh_.vao);
+    glBindVertexArray(tess_mesh_.vao);
+
+    glGenBuffers(1, &tess_mesh_.element_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tess_mesh_.element_vbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    tess_mesh_.element_count = (int)indices.size();
+
+    glGenBuffers(1, &tess_mesh_.position_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, tess_mesh_.position_vbo);
+    glBufferData(GL_ARRAY_BUFFER, heights.size() * sizeof(float), heights.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(kVertexPosition);
+    glVertexAttribPointer(kVertexPosition, 1, GL_FLOAT, GL_FALSE, sizeof(float), TGL_BUFFER_OFFSET(0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    std::cout << "Terrain tessellation: " << terrain_tessellation_.PatchesX() * terrain_tessellation_.PatchesZ() << " patches, "
+        << terrain_tessellation_.GpuBytes() / 1024 << " KB on the GPU" << std::endl;
+    return true;
+}
+
+/*
+Every patch goes to the GPU every frame; the control shader picks the levels from this camera
+*/
+void MyView::
+DrawTessellatedTerrain(GLuint program, const glm::vec3& camera_pos, float viewport_height, float vertical_fov)
+{
+    const float pixels_per_unit = viewport_height / (2.0f * std::tan(glm::radians(vertical_fov) * 0.5f));
+    const glm::vec2 spacing = terrain_tessellation_.Spacing();
+
+    glUniform1i(glGetUniformLocation(program, "grid_verts_x"), (GLint)terrain_tessellation_.VertsX());
+    glUniform2f(glGetUniformLocation(program, "grid_spacing"), spacing.x, spacing.y);
+    glUniform3fv(glGetUniformLocation(program, "camera_position"), 1, glm::value_ptr(camera_pos));
+    glUniform1f(glGetUniformLocation(program, "pixels_per_unit"), pixels_per_unit);
+    glUniform1f(glGetUniformLocation(program, "pixels_per_segment"), tess_settings_.pixelsPerSegment);
+    glUniform1f(glGetUniformLocation(program, "max_level"), tess_settings_.maxLevel);
+
+    glBindVertexArray(tess_mesh_.vao);
+    glPatchParameteri(GL_PATCH_VERTICES, TerrainTessellation::kPatchPoints);
+    glDrawElements(GL_PATCHES, tess_mesh_.element_count, GL_UNSIGNED_INT, 0);
+}
+
+/*
+Hands this frame's finished chunks to their slots, then draws whichever resident chunks are in the view frustum.
+The pager caps the uploads a frame, so however fast the camera moves a frame only ever copies a few chunks
+*/
+void MyView::
+DrawPagedTerrain(const glm::vec3& camera_pos)
+{
+    terrain_pager_->Update(camera_pos, page_uploads_);
+    for (const auto& upload : page_uploads_)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, page_slots_[upload.slot].position_vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, upload.vertices->size() * sizeof(Vertex), upload.vertices->data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    chunk_stats_ = ChunkCullStats();
+    const size_t chunk_triangles = terrain_pager_->ChunkIndices().size() / 3;
+
+    terrain_pager_->ResidentChunks(page_draws_);
+    for (const auto& draw : page_draws_)
+    {
+        chunk_stats_.totalChunks++;
+        if (!screen_frustum.IsBoxOnScreen(draw.minCorner, draw.maxCorner))
+            continue;
+
+        glBindVertexArray(page_slots_[draw.slot].vao);
+        glDrawElements(GL_TRIANGLES, page_slots_[draw.slot].element_count, GL_UNSIGNED_INT, 0);
+        chunk_stats_.visibleChunks++;
+        chunk_stats_.visibleTriangles += chunk_triangles;
+        chunk_stats_.drawCalls++;
+    }
+}
+
+/*
+Picks the quadtree nodes for this camera and draws each one whose box is in the view frustum with the
+shared node mesh. Runs of neighbouring quadrants are merged so a whole node is a single draw
+*/
+void MyView::
+DrawTerrainLod(GLuint program, const glm::vec3& camera_pos, float viewport_height, float vertical_fov)
+{
+    terrain_lod_.Select(LodCamera{ camera_pos, viewport_height, vertical_fov }, lod_selection_);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, lod_heightfield_tex_);
+    glUniform1i(glGetUniformLocation(program, "heightfield"), 0);
+    glUniform2f(glGetUniformLocation(program, "grid_verts"), (float)kHiResTerrainSize + 1, (float)kHiResTerrainSize + 1);
+    glUniform2f(glGetUniformLocation(program, "grid_spacing"), scene_->getTerrainSizeX() / (kHiResTerrainSize + 1.0f),
+        scene_->getTerrainSizeZ() / (kHiResTerrainSize + 1.0f));
+    glUniform1i(glGetUniformLocation(program, "node_quads"), terrain_lod_.LeafQuads());
+    glUniform3fv(glGetUniformLocation(program, "camera_position"), 1, glm::value_ptr(camera_pos));
+
+    const GLint node_origin_id = glGetUniformLocation(program, "node_origin");
+    const GLint node_stride_id = glGetUniformLocation(program, "node_stride");
+    const GLint morph_range_id = glGetUniformLocation(program, "morph_range");
+    const size_t quadrant_indices = TerrainLodTree::QuadrantIndexCount(terrain_lod_.LeafQuads());
+
+    chunk_stats_ = ChunkCullStats();
+    chunk_stats_.totalChunks = lod_selection_.nodes.size();
+
+    glBindVertexArray(lod_vao_);
+    for (const LodNode& node : lod_selection_.nodes)
+    {
+        if (!screen_frustum.IsBoxOnScreen(node.boundsMin, node.boundsMax))
+            continue;
+
+        glUniform2f(node_origin_id, (float)node.x, (float)node.z);
+        chunk_stats_.visibleChunks++;
+        glUniform1f(node_stride_id, (float)(1 << node.level));
+        glUniform2f(morph_range_id, lod_selection_.morphStart[node.level], lod_selection_.morphEnd[node.level]);
+
+        for (int q = 0; q < 4; ++q)
+        {
+            if (!(node.quadrants & (1 << q)))
+                continue;
+
+            int last = q;
+            while (last + 1 < 4 && (node.quadrants & (1 << (last + 1))))
+                last++;
+
+            glDrawElements(GL_TRIANGLES, (GLsizei)((last - q + 1) * quadrant_indices), GL_UNSIGNED_SHORT,
+                TGL_BUFFER_OFFSET(q * quadrant_indices * sizeof(uint16_t)));
+            chunk_stats_.visibleTriangles += (last - q + 1) * quadrant_indices / 3;
+            chunk_stats_.drawCalls++;
+            q = last;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/*
+The base mesh takes its size from the heightmap, PNG or raw, so the map is never resampled on the way in.
+If it can't be read the base is left flat at the old 256x256 so the rest of startup still has a terrain
+*/
+bool MyView::
+LoadBaseTerrain()
+{
+    const float sizeX = scene_->getTerrainSizeX();
+    const float sizeZ = scene_->getTerrainSizeZ();
+
+    std::unique_ptr<HeightmapSource> source = OpenHeightmapSource(scene_->getTerrainHeightMapName());
+    if (source && (source->Width() < 4 || source->Height() < 4))
+    {
+        //any size from there up works, the patches along the far edges just come out shorter
+        std::cerr << "Heightmap is " << source->Width() << "x" << source->Height() << ", it needs at least one whole 4x4 patch" << std::endl;
+        source.reset();
+    }
+    if (!source)
+    {
+        base_terrain_.reset(new TerrainGL(255, 255, sizeX, sizeZ));
+        return false;
+    }
+
+    BuildProfiler::Scope stage(build_profiler_, BuildStage::Heightmap, source->Width() * source->Height());
+    base_terrain_.reset(new TerrainGL((int)source->Width() - 1, (int)source->Height() - 1, sizeX, sizeZ));
+    return base_terrain_->ApplyHeightMap(*source);
+}
+
+/*
+A warm start only has the cached vertices in GL, so the first edit rebuilds the CPU terrain the same way the
+cold start does. The cache is keyed on the same inputs, so it comes out bit-identical to what's on screen
+*/
+bool MyView::
+EnsureTerrainEditable()
+{
+    if (terrain_editor_)
+        return true;
+
+    const float sizeX = scene_->getTerrainSizeX();
+    const float sizeZ = scene_->getTerrainSizeZ();
+
+    if (!hires_terrain_)
+    {
+        if (!LoadBaseTerrain())
+        {
+            std::cerr << "Terrain editing needs " << scene_->getTerrainHeightMapName() << " to rebuild from" << std::endl;
+            return false;
+        }
+
+        ThreadPool buildPool;
+        hires_terrain_.reset(new TerrainGL(kHiResTerrainSize, kHiResTerrainSize, sizeX, sizeZ));
+        hires_terrain_->analyticNormals = true;
+        hires_terrain_->SeparableInterpolation(base_terrain_.get(), buildPool);
+        hires_terrain_->ApplyNoise(buildPool);
+    }
+
+    terrain_editor_.reset(new TerrainEditor(*base_terrain_, *hires_terrain_));
+    return true;
+}
+
+void MyView::
+EditTerrain(float world_x, float world_z, float strength)
+{
+    if (!EnsureTerrainEditable())
+        return;
+
+    terrain_editor_->StampBrush(world_x, world_z, kTerrainBrushRadius, strength);
+    TerrainRegion region = terrain_editor_->Regenerate();
+    UploadTerrainRegion(region);
+
+    //the brush moves the base control points themselves, which is all the tessellated terrain is made of
+    if (tess_mesh_.vao != 0)
+    {
+        terrain_tessellation_.UpdateHeights(base_terrain_->terrain_data.data());
+        const std::vector<float>& heights = terrain_tessellation_.Heights();
+        glBindBuffer(GL_ARRAY_BUFFER, tess_mesh_.position_vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, heights.size() * sizeof(float), heights.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    std::cout << "Terrain edit: " << (region.endX - region.firstX) * (region.endZ - region.firstZ) << " vertices regenerated in "
+        << terrain_editor_->LastRegenerateMilliseconds() << " ms" << std::endl;
+}
+
+/*
+Sends only the edited rectangle to the GPU, a row at a time since each row is one contiguous run of the
+vertex buffer, and a sub-image of the LOD heightfield. The culling boxes over it get refitted too
+*/
+void MyView::
+UploadTerrainRegion(const TerrainRegion& region)
+{
+    if (region.Empty())
+        return;
+
+    const size_t verts_x = kHiResTerrainSize + 1;
+    const size_t width = region.endX - region.firstX;
+    const size_t height = region.endZ - region.firstZ;
+    const Vertex* vertices = hires_terrain_->terrain_data.data();
+    const size_t vertex_count = hires_terrain_->terrain_data.size();
+
+    //whichever of the grid and the LOD terrain hasn't been uploaded yet gets the edit when it is
+    if (terrain_mesh_.vao != 0)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, terrain_mesh_.position_vbo);
+        if (packed_vertices_)
+        {
+            //the packed heights are relative to the range at startup, anything pushed outside it needs a full repack
+            bool in_range = true;
+            for (size_t z = region.firstZ; z < region.endZ && in_range; ++z)
+            {
+                for (size_t x = region.firstX; x < region.endX; ++x)
+                {
+                    float y = vertices[z * verts_x + x].p.y;
+                    if (y < terrain_mesh_.height_bias || y > terrain_mesh_.height_bias + terrain_mesh_.height_scale)
+                    {
+                        in_range = false;
+                        break;
+                    }
+                }
+            }
+
+            if (in_range)
+            {
+                std::vector<PackedVertex> packed_row(width);
+                for (size_t z = region.firstZ; z < region.endZ; ++z)
+                {
+                    const size_t first = z * verts_x + region.firstX;
+                    PackVertices(vertices + first, width, terrain_mesh_.height_scale, terrain_mesh_.height_bias, packed_row.data());
+                    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(PackedVertex), width * sizeof(PackedVertex), packed_row.data());
+                }
+            }
+            else
+            {
+                PackedTerrain packed_terrain = PackTerrain(vertices, vertex_count, verts_x);
+                terrain_mesh_.height_scale = packed_terrain.heightScale;
+                terrain_mesh_.height_bias = packed_terrain.heightBias;
+                glBufferSubData(GL_ARRAY_BUFFER, 0, PackedVertexBytes(vertex_count), packed_terrain.vertices.data());
+            }
+        }
+        else
+        {
+            for (size_t z = region.firstZ; z < region.endZ; ++z)
+            {
+                const size_t first = z * verts_x + region.firstX;
+                glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), width * sizeof(Vertex), vertices + first);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    if (lod_vao_ != 0)
+    {
+        std::vector<glm::vec4> heightfield(width * height);
+        for (size_t z = 0; z < height; ++z)
+        {
+            for (size_t x = 0; x < width; ++x)
+            {
+                const Vertex& v = vertices[(region.firstZ + z) * verts_x + region.firstX + x];
+                heightfield[z * width + x] = glm::vec4(v.n, v.p.y);
+            }
+        }
+
+        glBindTexture(GL_TEXTURE_2D, lod_heightfield_tex_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)region.firstX, (GLint)region.firstZ, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_FLOAT, heightfield.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        terrain_lod_.UpdateBounds(vertices, region);
+    }
+
+    if (terrain_mesh_.vao != 0 && index_mode_ == IndexMode::Culled)
+        UpdateTerrainChunkBounds(terrain_chunks_, vertices, verts_x, verts_x, region);
+
+    //an edit can move the error anywhere up the RTIN hierarchy, so the triangulation is redone whole
+    if (terrain_mesh_.vao != 0 && index_mode_ == IndexMode::Adaptive)
+    {
+        AdaptiveMesh adaptive;
+        adaptive_mesher_.Build(vertices, verts_x, verts_x);
+        adaptive_mesher_.Extract(kAdaptiveMaxError, adaptive);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain_mesh_.element_vbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, adaptive.indices.size() * sizeof(uint32_t), adaptive.indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        terrain_mesh_.element_count = (int)adaptive.indices.size();
+    }
+
+    terrain_query_.UpdateRegion(vertices, region);
+}
@@ -5,10 +5,23 @@
 #include <tygra/FileHelper.hpp>
 #include <tgl/tgl.h>
 #include <glm/glm.hpp>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <vector>
+#include "MyAdaptiveMesh.hpp"
 #include "MyFrustum.hpp"
+#include "MyLazyTerrain.hpp"
 #include "MyTerrain.hpp"
+#include "MyTerrainChunks.hpp"
+#include "MyTerrainEditor.hpp"
+#include "MyTerrainIndexing.hpp"
+#include "MyTerrainLod.hpp"
+#include "MyTerrainPager.hpp"
+#include "MyTerrainQuery.hpp"
+#include "MyTerrainTessellation.hpp"
 
 class MyView : public tygra::WindowViewDelegate
 {
@@ -21,9 +34,41 @@ public:
     void
     setScene(std::shared_ptr<const SceneModel::Context> scene);
 
+    /*
+    Streams a kPagedTerrainSize terrain in around the camera instead of building it all. Has to be set before the
+    window starts, it picks which terrain gets made
+    */
+    void
+    setTerrainPaging(bool enabled);
+
     void
     toggleShading();
 
+    /*
+    Raises (or lowers, if negative) the ground under the camera. Queued and applied at the start of the next frame
+    */
+    void
+    stampTerrainBrush(float strength);
+
+    /*
+    Swaps between the drawn terrain and the base control points evaluated in the tessellation shaders
+    */
+    void
+    toggleTessellation();
+
+    /*
+    Swaps between the CDLOD terrain and the full detail grid. Only the one in use is on the GPU until then
+    */
+    void
+    toggleLod();
+
+    /*
+    Moves the full detail grid on to the next index buffer ordering. The grid is uploaded again with it at the
+    start of the next frame, or whenever it's next toggled to if the LOD terrain is the one being drawn
+    */
+    void
+    cycleIndexMode();
+
 private:
 
     void
@@ -40,14 +85,85 @@ private:
     void
     windowViewRender(std::shared_ptr<tygra::Window> window) override;
 
+    void
+    DrawTerrainGrid();
+
+    void
+    DrawTerrainLod(GLuint program, const glm::vec3& camera_pos, float viewport_height, float vertical_fov);
+
+    bool
+    LoadBaseTerrain();
+
+    bool
+    BuildHiResTerrain(uint64_t cache_key, utilAyre::NoiseSettings terrain_noise, std::chrono::high_resolution_clock::time_point terrain_start);
+
+    void
+    UploadPreviewTerrain();
+
+    void
+    CollectHiResTerrain();
+
+    void
+    UploadHiResTerrain(const Vertex* vertices, const int* elements, size_t vertex_count, size_t element_count);
+
+    void
+    UploadTerrainGrid(const Vertex* vertices, const int* elements, size_t vertex_count, size_t element_count);
+
+    void
+    UploadTerrainLod(const Vertex* vertices, size_t vertex_count);
+
+    bool
+    EnsureTerrainMode(bool lod);
+
+    bool
+    EnsureTerrainEditable();
+
+    void
+    EditTerrain(float world_x, float world_z, float strength);
+
+    void
+    UploadTerrainRegion(const TerrainRegion& region);
+
+    void
+    StartTerrainPaging(const utilAyre::NoiseSettings& terrain_noise);
+
+    void
+    DrawPagedTerrain(const glm::vec3& camera_pos);
+
+    bool
+    EnsureTessellatedTerrain();
+
+    void
+    DrawTessellatedTerrain(GLuint program, const glm::vec3& camera_pos, float viewport_height, float vertical_fov);
+
 private:
 
     std::shared_ptr<const SceneModel::Context> scene_;
 
     GLuint terrain_sp_{ 0 };
+    GLuint terrain_packed_sp_{ 0 };
+    GLuint terrain_lod_sp_{ 0 };
+    GLuint terrain_tess_sp_{ 0 };
     GLuint shapes_sp_{ 0 };
 
     bool shade_normals_{ false };
+    bool packed_vertices_{ true }; //upload the 8 byte PackedVertex stream instead of the full 40 byte Vertex
+
+    enum class IndexMode
+    {
+        Triangles, //MakeMesh's 32-bit list
+        Strips,    //32-bit strips joined by primitive restart
+        Chunks16,  //16-bit cache-ordered lists drawn per chunk with a base vertex
+        Culled,    //16-bit square chunks, only the ones in the view frustum are drawn
+        Adaptive,  //32-bit RTIN triangles within kAdaptiveMaxError of the surface, over the same vertices
+    };
+    IndexMode index_mode_{ IndexMode::Culled };
+    bool index_mode_changed_{ false };
+    std::vector<IndexChunk> terrain_index_chunks_;
+    TerrainChunks terrain_chunks_;
+    AdaptiveTerrainMesher adaptive_mesher_;
+    std::vector<ChunkDrawRange> chunk_draws_;
+    ChunkCullStats chunk_stats_; //visible chunks and triangles for the last frame, whichever path drew it
 
     struct MeshGL
     {
@@ -56,10 +172,79 @@ private:
         GLuint element_vbo{ 0 };
         GLuint vao{ 0 };
         int element_count{ 0 };
+
+		// only used by the packed format, to rebuild positions in the vertex shader
+		int verts_x{ 0 };
+		float verts_z{ 0 };
+		int target_size_x{ 0 };
+		int target_size_z{ 0 };
+		float height_scale{ 1 };
+		float height_bias{ 0 };
     };
     MeshGL terrain_mesh_;
+
+    void
+    DeleteMesh(MeshGL& mesh);
+
+    /*
+    A cold start draws the base heightmap mesh (preview_mesh_) while the hi-res terrain builds on a worker, and
+    swaps to the hi-res one on the first frame after terrain_build_ is done. A warm start is hi-res from the off
+    */
+    MeshGL preview_mesh_;
+    std::future<bool> terrain_build_;
+    bool hires_ready_{ false };
+    uint64_t terrain_cache_key_{ 0 }; //to map the cache again for whichever mode wasn't uploaded at startup
+    std::chrono::high_resolution_clock::time_point startup_time_;
+    double first_frame_ms_{ -1 };
+
+    /*
+    CDLOD rendering: one shared node mesh, heights and normals read from a float texture in the vertex shader.
+    On by default, in which case the full grid's buffers aren't made until toggleLod turns it off
+    */
+    bool lod_enabled_{ true };
+    TerrainLodTree terrain_lod_;
+    LodSelection lod_selection_; //kept between frames so selecting doesn't allocate
+    GLuint lod_heightfield_tex_{ 0 };
+    GLuint lod_element_vbo_{ 0 };
+    GLuint lod_vao_{ 0 };
 	MyFrustum screen_frustum;
 
+    /*
+    Hardware tessellation: the base heights and 16 indices a patch, the Bezier surface is evaluated on the GPU.
+    Off until toggled, and only made then
+    */
+    bool tessellation_enabled_{ false };
+    TerrainTessellation terrain_tessellation_;
+    TessellationSettings tess_settings_;
+    MeshGL tess_mesh_;
+
+    TerrainHeightQuery terrain_query_; //ground heights for the shapes, kept in step with edits
+    std::vector<float> shape_xs_, shape_zs_, shape_heights_;
+
+    /*
+    The CPU side of the terrain, kept after startup so edits can regenerate just the part that changed.
+    A warm start never builds them, so the first edit does
+    */
+    std::unique_ptr<TerrainGL> base_terrain_;
+    std::unique_ptr<TerrainGL> hires_terrain_;
+    std::unique_ptr<TerrainEditor> terrain_editor_;
+    float pending_brush_strength_{ 0 };
+
+    /*
+    Paged terrain (setTerrainPaging): a grid too big to build up front, evaluated a chunk at a time off the base
+    heightmap, with only the chunks near the camera in GL. Every slot is a fixed size VBO that gets reused as
+    chunks come and go. The pager is declared after the terrain it reads from, so its workers stop first
+    */
+    bool terrain_paging_{ false };
+    std::unique_ptr<LazyTerrain> paged_terrain_;
+    std::unique_ptr<TerrainPager> terrain_pager_;
+    std::vector<MeshGL> page_slots_;
+    GLuint page_element_vbo_{ 0 };
+    std::vector<TerrainChunkUpload> page_uploads_;
+    std::vector<TerrainChunkDraw> page_draws_;
+
+    BuildProfiler build_profiler_; //per stage timings of the startup build, and of any rebuild for editing
+
     enum
     {
         kVertexPosition = 0,
@@ -1,4 +1,19 @@
 #include "NoiseBezierLib.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UTILAYRE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define UTILAYRE_TARGET_AVX
+#else
+#define UTILAYRE_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
 
 
 /*
@@ -58,7 +73,17 @@ namespace utilAyre
 		return glm::vec3(pos.x, pos.y + (total * scale), pos.z);
 	}
 
+	glm::vec3 Brownian(const glm::vec3& pos, const NoiseSettings& settings)
+	{
+		return Brownian(pos, settings.frequency, settings.octaves, settings.lacunarity, settings.gain, settings.scale);
+	}
+
 	glm::vec3 CalculateBezier(const std::vector<glm::vec3>& cps, float t)
+	{
+		return CalculateBezier(cps[0], cps[1], cps[2], cps[3], t);
+	}
+
+	glm::vec3 CalculateBezier(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
 	{
 		float temps[4];
 
@@ -68,28 +93,334 @@ namespace utilAyre
 		temps[3] = t * t * t;
 
 		return (
-			cps[0] * temps[0] +
-			cps[1] * temps[1] +
-			cps[2] * temps[2] +
-			cps[3] * temps[3]
+			p0 * temps[0] +
+			p1 * temps[1] +
+			p2 * temps[2] +
+			p3 * temps[3]
 			);
 	}
 
 	glm::vec3 BezierPatchSixteenPoints(const std::vector<glm::vec3>& cps, float u, float v)
 	{
-		std::vector<glm::vec3> Pu{ 4 };
+		BezierPatch patch;
+		std::copy(cps.begin(), cps.begin() + 16, patch.begin());
+		return BezierPatchSixteenPoints(patch, u, v);
+	}
+
+	/*
+	The fixed-size versions keep the 4 curve points along u on the stack, so evaluating a patch never touches the heap
+	*/
+	glm::vec3 BezierPatchSixteenPoints(const BezierPatch& cps, float u, float v)
+	{
+		glm::vec3 Pu[4];
 		// compute 4 control points along u direction
 		for (int i = 0; i < 4; ++i)
 		{
-			std::vector<glm::vec3> curveP{ 4 };
-			curveP[0] = cps[i * 4];
-			curveP[1] = cps[i * 4 + 1];
-			curveP[2] = cps[i * 4 + 2];
-			curveP[3] = cps[i * 4 + 3];
-			Pu[i] = CalculateBezier(curveP, u);
+			Pu[i] = CalculateBezier(cps[i * 4], cps[i * 4 + 1], cps[i * 4 + 2], cps[i * 4 + 3], u);
 		}
 		// compute final position on the surface using v
-		return CalculateBezier(Pu, v);
+		return CalculateBezier(Pu[0], Pu[1], Pu[2], Pu[3], v);
+	}
+
+	glm::vec3 BezierPatchSixteenPoints(const PatchView& cps, float u, float v)
+	{
+		glm::vec3 Pu[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			Pu[i] = CalculateBezier(cps.at(i, 0), cps.at(i, 1), cps.at(i, 2), cps.at(i, 3), u);
+		}
+		return CalculateBezier(Pu[0], Pu[1], Pu[2], Pu[3], v);
+	}
+
+	SimdLevel DetectSimdLevel()
+	{
+#if defined(UTILAYRE_X86)
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6); //OSXSAVE set and the OS preserves the AVX registers
+		if ((info[2] & (1 << 28)) && osSavesYmm)
+			return SimdLevel::AVX;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx"))
+			return SimdLevel::AVX;
+#endif
+		return SimdLevel::SSE; //SSE2 is part of every x64 chip
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	const char* SimdLevelName(SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel::AVX: return "AVX";
+		case SimdLevel::SSE: return "SSE";
+		default: return "Scalar";
+		}
+	}
+
+	/*
+	Distance between two floats in units in the last place, found by mapping the bit patterns onto a monotonic integer line
+	*/
+	int UlpDistance(float a, float b)
+	{
+		int32_t ia, ib;
+		std::memcpy(&ia, &a, sizeof(float));
+		std::memcpy(&ib, &b, sizeof(float));
+		if (ia < 0) ia = INT32_MIN - ia;
+		if (ib < 0) ib = INT32_MIN - ib;
+		int64_t diff = (int64_t)ia - (int64_t)ib;
+		return (int)std::min<int64_t>(diff < 0 ? -diff : diff, INT32_MAX);
+	}
+
+	HeightPatch HeightsOf(const PatchView& cps)
+	{
+		HeightPatch heights;
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				heights[i * 4 + j] = cps.at(i, j).y;
+			}
+		}
+		return heights;
+	}
+
+	float BezierHeight(const HeightPatch& cps, float u, float v)
+	{
+		std::array<float, 4> bu, bv;
+
+		bu[0] = (1 - u) * (1 - u) * (1 - u);
+		bu[1] = 3 * u * (1 - u) * (1 - u);
+		bu[2] = 3 * (1 - u) * u * u;
+		bu[3] = u * u * u;
+
+		bv[0] = (1 - v) * (1 - v) * (1 - v);
+		bv[1] = 3 * v * (1 - v) * (1 - v);
+		bv[2] = 3 * (1 - v) * v * v;
+		bv[3] = v * v * v;
+
+		return BezierHeight(cps, bu, bv);
+	}
+
+	float BezierHeight(const HeightPatch& cps, const std::array<float, 4>& bu, const std::array<float, 4>& bv)
+	{
+		float Pu[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			Pu[i] = cps[i * 4] * bu[0] + cps[i * 4 + 1] * bu[1] + cps[i * 4 + 2] * bu[2] + cps[i * 4 + 3] * bu[3];
+		}
+		return Pu[0] * bv[0] + Pu[1] * bv[1] + Pu[2] * bv[2] + Pu[3] * bv[3];
+	}
+
+	static void BezierHeightScalar(const HeightPatch& cps, const float* u, const float* v, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			out[i] = BezierHeight(cps, u[i], v[i]);
+		}
+	}
+
+#if defined(UTILAYRE_X86)
+	/*
+	Each lane is one (u,v) sample. Weights and sums are built in the same order as BezierHeight
+	*/
+	static inline void BernsteinSSE(__m128 t, __m128 weights[4])
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 three = _mm_set1_ps(3.0f);
+		__m128 it = _mm_sub_ps(one, t);
+
+		weights[0] = _mm_mul_ps(_mm_mul_ps(it, it), it);
+		weights[1] = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(three, t), it), it);
+		weights[2] = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(three, it), t), t);
+		weights[3] = _mm_mul_ps(_mm_mul_ps(t, t), t);
+	}
+
+	static void BezierHeightSSE(const HeightPatch& cps, const float* u, const float* v, float* out, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 bu[4], bv[4];
+			BernsteinSSE(_mm_loadu_ps(u + i), bu);
+			BernsteinSSE(_mm_loadu_ps(v + i), bv);
+
+			__m128 result = _mm_setzero_ps();
+			for (int row = 0; row < 4; ++row)
+			{
+				__m128 Pu = _mm_mul_ps(_mm_set1_ps(cps[row * 4]), bu[0]);
+				Pu = _mm_add_ps(Pu, _mm_mul_ps(_mm_set1_ps(cps[row * 4 + 1]), bu[1]));
+				Pu = _mm_add_ps(Pu, _mm_mul_ps(_mm_set1_ps(cps[row * 4 + 2]), bu[2]));
+				Pu = _mm_add_ps(Pu, _mm_mul_ps(_mm_set1_ps(cps[row * 4 + 3]), bu[3]));
+
+				result = row == 0 ? _mm_mul_ps(Pu, bv[0]) : _mm_add_ps(result, _mm_mul_ps(Pu, bv[row]));
+			}
+			_mm_storeu_ps(out + i, result);
+		}
+		BezierHeightScalar(cps, u + i, v + i, out + i, count - i);
+	}
+
+	UTILAYRE_TARGET_AVX static inline void BernsteinAVX(__m256 t, __m256 weights[4])
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 three = _mm256_set1_ps(3.0f);
+		__m256 it = _mm256_sub_ps(one, t);
+
+		weights[0] = _mm256_mul_ps(_mm256_mul_ps(it, it), it);
+		weights[1] = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(three, t), it), it);
+		weights[2] = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(three, it), t), t);
+		weights[3] = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+	}
+
+	UTILAYRE_TARGET_AVX static void BezierHeightAVX(const HeightPatch& cps, const float* u, const float* v, float* out, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 bu[4], bv[4];
+			BernsteinAVX(_mm256_loadu_ps(u + i), bu);
+			BernsteinAVX(_mm256_loadu_ps(v + i), bv);
+
+			__m256 result = _mm256_setzero_ps();
+			for (int row = 0; row < 4; ++row)
+			{
+				__m256 Pu = _mm256_mul_ps(_mm256_set1_ps(cps[row * 4]), bu[0]);
+				Pu = _mm256_add_ps(Pu, _mm256_mul_ps(_mm256_set1_ps(cps[row * 4 + 1]), bu[1]));
+				Pu = _mm256_add_ps(Pu, _mm256_mul_ps(_mm256_set1_ps(cps[row * 4 + 2]), bu[2]));
+				Pu = _mm256_add_ps(Pu, _mm256_mul_ps(_mm256_set1_ps(cps[row * 4 + 3]), bu[3]));
+
+				result = row == 0 ? _mm256_mul_ps(Pu, bv[0]) : _mm256_add_ps(result, _mm256_mul_ps(Pu, bv[row]));
+			}
+			_mm256_storeu_ps(out + i, result);
+		}
+		BezierHeightSSE(cps, u + i, v + i, out + i, count - i); //4-wide then scalar for whatever is left
+	}
+#endif
+
+	void BezierHeightBatch(SimdLevel level, const HeightPatch& cps, const float* u, const float* v, float* out, size_t count)
+	{
+#if defined(UTILAYRE_X86)
+		if (level == SimdLevel::AVX)
+		{
+			BezierHeightAVX(cps, u, v, out, count);
+			return;
+		}
+		if (level == SimdLevel::SSE)
+		{
+			BezierHeightSSE(cps, u, v, out, count);
+			return;
+		}
+#endif
+		BezierHeightScalar(cps, u, v, out, count);
+	}
+
+	void BezierHeightBatch(const HeightPatch& cps, const float* u, const float* v, float* out, size_t count)
+	{
+		static const SimdLevel level = DetectSimdLevel(); //checked once, thread-safe static init
+		BezierHeightBatch(level, cps, u, v, out, count);
+	}
+
+	/*
+	Sample i sits at (i / targetSamples) of the way across the source, matching the global UVs MakeMesh gives out
+	*/
+	BernsteinTable BuildBernsteinTable(size_t sourceSegments, size_t targetSamples)
+	{
+		return BuildBernsteinTableOf<3>(sourceSegments, targetSamples);
+	}
+
+	/*
+	4-tap filter, summed in the same order as BezierHeight so a horizontal then vertical pass gives the same bits
+	*/
+	float BernsteinFilter(const float* taps, size_t tapStride, const std::array<float, 4>& weights)
+	{
+		return taps[0] * weights[0] + taps[tapStride] * weights[1] + taps[tapStride * 2] * weights[2] + taps[tapStride * 3] * weights[3];
+	}
+
+	/*
+	Nanoseconds per evaluation of a random height patch of the given degree, in each of the three forms. The
+	sum keeps the compiler from throwing the work away
+	*/
+	template<int Degree>
+	static void TimeBezierDegree(size_t sampleCount, std::ostream& out)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		typedef BezierSurfacePatch<Degree> Patch;
+
+		typename Patch::template Net<float> cps;
+		for (size_t i = 0; i < cps.size(); ++i)
+		{
+			cps[i] = (float)(((uint32_t)i * 2654435761u) >> 24);
+		}
+
+		float sum = 0;
+		auto start = Clock::now();
+		for (size_t i = 0; i < sampleCount; ++i)
+		{
+			sum += Patch::Evaluate(cps, (i % 1021) / 1021.0f, (i % 1019) / 1019.0f);
+		}
+		double evaluateNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / sampleCount;
+
+		start = Clock::now();
+		for (size_t i = 0; i < sampleCount; ++i)
+		{
+			sum += Patch::Horner(cps, (i % 1021) / 1021.0f, (i % 1019) / 1019.0f);
+		}
+		double hornerNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / sampleCount;
+
+		start = Clock::now();
+		for (size_t i = 0; i < sampleCount; ++i)
+		{
+			sum += Patch::DeCasteljau(cps, (i % 1021) / 1021.0f, (i % 1019) / 1019.0f);
+		}
+		double casteljauNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / sampleCount;
+
+		out << "  degree " << Degree << " (" << cps.size() << " points): evaluate " << evaluateNs << " ns, horner " << hornerNs
+			<< " ns, de casteljau " << casteljauNs << " ns" << (sum == 0.123f ? " " : "") << std::endl;
+	}
+
+	bool ReportBezierDegrees(size_t sampleCount, std::ostream& out)
+	{
+		size_t mismatches = 0;
+		int worstHorner = 0, worstCasteljau = 0;
+
+		BezierPatch patch;
+		HeightPatch heights;
+		for (size_t n = 0; n < sampleCount; ++n)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				uint32_t hash = (uint32_t)(n * 16 + i) * 2654435761u;
+				patch[i] = glm::vec3((float)(i % 4), (float)(hash >> 22), (float)(i / 4));
+				heights[i] = patch[i].y;
+			}
+
+			float u = (n % 1021) / 1021.0f;
+			float v = (n % 1019) / 1019.0f;
+			float reference = BezierHeight(heights, u, v);
+
+			if (BezierSurfacePatch<3>::Evaluate(patch, u, v) != BezierPatchSixteenPoints(patch, u, v) ||
+				BezierSurfacePatch<3>::Evaluate(heights, u, v) != reference ||
+				BezierCurve<3>::Evaluate(BezierCurve<3>::Net<glm::vec3>{ { patch[0], patch[1], patch[2], patch[3] } }, u) != CalculateBezier(patch[0], patch[1], patch[2], patch[3], u))
+				mismatches++;
+
+			worstHorner = std::max(worstHorner, UlpDistance(BezierSurfacePatch<3>::Horner(heights, u, v), reference));
+			worstCasteljau = std::max(worstCasteljau, UlpDistance(BezierSurfacePatch<3>::DeCasteljau(heights, u, v), reference));
+		}
+
+		out << "Bezier templates over " << sampleCount << " cubic patches" << std::endl;
+		out << "  evaluate vs the cubic functions: " << (mismatches == 0 ? "bit-identical" : "MISMATCHED") << std::endl;
+		out << "  worst horner " << worstHorner << " ulp, worst de casteljau " << worstCasteljau << " ulp" << std::endl;
+
+		TimeBezierDegree<1>(sampleCount, out);
+		TimeBezierDegree<2>(sampleCount, out);
+		TimeBezierDegree<3>(sampleCount, out);
+		TimeBezierDegree<4>(sampleCount, out);
+		TimeBezierDegree<5>(sampleCount, out);
+		return mismatches == 0;
 	}
 
 //----------------------------DEPRECATED BEZIER FUNCTIONS BELOW --------------------------
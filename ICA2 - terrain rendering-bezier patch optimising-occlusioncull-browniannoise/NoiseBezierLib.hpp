@@ -1,10 +1,35 @@
 #pragma once
 #include <cmath>
-#include <glm\glm.hpp>
+#include <cstdint>
+#include <glm/glm.hpp>
 #include <vector>
+#include <array>
+#include <ostream>
+#include "BezierTemplateLib.hpp"
 
 namespace utilAyre
 {
+	/*
+	Fixed-size 4x4 control net, rows in ascending V and points in ascending U. Lives on the stack
+	*/
+	typedef std::array<glm::vec3, 16> BezierPatch;
+
+	/*
+	Non-owning view of a 4x4 control net that sits inside a bigger array, such as the vertices of a mesh.
+	Strides are in bytes so the points can be a member of a larger vertex struct
+	*/
+	struct PatchView
+	{
+		const char* origin;
+		size_t pointStride;
+		size_t rowStride;
+
+		const glm::vec3& at(int row, int column) const
+		{
+			return *(const glm::vec3*)(origin + row * rowStride + column * pointStride);
+		}
+	};
+
 	float SeededRandomFloat(int x, int y);
 
 	float Noise(int n);
@@ -15,11 +40,86 @@ namespace utilAyre
 
 	glm::vec3 Brownian(const glm::vec3& pos, float frequency, int octaves, float lacunarity, float gain, float scale);
 
-	glm::vec3 CalculateBezier(const std::vector<glm::vec3>& cps, float u, float v);
+	/*
+	The parameters the terrain noise is built from, kept together so every build path uses the same ones.
+	Frequency is in cycles per world unit for GradientFbm: 1/256 puts all but the last octave above the
+	8 unit vertex spacing of the hi-res terrain
+	*/
+	struct NoiseSettings
+	{
+		float frequency{ 1.0f / 256.0f };
+		int octaves{ 8 };
+		float lacunarity{ 1.7f };
+		float gain{ 0.65f };
+		float scale{ 1.5f };
+		uint32_t seed{ 1 };
+	};
+
+	glm::vec3 Brownian(const glm::vec3& pos, const NoiseSettings& settings);
+
+	glm::vec3 CalculateBezier(const std::vector<glm::vec3>& cps, float t);
+
+	glm::vec3 CalculateBezier(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t);
 
 	glm::vec3 BezierSurface(const std::vector<std::vector<glm::vec3>>& cps, float u, float v, int patchID);
 
 	glm::vec3 BezierSurface(const std::vector<glm::vec3>& cps, float u, float v);
 
 	glm::vec3 BezierPatchSixteenPoints(const std::vector<glm::vec3>& cps, float u, float v);
-}
\ No newline at end of file
+
+	glm::vec3 BezierPatchSixteenPoints(const BezierPatch& cps, float u, float v);
+
+	glm::vec3 BezierPatchSixteenPoints(const PatchView& cps, float u, float v);
+
+	/*
+	Height-only batch evaluation. The terrain only keeps .y of the patch, so the batch kernels work on the
+	16 heights of one patch and evaluate many (u,v) samples against it at once, 4 per SSE op or 8 per AVX op.
+	The kernel is picked once at startup from the CPU features, with a scalar fallback for anything else.
+
+	The SIMD kernels repeat the scalar operation order exactly, so with no fused multiply-add contraction
+	they are bit-identical to BezierHeight. kBezierBatchMaxUlp is the bound we hold them to regardless
+	*/
+	typedef std::array<float, 16> HeightPatch;
+
+	enum class SimdLevel { Scalar, SSE, AVX };
+
+	const int kBezierBatchMaxUlp = 2;
+
+	SimdLevel DetectSimdLevel();
+
+	const char* SimdLevelName(SimdLevel level);
+
+	int UlpDistance(float a, float b);
+
+	HeightPatch HeightsOf(const PatchView& cps);
+
+	float BezierHeight(const HeightPatch& cps, float u, float v);
+
+	/*
+	Same sums with the weights handed in, for the shorter patches at the far edges of a grid (see LocatePatchSample)
+	*/
+	float BezierHeight(const HeightPatch& cps, const std::array<float, 4>& bu, const std::array<float, 4>& bv);
+
+	void BezierHeightBatch(const HeightPatch& cps, const float* u, const float* v, float* out, size_t count);
+
+	void BezierHeightBatch(SimdLevel level, const HeightPatch& cps, const float* u, const float* v, float* out, size_t count);
+
+	/*
+	Precomputed cubic Bernstein weights for resampling one axis of a piecewise Bezier grid. Entry i holds the
+	first of the four control points output sample i reads, and its weights on them. Patches are 3 segments wide
+	and share their end points, with a shorter one at the far edge when the segments don't divide by 3: the
+	LocatePatchSample layout, which PieceWiseInterpolation uses too
+	*/
+	typedef BernsteinTableOf<3> BernsteinTable;
+
+	BernsteinTable BuildBernsteinTable(size_t sourceSegments, size_t targetSamples);
+
+	float BernsteinFilter(const float* taps, size_t tapStride, const std::array<float, 4>& weights);
+
+	/*
+	Checks the degree 3 templates against the cubic functions above (Evaluate bit for bit, Horner and de Casteljau
+	to within a few ulp) and times a height patch evaluation at each degree from 1 to 5 in all three forms.
+	True if Evaluate matched
+	*/
+	bool ReportBezierDegrees(size_t sampleCount, std::ostream& out);
+}
@@ -1,5 +1,6 @@
 #include <crtdbg.h>
 #include <cstdlib>
+#include <cstring>
 
 #include "MyController.hpp"
 #include <tygra/Window.hpp>
@@ -9,7 +10,13 @@ int main(int argc, char *argv[])
     // enable debug memory checks
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 
-	std::shared_ptr<MyController> controller = std::make_shared<MyController>();
+    // --paging streams a bigger terrain in around the camera instead of building it all up front
+    bool terrain_paging = false;
+    for (int i = 1; i < argc; ++i) {
+        terrain_paging = terrain_paging || std::strcmp(argv[i], "--paging") == 0;
+    }
+
+	std::shared_ptr<MyController> controller = std::make_shared<MyController>(terrain_paging);
     std::shared_ptr<tygra::Window> window = tygra::Window::mainWindow();
     window->setController(controller);
 
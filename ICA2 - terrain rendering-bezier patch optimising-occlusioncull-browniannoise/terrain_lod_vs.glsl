@@ -0,0 +1,48 @@
+#version 330
+
+uniform mat4 view_world_xform;
+uniform mat4 projection_xform;
+
+uniform sampler2D heightfield; // one texel per terrain vertex, normal in rgb and height in a
+uniform vec2 grid_verts;       // vertices along x and z
+uniform vec2 grid_spacing;     // world units between vertices, same as TerrainGL::GridPosition
+uniform int node_quads;        // quads along one side of the shared node mesh
+uniform vec2 node_origin;      // first vertex of the node on the full grid
+uniform float node_stride;     // vertices between node mesh vertices, 1 << level
+uniform vec2 morph_range;      // distance the morph starts and ends at for this level
+uniform vec3 camera_position;
+
+out vec3 varying_position;
+out vec3 varying_normal;
+
+vec4 sampleHeightfield(vec2 grid)
+{
+    return texture(heightfield, (grid + 0.5) / grid_verts);
+}
+
+vec3 worldPosition(vec2 grid, float height)
+{
+    return vec3(grid.x * grid_spacing.x, height, -grid.y * grid_spacing.y);
+}
+
+void main(void)
+{
+    // the node mesh has no vertex buffer, its grid position comes from the index like the packed terrain
+    vec2 local = vec2(gl_VertexID % (node_quads + 1), gl_VertexID / (node_quads + 1));
+    vec2 grid = min(node_origin + local * node_stride, grid_verts - 1.0);
+
+    float distance_to_camera = distance(camera_position, worldPosition(grid, sampleHeightfield(grid).a));
+    float morph = clamp((distance_to_camera - morph_range.x) / (morph_range.y - morph_range.x), 0.0, 1.0);
+
+    // odd vertices slide onto their even neighbour, at morph = 1 this is exactly the next level's mesh
+    vec2 odd = fract(local * 0.5) * 2.0;
+    grid = min(node_origin + (local - odd * morph) * node_stride, grid_verts - 1.0);
+
+    vec4 texel = sampleHeightfield(grid);
+    vec3 position = worldPosition(grid, texel.a);
+
+    varying_normal = mat3(view_world_xform) * normalize(texel.rgb);
+    vec4 view_position = view_world_xform * vec4(position, 1.0);
+    varying_position = view_position.xyz;
+    gl_Position = projection_xform * view_position;
+}
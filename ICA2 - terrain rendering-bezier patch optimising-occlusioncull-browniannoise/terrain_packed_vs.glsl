@@ -0,0 +1,47 @@
+#version 330
+
+uniform mat4 view_world_xform;
+uniform mat4 projection_xform;
+
+uniform int verts_x;
+uniform float verts_z;
+uniform int target_size_x;
+uniform int target_size_z;
+uniform float height_scale;
+uniform float height_bias;
+
+layout(location=0)
+in float vertex_height;
+
+layout(location=1)
+in vec2 vertex_octahedral;
+
+out vec3 varying_position;
+out vec3 varying_normal;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec2 p = encoded / 32767.0;
+    vec3 v = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (v.z < 0.0)
+    {
+        vec2 signs = vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+        v.xy = (1.0 - abs(p.yx)) * signs;
+    }
+    return normalize(v);
+}
+
+void main(void)
+{
+    // x/z come from the grid index, same maths as TerrainGL::GridPosition
+    int x = gl_VertexID % verts_x;
+    int z = gl_VertexID / verts_x;
+    vec3 position = vec3(float(x * target_size_x / verts_x),
+                         height_bias + vertex_height * height_scale,
+                         float(-z * target_size_z) / verts_z);
+
+    varying_normal = mat3(view_world_xform) * decodeOctahedral(vertex_octahedral);
+    vec4 view_position = view_world_xform * vec4(position, 1.0);
+    varying_position = view_position.xyz;
+    gl_Position = projection_xform * view_position;
+}
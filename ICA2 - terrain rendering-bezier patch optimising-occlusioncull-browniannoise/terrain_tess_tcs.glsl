@@ -0,0 +1,38 @@
+#version 410
+
+layout(vertices = 16) out;
+
+uniform vec3 camera_position;
+uniform float pixels_per_unit;    // screen pixels a world unit covers at a distance of 1
+uniform float pixels_per_segment;
+uniform float max_level;
+
+in vec3 control_position[];
+out vec3 patch_position[];
+
+// TerrainTessellation::EdgeLevel, kept in the same order. Only the two corners go in and swapping them changes
+// nothing, so the patches either side of an edge always agree on its level
+float edgeLevel(vec3 a, vec3 b)
+{
+    precise vec3 centre = (a + b) * 0.5;
+    precise float diameter = length(b - a);
+    precise float eye_distance = max(length(centre - camera_position), 0.001);
+    precise float pixels = diameter * pixels_per_unit / eye_distance;
+    return min(max(pixels / pixels_per_segment, 1.0), max_level);
+}
+
+void main(void)
+{
+    patch_position[gl_InvocationID] = control_position[gl_InvocationID];
+
+    if (gl_InvocationID == 0)
+    {
+        // the corners are points 0, 3, 12 and 15, rows run along v
+        gl_TessLevelOuter[0] = edgeLevel(control_position[0], control_position[12]);
+        gl_TessLevelOuter[1] = edgeLevel(control_position[0], control_position[3]);
+        gl_TessLevelOuter[2] = edgeLevel(control_position[3], control_position[15]);
+        gl_TessLevelOuter[3] = edgeLevel(control_position[12], control_position[15]);
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+        gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+    }
+}
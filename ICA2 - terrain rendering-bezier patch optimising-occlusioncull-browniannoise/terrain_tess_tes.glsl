@@ -0,0 +1,54 @@
+#version 410
+
+layout(quads, fractional_odd_spacing, ccw) in;
+
+uniform mat4 view_world_xform;
+uniform mat4 projection_xform;
+
+in vec3 patch_position[];
+
+out vec3 varying_position;
+out vec3 varying_normal;
+
+// cubic Bernstein weights and their derivatives, the same as BezierCurve<3>::Basis and DerivativeBasis
+void bernstein(float t, out vec4 weights, out vec4 slopes)
+{
+    float s = 1.0 - t;
+    weights = vec4(s * s * s, 3.0 * t * s * s, 3.0 * t * t * s, t * t * t);
+    slopes = vec4(-3.0 * s * s, 3.0 * s * s - 6.0 * t * s, 6.0 * t * s - 3.0 * t * t, 3.0 * t * t);
+}
+
+void main(void)
+{
+    vec4 bu, du, bv, dv;
+    bernstein(gl_TessCoord.x, bu, du);
+    bernstein(gl_TessCoord.y, bv, dv);
+
+    // collapse each row along u, then the rows along v. At the edges the weights are exactly 0 and 1, so
+    // neighbouring patches land on the same heights along the edge they share
+    vec4 rows, row_slopes;
+    for (int r = 0; r < 4; ++r)
+    {
+        vec4 heights = vec4(patch_position[r * 4].y, patch_position[r * 4 + 1].y, patch_position[r * 4 + 2].y, patch_position[r * 4 + 3].y);
+        rows[r] = dot(bu, heights);
+        row_slopes[r] = dot(du, heights);
+    }
+    float height = dot(bv, rows);
+    float dhdu = dot(bv, row_slopes);
+    float dhdv = dot(dv, rows);
+
+    // the control points are evenly spaced, so x and z through the same weights come out linear
+    float x = dot(bu, vec4(patch_position[0].x, patch_position[1].x, patch_position[2].x, patch_position[3].x));
+    float z = dot(bv, vec4(patch_position[0].z, patch_position[4].z, patch_position[8].z, patch_position[12].z));
+    vec3 world_position = vec3(x, height, z);
+
+    // TerrainGL::SlopeNormal, with the patch's u and v spans turning the derivatives into world slopes
+    float dhdx = dhdu / (patch_position[3].x - patch_position[0].x);
+    float dhdz = dhdv / (patch_position[12].z - patch_position[0].z);
+    vec3 normal = normalize(vec3(-dhdx, 1.0, -dhdz));
+
+    varying_normal = mat3(view_world_xform) * normal;
+    vec4 view_position = view_world_xform * vec4(world_position, 1.0);
+    varying_position = view_position.xyz;
+    gl_Position = projection_xform * view_position;
+}
@@ -0,0 +1,17 @@
+#version 410
+
+uniform int grid_verts_x;   // control points along x
+uniform vec2 grid_spacing;  // world units between control points, TerrainTessellation::Spacing
+
+layout(location=0)
+in float control_height;
+
+out vec3 control_position;
+
+void main(void)
+{
+    // patches are drawn through the index buffer, so gl_VertexID is the control point's grid index
+    int x = gl_VertexID % grid_verts_x;
+    int z = gl_VertexID / grid_verts_x;
+    control_position = vec3(float(x) * grid_spacing.x, control_height, -(float(z) * grid_spacing.y));
+}